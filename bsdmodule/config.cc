@@ -80,11 +80,14 @@ static Router *
 parse_router(String s)
 {
     BSDModuleLexerExtra lextra;
+    Timestamp parse_start = Timestamp::now_steady();
     int cookie = lexer->begin_parse(s, "line ", &lextra, click_logged_errh);
     while (!lexer->ydone())
 	lexer->ystep();
     Router *r = lexer->create_router(click_master);
     lexer->end_parse(cookie);
+    if (r)
+	r->set_load_time(Router::load_parse, Timestamp::now_steady() - parse_start);
     return r;
 }
 
@@ -23,10 +23,13 @@
 #include <click/packet_anno.hh>
 #include <click/integers.hh>	// for first_bit_set
 #include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 AggregateCounter::AggregateCounter()
-    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0)
+    : _root(0), _free(0), _block_size(1024), _hh_capacity(0), _hh(0),
+      _sketch(0), _call_nnz_h(0), _call_count_h(0)
 {
 }
 
@@ -38,11 +41,15 @@ AggregateCounter::Node *
 AggregateCounter::new_node_block()
 {
     assert(!_free);
-    int block_size = 1024;
+    // Blocks double in size, up to 64K nodes, so large tries live in a few
+    // big arenas rather than many scattered allocations.
+    int block_size = _block_size;
     Node *block = new Node[block_size];
     if (!block)
 	return 0;
     _blocks.push_back(block);
+    if (_block_size < 65536)
+	_block_size *= 2;
     for (int i = 1; i < block_size - 1; i++)
 	block[i].child[0] = &block[i+1];
     block[block_size - 1].child[0] = 0;
@@ -60,6 +67,8 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
     uint32_t freeze_nnz, stop_nnz;
     uint64_t freeze_count, stop_count;
     String call_nnz, call_count;
+    _sketch_width = 0;
+    _sketch_depth = 4;
     freeze_nnz = stop_nnz = _call_nnz = (uint32_t)(-1);
     freeze_count = stop_count = _call_count = (uint64_t)(-1);
 
@@ -74,9 +83,25 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("COUNT_STOP", stop_count)
 	.read("AGGREGATE_CALL", AnyArg(), call_nnz)
 	.read("COUNT_CALL", AnyArg(), call_count)
-	.read("BANNER", _output_banner).complete() < 0)
+	.read("BANNER", _output_banner)
+	.read("HEAVY_HITTERS", _hh_capacity)
+	.read("SKETCH_WIDTH", _sketch_width)
+	.read("SKETCH_DEPTH", _sketch_depth).complete() < 0)
 	return -1;
 
+    if (_hh_capacity > 0x1000000)
+	return errh->error("HEAVY_HITTERS too large");
+    if (_sketch_width) {
+	if (!_hh_capacity)
+	    return errh->error("SKETCH_WIDTH requires HEAVY_HITTERS");
+	if (_sketch_width > 0x1000000 || _sketch_depth == 0 || _sketch_depth > 16)
+	    return errh->error("sketch dimensions out of range");
+	// round up to a power of two; sketch_add() hashes to the top
+	// log2(_sketch_width) bits of a 32-bit product
+	_sketch_shift = (_sketch_width <= 2 ? 31 : ffs_msb(_sketch_width - 1) - 1);
+	_sketch_width = 1U << (32 - _sketch_shift);
+    }
+
     _bytes = bytes;
     _ip_bytes = ip_bytes;
     _use_packet_count = packet_count;
@@ -121,6 +146,15 @@ AggregateCounter::initialize(ErrorHandler *errh)
     if (_call_count_h && _call_count_h->initialize_write(this, errh) < 0)
 	return -1;
 
+    if (_hh_capacity) {
+	_hh = new HeavyHitter[_hh_capacity];
+	if (_sketch_width)
+	    _sketch = new uint32_t[_sketch_width * _sketch_depth];
+	if (!_hh || (_sketch_width && !_sketch))
+	    return errh->error("out of memory!");
+	_hh_heap.reserve(_hh_capacity);
+    }
+
     if (clear(errh) < 0)
 	return -1;
 
@@ -135,6 +169,10 @@ AggregateCounter::cleanup(CleanupStage)
     for (int i = 0; i < _blocks.size(); i++)
 	delete[] _blocks[i];
     _blocks.clear();
+    delete[] _hh;
+    delete[] _sketch;
+    _hh = 0;
+    _sketch = 0;
     delete _call_nnz_h;
     delete _call_count_h;
     _call_nnz_h = _call_count_h = 0;
@@ -212,18 +250,84 @@ AggregateCounter::find_node(uint32_t a, bool frozen)
     return 0;
 }
 
+
+// HEAVY HITTERS
+
+inline uint32_t
+AggregateCounter::sketch_add(uint32_t a, uint32_t amount)
+{
+    // Count-min sketch with multiply-shift hashing; returns the estimate for
+    // 'a' after adding 'amount'.
+    uint32_t estimate = 0xFFFFFFFFU;
+    uint32_t *row = _sketch;
+    for (uint32_t d = 0; d < _sketch_depth; ++d, row += _sketch_width) {
+	uint32_t h = (a * (0x9E3779B1U + 2 * d * 0x85EBCA6BU)) >> _sketch_shift;
+	row[h] += amount;
+	if (row[h] < estimate)
+	    estimate = row[h];
+    }
+    return estimate;
+}
+
+bool
+AggregateCounter::count_heavy_hitter(uint32_t a, uint32_t amount, bool frozen)
+{
+    HeavyHitter *h = _hh_map.get(a);
+    if (!h && frozen)
+	return false;
+
+    uint32_t estimate = (_sketch ? sketch_add(a, amount) : 0);
+    if (h) {
+	h->count += amount;
+	if (_sketch && h->count > estimate)
+	    h->count = estimate;
+    } else if (_hh_heap.size() < (int) _hh_capacity) {
+	h = &_hh[_hh_heap.size()];
+	h->aggregate = a;
+	h->count = (_sketch ? estimate : amount);
+	h->error = h->count - amount;
+	_hh_heap.push_back(h);
+	push_heap(_hh_heap.begin(), _hh_heap.end(),
+		  HeavyHitterCompare(), HeavyHitterPlace());
+	_hh_map.set(a, h);
+	_num_nonzero++;
+	return true;
+    } else {
+	// Space-Saving: replace the minimum entry.  With a sketch, replace
+	// it only if the newcomer's estimate is larger.
+	h = _hh_heap[0];
+	if (_sketch && estimate <= h->count)
+	    return true;
+	_hh_map.erase(h->aggregate);
+	h->error = (_sketch ? estimate - amount : h->count);
+	h->count = (_sketch ? estimate : h->count + amount);
+	h->aggregate = a;
+	_hh_map.set(a, h);
+    }
+
+    change_heap(_hh_heap.begin(), _hh_heap.end(), _hh_heap.begin() + h->heap_index,
+		HeavyHitterCompare(), HeavyHitterPlace());
+    return true;
+}
+
+void
+AggregateCounter::sorted_heavy_hitters(Vector<HeavyHitter *> &v) const
+{
+    // heapsort the min-heap, leaving the largest counts first
+    v = _hh_heap;
+    for (HeavyHitter **end = v.end(); end - v.begin() > 1; --end) {
+	click_swap(v[0], end[-1]);
+	change_heap(v.begin(), end - 1, v.begin(), HeavyHitterCompare());
+    }
+}
+
+
 inline bool
 AggregateCounter::update(Packet *p, bool frozen)
 {
     if (!_active)
 	return false;
 
-    // AGGREGATE_ANNO is already in host byte order!
-    uint32_t agg = AGGREGATE_ANNO(p);
-    Node *n = find_node(agg, frozen);
-    if (!n)
-	return false;
-
     uint32_t amount;
     if (!_bytes)
 	amount = 1 + (_use_packet_count ? EXTRA_PACKETS_ANNO(p) : 0);
@@ -233,18 +337,35 @@ AggregateCounter::update(Packet *p, bool frozen)
 	    amount -= p->network_header_offset();
     }
 
-    // update _num_nonzero; possibly call handler
-    if (amount && !n->count) {
-	if (_num_nonzero >= _call_nnz) {
+    // AGGREGATE_ANNO is already in host byte order!
+    uint32_t agg = AGGREGATE_ANNO(p);
+    if (_hh_capacity) {
+	uint32_t old_nonzero = _num_nonzero;
+	if (!count_heavy_hitter(agg, amount, frozen))
+	    return false;
+	if (_num_nonzero > old_nonzero && old_nonzero >= _call_nnz) {
 	    _call_nnz = (uint32_t)(-1);
 	    _call_nnz_h->call_write();
-	    // handler may have changed our state; reupdate
-	    return update(p, frozen || _frozen);
 	}
-	_num_nonzero++;
+    } else {
+	Node *n = find_node(agg, frozen);
+	if (!n)
+	    return false;
+
+	// update _num_nonzero; possibly call handler
+	if (amount && !n->count) {
+	    if (_num_nonzero >= _call_nnz) {
+		_call_nnz = (uint32_t)(-1);
+		_call_nnz_h->call_write();
+		// handler may have changed our state; reupdate
+		return update(p, frozen || _frozen);
+	    }
+	    _num_nonzero++;
+	}
+
+	n->count += amount;
     }
 
-    n->count += amount;
     _count += amount;
     if (_count >= _call_count) {
 	_call_count = (uint64_t)(-1);
@@ -296,6 +417,10 @@ AggregateCounter::clear(ErrorHandler *errh)
     _root->aggregate = 0;
     _root->count = 0;
     _root->child[0] = _root->child[1] = 0;
+    _hh_heap.clear();
+    _hh_map.clear();
+    if (_sketch)
+	memset(_sketch, 0, sizeof(uint32_t) * _sketch_width * _sketch_depth);
     _num_nonzero = 0;
     _count = 0;
     return 0;
@@ -325,6 +450,17 @@ AggregateCounter::reaggregate_node(Node *n)
 void
 AggregateCounter::reaggregate_counts()
 {
+    if (_hh_capacity) {
+	Vector<uint32_t> counts;
+	for (int i = 0; i < _hh_heap.size(); i++)
+	    counts.push_back(_hh_heap[i]->count);
+	clear();
+	for (int i = 0; i < counts.size(); i++)
+	    if (count_heavy_hitter(counts[i], 1, false))
+		_count++;
+	return;
+    }
+
     Node *old_root = _root;
     _root = 0;
     clear();
@@ -401,7 +537,19 @@ AggregateCounter::write_file(String where, WriteFormat format,
 
     uint32_t buf[1024];
     int pos = 0;
-    write_nodes(_root, f, format, buf, pos, 1024, errh);
+    if (_hh_capacity) {
+	Vector<HeavyHitter *> hh;
+	sorted_heavy_hitters(hh);
+	for (int i = 0; i < hh.size(); i++) {
+	    buf[pos++] = hh[i]->aggregate;
+	    buf[pos++] = hh[i]->count;
+	    if (pos == 1024) {
+		write_batch(f, format, buf, pos, _count, errh);
+		pos = 0;
+	    }
+	}
+    } else
+	write_nodes(_root, f, format, buf, pos, 1024, errh);
     if (pos)
 	write_batch(f, format, buf, pos, _count, errh);
 
@@ -427,7 +575,7 @@ AggregateCounter::write_file_handler(const String &data, Element *e, void *thunk
 
 enum {
     AC_FROZEN, AC_ACTIVE, AC_BANNER, AC_STOP, AC_REAGGREGATE, AC_CLEAR,
-    AC_AGGREGATE_CALL, AC_COUNT_CALL, AC_NAGG, AC_COUNT
+    AC_AGGREGATE_CALL, AC_COUNT_CALL, AC_NAGG, AC_COUNT, AC_HEAVY_HITTERS
 };
 
 String
@@ -451,6 +599,14 @@ AggregateCounter::read_handler(Element *e, void *thunk)
 	return String(ac->_count);
       case AC_NAGG:
 	return String(ac->_num_nonzero);
+      case AC_HEAVY_HITTERS: {
+	  Vector<HeavyHitter *> hh;
+	  ac->sorted_heavy_hitters(hh);
+	  StringAccum sa;
+	  for (int i = 0; i < hh.size(); i++)
+	      sa << hh[i]->aggregate << ' ' << hh[i]->count << ' ' << hh[i]->error << '\n';
+	  return sa.take_string();
+      }
       default:
 	return "<error>";
     }
@@ -543,6 +699,10 @@ AggregateCounter::add_handlers()
     add_write_handler("count_call", write_handler, AC_COUNT_CALL);
     add_read_handler("count", read_handler, AC_COUNT);
     add_read_handler("nagg", read_handler, AC_NAGG);
+    if (_hh_capacity)
+	add_read_handler("heavy_hitters", read_handler, AC_HEAVY_HITTERS);
+    if (_sketch_width)
+	add_data_handlers("sketch_width", Handler::OP_READ, &_sketch_width);
 }
 
 ELEMENT_REQUIRES(userlevel int64)
@@ -1,6 +1,7 @@
 #ifndef CLICK_AGGCOUNTER_HH
 #define CLICK_AGGCOUNTER_HH
 #include <click/element.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 class HandlerCall;
 
@@ -92,6 +93,33 @@ the supplied value, once the total count has reached or exceeded I<N>.
 The three COUNT keywords are mutually exclusive. Supply at most one of
 them.
 
+=item HEAVY_HITTERS
+
+Unsigned. If nonzero, then track only the I<N> heaviest aggregates in bounded
+memory, rather than every aggregate. AggregateCounter then uses the
+Space-Saving algorithm: a new aggregate replaces the monitored aggregate with
+the smallest count, and inherits that count as its potential error. Any
+aggregate whose true count exceeds the total count divided by I<N> is
+guaranteed to be monitored. Memory use is proportional to I<N>, independent of
+the number of distinct aggregates. Default is 0, which counts every aggregate
+exactly.
+The C<write_file>, C<write_text_file>, and C<write_ip_file> handlers then
+write the monitored aggregates with their estimated counts, in decreasing
+count order.
+
+=item SKETCH_WIDTH
+
+Unsigned. Only meaningful with HEAVY_HITTERS. If nonzero, then also maintain
+a count-min sketch with SKETCH_WIDTH counters per row (rounded up to a power
+of two). A new aggregate then displaces the smallest monitored aggregate only
+when its sketch estimate exceeds that aggregate's count, and starts from its
+sketch estimate. This reduces overestimation for skewed traffic at the cost of
+SKETCH_WIDTH * SKETCH_DEPTH extra counters. Default is 0 (no sketch).
+
+=item SKETCH_DEPTH
+
+Unsigned. The number of count-min sketch rows. Default is 4.
+
 =item BANNER
 
 String. This banner is written to the head of any output file. It should
@@ -161,7 +189,19 @@ Returns or sets the COUNT_CALL setting.
 
 =h nagg read-only
 
-Returns the number of aggregates that have been seen so far.
+Returns the number of aggregates that have been seen so far. With
+HEAVY_HITTERS, returns the number of aggregates currently monitored.
+
+=h heavy_hitters read-only
+
+Only available with HEAVY_HITTERS. Returns the monitored aggregates in
+decreasing count order, one per line. Each line contains the aggregate, its
+estimated count, and the maximum overestimation error of that count.
+
+=h sketch_width read-only
+
+Only available with SKETCH_WIDTH. Returns the number of counters per sketch
+row, which is SKETCH_WIDTH rounded up to a power of two.
 
 =n
 
@@ -227,9 +267,39 @@ class AggregateCounter : public Element { public:
     bool _frozen;
     bool _active;
 
+    struct HeavyHitter {
+	uint32_t aggregate;
+	uint32_t count;
+	uint32_t error;
+	int heap_index;
+    };
+
+    struct HeavyHitterCompare {
+	bool operator()(const HeavyHitter *a, const HeavyHitter *b) const {
+	    return a->count < b->count;
+	}
+    };
+
+    struct HeavyHitterPlace {
+	void operator()(HeavyHitter **begin, HeavyHitter **it) const {
+	    (*it)->heap_index = it - begin;
+	}
+    };
+
     Node *_root;
     Node *_free;
     Vector<Node *> _blocks;
+    int _block_size;
+
+    uint32_t _hh_capacity;
+    HeavyHitter *_hh;
+    Vector<HeavyHitter *> _hh_heap;	// min-heap on count
+    HashTable<uint32_t, HeavyHitter *> _hh_map;
+    uint32_t *_sketch;
+    uint32_t _sketch_width;
+    uint32_t _sketch_depth;
+    uint32_t _sketch_shift;
+
     uint32_t _num_nonzero;
     uint64_t _count;
 
@@ -244,6 +314,10 @@ class AggregateCounter : public Element { public:
     Node *new_node_block();
     void free_node(Node *);
 
+    inline uint32_t sketch_add(uint32_t, uint32_t);
+    bool count_heavy_hitter(uint32_t, uint32_t amount, bool frozen);
+    void sorted_heavy_hitters(Vector<HeavyHitter *> &) const;
+
     Node *make_peer(uint32_t, Node *, bool frozen);
     Node *find_node(uint32_t, bool frozen = false);
     void reaggregate_node(Node *);
@@ -27,6 +27,7 @@
 #include <clicknet/icmp.h>
 #include <click/packet_anno.hh>
 #include <click/handlercall.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 #define SEC_OLDER(s1, s2)	((int)(s1 - s2) < 0)
@@ -72,14 +73,16 @@ flip_ports(uint32_t ports)
 // actual AggregateIPFlows operations
 
 AggregateIPFlows::AggregateIPFlows()
+    : _shards(0), _nshards(1)
 #if CLICK_USERLEVEL
-    : _traceinfo_file(0), _packet_source(0), _filepos_h(0)
+      , _traceinfo_file(0), _packet_source(0), _filepos_h(0)
 #endif
 {
 }
 
 AggregateIPFlows::~AggregateIPFlows()
 {
+    delete[] _shards;
 }
 
 void *
@@ -105,6 +108,7 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
     bool handle_icmp_errors = false;
     bool fragments_parsed;
     bool fragments = true;
+    _nshards = 1;
 
     if (Args(conf, this, errh)
 	.read("TCP_TIMEOUT", _tcp_timeout)
@@ -118,12 +122,15 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("SOURCE", ElementArg(), _packet_source)
 #endif
 	.read("FRAGMENTS", fragments).read_status(fragments_parsed)
+	.read("SHARDS", _nshards)
 	.complete() < 0)
 	return -1;
 
     _smallest_timeout = (_tcp_timeout < _tcp_done_timeout ? _tcp_timeout : _tcp_done_timeout);
     _smallest_timeout = (_smallest_timeout < _udp_timeout ? _smallest_timeout : _udp_timeout);
     _handle_icmp_errors = handle_icmp_errors;
+    if (_nshards <= 0)
+	return errh->error("SHARDS must be positive");
     if (fragments_parsed)
 	_fragments = fragments;
     return 0;
@@ -132,8 +139,15 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AggregateIPFlows::initialize(ErrorHandler *errh)
 {
-    _next = 1;
-    _active_sec = _gc_sec = 0;
+    if (!(_shards = new Shard[_nshards]))
+	return errh->error("out of memory!");
+    for (int i = 0; i < _nshards; i++) {
+	_shards[i]._next = i + 1;
+	_shards[i]._active_sec = _shards[i]._gc_sec = 0;
+	_shards[i]._emit_head = _shards[i]._emit_tail = 0;
+    }
+    // A single shard touched by a single thread needs no lock.
+    _lock_shards = _nshards > 1 || master()->nthreads() > 1;
     _timestamp_warning = false;
 
 #if CLICK_USERLEVEL
@@ -164,8 +178,11 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
 void
 AggregateIPFlows::cleanup(CleanupStage)
 {
-    clean_map(_tcp_map);
-    clean_map(_udp_map);
+    if (_shards)
+	for (int i = 0; i < _nshards; i++) {
+	    clean_map(_shards[i]._tcp_map);
+	    clean_map(_shards[i]._udp_map);
+	}
 #if CLICK_USERLEVEL
     if (_traceinfo_file && _traceinfo_file != stdout) {
 	fprintf(_traceinfo_file, "</trace>\n");
@@ -175,12 +192,76 @@ AggregateIPFlows::cleanup(CleanupStage)
 #endif
 }
 
+inline AggregateIPFlows::Shard &
+AggregateIPFlows::shard(const HostPair &hp) const
+{
+    if (_nshards == 1)
+	return _shards[0];
+    uint32_t h = hp.hashcode();
+    h ^= h >> 16;
+    return _shards[h % _nshards];
+}
+
+inline uint32_t
+AggregateIPFlows::new_aggregate(Shard &s) const
+{
+    uint32_t agg = s._next;
+    s._next += _nshards;
+    return agg;
+}
+
+inline void
+AggregateIPFlows::lock_shard(Shard &s)
+{
+    if (_lock_shards)
+	s._lock.acquire();
+}
+
+/** Release @a s's lock and return the fragment heads that were completed
+ * while it was held.  The caller pushes them with push_fragment_heads() once
+ * no lock is held, so downstream elements can safely call back into this
+ * element. */
+inline Packet *
+AggregateIPFlows::unlock_shard(Shard &s)
+{
+    Packet *heads = s._emit_head;
+    s._emit_head = s._emit_tail = 0;
+    if (_lock_shards)
+	s._lock.release();
+    return heads;
+}
+
+void
+AggregateIPFlows::push_fragment_heads(Packet *heads)
+{
+    while (Packet *p = heads) {
+	heads = p->next();
+	p->set_next(0);
+	output(0).push(p);
+    }
+}
+
+inline void
+AggregateIPFlows::shard_notify(uint32_t agg, AggregateListener::AggregateEvent e, const Packet *p)
+{
+    // The caller holds its shard's lock, so events for any one aggregate
+    // arrive in order; _notify_lock keeps listeners single-threaded.
+    if (_nshards == 1)
+	notify(agg, e, p);
+    else {
+	_notify_lock.acquire();
+	notify(agg, e, p);
+	_notify_lock.release();
+    }
+}
+
 inline void
 AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool really_delete)
 {
 #if CLICK_USERLEVEL
     if (_traceinfo_file) {
 	StatFlowInfo *sinfo = static_cast<StatFlowInfo *>(finfo);
+	_notify_lock.acquire();
 	IPAddress src(sinfo->reverse() ? hp.b : hp.a);
 	int sport = (ntohl(sinfo->_ports) >> (sinfo->reverse() ? 0 : 16)) & 0xFFFF;
 	IPAddress dst(sinfo->reverse() ? hp.a : hp.b);
@@ -198,6 +279,7 @@ AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool real
   <stream dir='0' packets='%d' /><stream dir='1' packets='%d' />\n\
 </flow>\n",
 		sinfo->_packets[0], sinfo->_packets[1]);
+	_notify_lock.release();
 	if (really_delete)
 	    delete sinfo;
     } else
@@ -266,11 +348,11 @@ AggregateIPFlows::packet_emit_hook(const Packet *p, const click_ip *iph, FlowInf
 }
 
 void
-AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
+AggregateIPFlows::reap_map(Shard &s, Map &table, uint32_t timeout, uint32_t done_timeout)
 {
-    timeout = _active_sec - timeout;
-    done_timeout = _active_sec - done_timeout;
-    int frag_timeout = _active_sec - _fragment_timeout;
+    timeout = s._active_sec - timeout;
+    done_timeout = s._active_sec - done_timeout;
+    int frag_timeout = s._active_sec - _fragment_timeout;
 
     // free completed flows and emit fragments
     for (Map::iterator iter = table.begin(); iter.live(); iter++) {
@@ -280,7 +362,7 @@ AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
 	while ((head = hpinfo->_fragment_head)
 	       && (head->timestamp_anno().sec() < frag_timeout
 		   || !IP_ISFRAG(good_ip_header(head))))
-	    emit_fragment_head(hpinfo);
+	    emit_fragment_head(s, hpinfo);
 
 	// can't delete any flows if there are fragments
 	if (hpinfo->_fragment_head)
@@ -292,7 +374,7 @@ AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
 	while (f) {
 	    // circular comparison
 	    if (SEC_OLDER(f->_last_timestamp.sec(), (f->_flow_over == 3 ? done_timeout : timeout))) {
-		notify(f->_aggregate, AggregateListener::DELETE_AGG, 0);
+		shard_notify(f->_aggregate, AggregateListener::DELETE_AGG, 0);
 		*pprev = f->_next;
 		delete_flowinfo(iter.key(), f);
 	    } else
@@ -304,13 +386,13 @@ AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
 }
 
 void
-AggregateIPFlows::reap()
+AggregateIPFlows::reap(Shard &s)
 {
-    if (_gc_sec) {
-	reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout);
-	reap_map(_udp_map, _udp_timeout, _udp_timeout);
+    if (s._gc_sec) {
+	reap_map(s, s._tcp_map, _tcp_timeout, _tcp_done_timeout);
+	reap_map(s, s._udp_map, _udp_timeout, _udp_timeout);
     }
-    _gc_sec = _active_sec + _gc_interval;
+    s._gc_sec = s._active_sec + _gc_interval;
 }
 
 const click_ip *
@@ -333,9 +415,9 @@ AggregateIPFlows::icmp_encapsulated_header(const Packet *p)
 }
 
 int
-AggregateIPFlows::relevant_timeout(const FlowInfo *f, const Map &m) const
+AggregateIPFlows::relevant_timeout(const FlowInfo *f, const Shard &s, const Map &m) const
 {
-    if (&m == &_udp_map)
+    if (&m == &s._udp_map)
 	return _udp_timeout;
     else if (f->_flow_over == 3)
 	return _tcp_done_timeout;
@@ -346,7 +428,7 @@ AggregateIPFlows::relevant_timeout(const FlowInfo *f, const Map &m) const
 // XXX timing when fragments are merged back in?
 
 AggregateIPFlows::FlowInfo *
-AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, bool flipped, const Packet *p)
+AggregateIPFlows::find_flow_info(Shard &s, Map &m, HostPairInfo *hpinfo, uint32_t ports, bool flipped, const Packet *p)
 {
     FlowInfo **pprev = &hpinfo->_flows;
     for (FlowInfo *finfo = *pprev; finfo; pprev = &finfo->_next, finfo = finfo->_next)
@@ -357,26 +439,25 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 	    // 4.Feb.2004 - Also start a new flow if the old flow closed off,
 	    // and we have a SYN.
 	    if ((age > (int) _smallest_timeout
-		 && age > relevant_timeout(finfo, m))
+		 && age > relevant_timeout(finfo, s, m))
 		|| (finfo->_flow_over == 3
 		    && p->ip_header()->ip_p == IP_PROTO_TCP
 		    && (p->tcp_header()->th_flags & TH_SYN))) {
 		// old aggregate has died
-		notify(finfo->aggregate(), AggregateListener::DELETE_AGG, 0);
+		shard_notify(finfo->aggregate(), AggregateListener::DELETE_AGG, 0);
 		const click_ip *iph = good_ip_header(p);
 		HostPair hp(iph->ip_src.s_addr, iph->ip_dst.s_addr);
 		delete_flowinfo(hp, finfo, false);
 
 		// make a new aggregate
-		finfo->_aggregate = _next;
-		_next++;
+		finfo->_aggregate = new_aggregate(s);
 		finfo->_reverse = flipped;
 		finfo->_flow_over = 0;
 #if CLICK_USERLEVEL
 		if (stats())
 		    stat_new_flow_hook(p, finfo);
 #endif
-		notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
+		shard_notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
 	    }
 
 	    // otherwise, move to the front of the list and return
@@ -390,21 +471,20 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
     FlowInfo *finfo;
 #if CLICK_USERLEVEL
     if (stats()) {
-	finfo = new StatFlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new StatFlowInfo(ports, hpinfo->_flows, new_aggregate(s));
 	stat_new_flow_hook(p, finfo);
     } else
 #endif
-	finfo = new FlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new FlowInfo(ports, hpinfo->_flows, new_aggregate(s));
 
     finfo->_reverse = flipped;
     hpinfo->_flows = finfo;
-    _next++;
-    notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
+    shard_notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
     return finfo;
 }
 
 void
-AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo)
+AggregateIPFlows::emit_fragment_head(Shard &s, HostPairInfo *hpinfo)
 {
     Packet *head = hpinfo->_fragment_head;
     hpinfo->_fragment_head = head->next();
@@ -444,11 +524,16 @@ AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo)
 
     assert(finfo);
     packet_emit_hook(head, iph, finfo);
-    output(0).push(head);
+    head->set_next(0);
+    if (s._emit_head)
+	s._emit_tail->set_next(head);
+    else
+	s._emit_head = head;
+    s._emit_tail = head;
 }
 
 int
-AggregateIPFlows::handle_fragment(Packet *p, HostPairInfo *hpinfo)
+AggregateIPFlows::handle_fragment(Shard &s, Packet *p, HostPairInfo *hpinfo)
 {
     if (hpinfo->_fragment_head)
 	hpinfo->_fragment_tail->set_next(p);
@@ -456,15 +541,15 @@ AggregateIPFlows::handle_fragment(Packet *p, HostPairInfo *hpinfo)
 	hpinfo->_fragment_head = p;
     hpinfo->_fragment_tail = p;
     p->set_next(0);
-    _active_sec = p->timestamp_anno().sec();
+    s._active_sec = p->timestamp_anno().sec();
 
     // get rid of old fragments
-    int frag_timeout = _active_sec - _fragment_timeout;
+    int frag_timeout = s._active_sec - _fragment_timeout;
     Packet *head;
     while ((head = hpinfo->_fragment_head)
 	   && (head->timestamp_anno().sec() < frag_timeout
 	       || !IP_ISFRAG(good_ip_header(head))))
-	emit_fragment_head(hpinfo);
+	emit_fragment_head(s, hpinfo);
 
     return ACT_NONE;
 }
@@ -497,11 +582,28 @@ AggregateIPFlows::handle_packet(Packet *p)
 	|| (iph->ip_src.s_addr == 0 && iph->ip_dst.s_addr == 0))
 	return ACT_DROP;
 
-    // find relevant HostPairInfo
-    Map &m = (iph->ip_p == IP_PROTO_TCP ? _tcp_map : _udp_map);
+    // find relevant shard
     HostPair hosts(iph->ip_src.s_addr, iph->ip_dst.s_addr);
     if (hosts.a != iph->ip_src.s_addr)
 	paint ^= 1;
+    Shard &s = shard(hosts);
+
+    lock_shard(s);
+    int action = handle_shard_packet(s, p, iph, hosts, paint);
+    // GC if necessary
+    if (s._active_sec >= s._gc_sec)
+	reap(s);
+    if (Packet *heads = unlock_shard(s))
+	push_fragment_heads(heads);
+    return action;
+}
+
+int
+AggregateIPFlows::handle_shard_packet(Shard &s, Packet *p, const click_ip *iph,
+				      const HostPair &hosts, int paint)
+{
+    // find relevant HostPairInfo
+    Map &m = (iph->ip_p == IP_PROTO_TCP ? s._tcp_map : s._udp_map);
     HostPairInfo *hpinfo = &m[hosts];
 
     // find relevant FlowInfo, if any
@@ -520,7 +622,7 @@ AggregateIPFlows::handle_packet(Packet *p)
 	if (paint & 1)
 	    ports = flip_ports(ports);
 
-	finfo = find_flow_info(m, hpinfo, ports, paint & 1, p);
+	finfo = find_flow_info(s, m, hpinfo, ports, paint & 1, p);
 	if (!finfo) {
 	    click_chatter("out of memory!");
 	    return ACT_DROP;
@@ -539,12 +641,12 @@ AggregateIPFlows::handle_packet(Packet *p)
 
     // check for fragment
     if ((_fragments && IP_ISFRAG(iph)) || hpinfo->_fragment_head)
-	return handle_fragment(p, hpinfo);
+	return handle_fragment(s, p, hpinfo);
     else if (!finfo)
 	return ACT_DROP;
 
     // packet emit hook
-    _active_sec = p->timestamp_anno().sec();
+    s._active_sec = p->timestamp_anno().sec();
     packet_emit_hook(p, iph, finfo);
 
     return ACT_EMIT;
@@ -554,11 +656,6 @@ void
 AggregateIPFlows::push(int, Packet *p)
 {
     int action = handle_packet(p);
-
-    // GC if necessary
-    if (_active_sec >= _gc_sec)
-	reap();
-
     if (action == ACT_EMIT)
 	output(0).push(p);
     else if (action == ACT_DROP)
@@ -570,11 +667,6 @@ AggregateIPFlows::pull(int)
 {
     Packet *p = input(0).pull();
     int action = (p ? handle_packet(p) : ACT_NONE);
-
-    // GC if necessary
-    if (_active_sec >= _gc_sec)
-	reap();
-
     if (action == ACT_EMIT)
 	return p;
     else if (action == ACT_DROP)
@@ -582,20 +674,36 @@ AggregateIPFlows::pull(int)
     return 0;
 }
 
-enum { H_CLEAR };
+enum { H_CLEAR, H_SHARDS };
+
+String
+AggregateIPFlows::read_handler(Element *e, void *thunk)
+{
+    AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
+    switch ((intptr_t)thunk) {
+      case H_SHARDS:
+	return String(af->_nshards);
+      default:
+	return String();
+    }
+}
 
 int
 AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
 {
     AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
     switch ((intptr_t)thunk) {
-      case H_CLEAR: {
-	  int active_sec = af->_active_sec, gc_sec = af->_gc_sec;
-	  af->_active_sec = af->_gc_sec = 0x7FFFFFFF;
-	  af->reap();
-	  af->_active_sec = active_sec, af->_gc_sec = gc_sec;
-	  return 0;
-      }
+      case H_CLEAR:
+	for (int i = 0; i < af->_nshards; i++) {
+	    Shard &s = af->_shards[i];
+	    af->lock_shard(s);
+	    int active_sec = s._active_sec, gc_sec = s._gc_sec;
+	    s._active_sec = s._gc_sec = 0x7FFFFFFF;
+	    af->reap(s);
+	    s._active_sec = active_sec, s._gc_sec = gc_sec;
+	    af->push_fragment_heads(af->unlock_shard(s));
+	}
+	return 0;
       default:
 	return -1;
     }
@@ -604,6 +712,7 @@ AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHa
 void
 AggregateIPFlows::add_handlers()
 {
+    add_read_handler("shards", read_handler, H_SHARDS);
     add_write_handler("clear", write_handler, H_CLEAR);
 }
 
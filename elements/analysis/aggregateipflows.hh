@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/ipflowid.hh>
 #include <click/hashtable.hh>
+#include <click/sync.hh>
 #include "aggregatenotifier.hh"
 CLICK_DECLS
 class HandlerCall;
@@ -110,10 +111,28 @@ Boolean. If true, then try to assign aggregate annotations to all fragments.
 May only be set to true if AggregateIPFlows is running in a push context.
 Default is true in a push context and false in a pull context.
 
+=item SHARDS
+
+Positive integer. The number of independent flow tables. Packets are assigned
+to a shard by a symmetric hash of their source and destination addresses, so
+both directions of a flow, its fragments, and related ICMP errors always
+reach the same shard. Each shard has its own lock, reaping schedule, and
+aggregate number sequence, so several threads can push packets through a
+single AggregateIPFlows element without contending for one table. With N
+shards, shard I assigns flow numbers I+1, I+1+N, I+1+2N, and so forth; flow
+numbers remain unique, but are no longer assigned in strict arrival order.
+Default is 1.
+
 =back
 
 AggregateIPFlows is an AggregateNotifier, so AggregateListeners can request
 notifications when new aggregates are created and old ones are deleted.
+Notifications are serialized across shards, so listeners need not be
+thread-safe, and every aggregate's deletion is reported after its creation.
+
+=h shards read-only
+
+Returns the number of shards.
 
 =h clear write-only
 
@@ -209,12 +228,20 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     };
 
     typedef HashTable<HostPair, HostPairInfo> Map;
-    Map _tcp_map;
-    Map _udp_map;
 
-    uint32_t _next;
-    unsigned _active_sec;
-    unsigned _gc_sec;
+    struct Shard {
+	Map _tcp_map;
+	Map _udp_map;
+	uint32_t _next;
+	unsigned _active_sec;
+	unsigned _gc_sec;
+	Packet *_emit_head;	// fragment heads waiting to be pushed
+	Packet *_emit_tail;
+	Spinlock _lock;
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    Shard *_shards;
+    int _nshards;
 
     uint32_t _tcp_timeout;
     uint32_t _tcp_done_timeout;
@@ -227,6 +254,9 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     bool _handle_icmp_errors : 1;
     unsigned _fragments : 2;
     bool _timestamp_warning : 1;
+    bool _lock_shards : 1;
+
+    Spinlock _notify_lock;
 
 #if CLICK_USERLEVEL
     FILE *_traceinfo_file;
@@ -238,25 +268,34 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 
     static const click_ip *icmp_encapsulated_header(const Packet *);
 
+    inline Shard &shard(const HostPair &) const;
+    inline uint32_t new_aggregate(Shard &) const;
+    inline void lock_shard(Shard &);
+    inline Packet *unlock_shard(Shard &);
+    void push_fragment_heads(Packet *);
+    inline void shard_notify(uint32_t, AggregateListener::AggregateEvent, const Packet *);
+
     void clean_map(Map &);
-    void reap_map(Map &, uint32_t, uint32_t);
-    void reap();
+    void reap_map(Shard &, Map &, uint32_t, uint32_t);
+    void reap(Shard &);
 
-    inline int relevant_timeout(const FlowInfo *, const Map &) const;
+    inline int relevant_timeout(const FlowInfo *, const Shard &, const Map &) const;
 #if CLICK_USERLEVEL
     void stat_new_flow_hook(const Packet *, FlowInfo *);
 #endif
     inline void packet_emit_hook(const Packet *, const click_ip *, FlowInfo *);
     inline void delete_flowinfo(const HostPair &, FlowInfo *, bool really_delete = true);
-    void emit_fragment_head(HostPairInfo *hpinfo);
-    FlowInfo *find_flow_info(Map &, HostPairInfo *, uint32_t ports, bool flipped, const Packet *);
+    void emit_fragment_head(Shard &, HostPairInfo *hpinfo);
+    FlowInfo *find_flow_info(Shard &, Map &, HostPairInfo *, uint32_t ports, bool flipped, const Packet *);
 
     FlowInfo *uncommon_case(FlowInfo *finfo, const click_ip *iph);
 
     enum { ACT_EMIT, ACT_DROP, ACT_NONE };
-    int handle_fragment(Packet *, HostPairInfo *);
+    int handle_fragment(Shard &, Packet *, HostPairInfo *);
+    int handle_shard_packet(Shard &, Packet *, const click_ip *, const HostPair &, int paint);
     int handle_packet(Packet *);
 
+    static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
 };
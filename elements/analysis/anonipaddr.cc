@@ -26,6 +26,7 @@
 #include <clicknet/icmp.h>
 #include <click/llrpc.h>
 #include <click/integers.hh>	// for first_bit_set
+#include <click/straccum.hh>
 #ifdef CLICK_USERLEVEL
 # include <unistd.h>
 # include <time.h>
@@ -33,7 +34,8 @@
 CLICK_DECLS
 
 AnonymizeIPAddr::AnonymizeIPAddr()
-    : _root(0), _free(0)
+    : _root(0), _free(0), _cryptopan(false), _cache(0), _cache_mask(0),
+      _cache_hits(0), _cache_misses(0)
 {
 }
 
@@ -63,20 +65,69 @@ rand32()
     return click_random(0, 0xFFFFFFFFU);
 }
 
+static int
+hex_digit(int c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    else if ((c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
+	return (c | 0x20) - 'a' + 10;
+    else
+	return -1;
+}
+
 int
 AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _preserve_class = 0;
-    String preserve_8;
+    String preserve_8, key;
     bool seed_ignored;
+    uint32_t cache_size = 65536;
 
     if (Args(conf, this, errh)
 	.read("CLASS", _preserve_class)
 	.read("PRESERVE_8", AnyArg(), preserve_8)
 	.read("SEED", seed_ignored)
+	.read("KEY", StringArg(), key)
+	.read("CACHE", cache_size)
 	.complete() < 0)
 	return -1;
 
+    // check KEY
+    if (key) {
+	if (key.length() == 64) {
+	    // decode hexadecimal digits
+	    StringAccum sa;
+	    for (int i = 0; i < 64; i += 2) {
+		int hi = hex_digit(key[i]), lo = hex_digit(key[i+1]);
+		if (hi < 0 || lo < 0)
+		    return errh->error("KEY must be 32 bytes or 64 hex digits");
+		sa << (char) ((hi << 4) | lo);
+	    }
+	    key = sa.take_string();
+	} else if (key.length() != 32)
+	    return errh->error("KEY must be 32 bytes or 64 hex digits");
+	if (_preserve_class || preserve_8)
+	    return errh->error("KEY is incompatible with CLASS and PRESERVE_8");
+
+	const unsigned char *k = reinterpret_cast<const unsigned char *>(key.data());
+	_aes.set_key(k);
+	_aes.encrypt(k + AES128::block_size, _pad);
+	_cryptopan = true;
+
+	if (cache_size > (1U << 26))
+	    return errh->error("CACHE too large");
+	_cache_mask = 0;
+	if (cache_size) {
+	    int bits = 1;
+	    while ((1U << bits) < cache_size)
+		++bits;
+	    _cache_mask = (1U << bits) - 1;
+	    _cache_shift = 32 - bits;
+	}
+	return 0;
+    }
+
     // check CLASS value
     if (_preserve_class == 99)	// allow 99 as synonym for 32
 	_preserve_class = 32;
@@ -101,6 +152,15 @@ AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AnonymizeIPAddr::initialize(ErrorHandler *errh)
 {
+    if (_cryptopan) {
+	if (_cache_mask) {
+	    if (!(_cache = new uint64_t[_cache_mask + 1]))
+		return errh->error("out of memory!");
+	    memset(_cache, 0, sizeof(uint64_t) * (_cache_mask + 1));
+	}
+	return 0;
+    }
+
     if (!(_root = new_node()))
 	return errh->error("out of memory!");
     _root->input = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
@@ -144,6 +204,8 @@ AnonymizeIPAddr::cleanup(CleanupStage)
     for (int i = 0; i < _blocks.size(); i++)
 	delete[] _blocks[i];
     _blocks.clear();
+    delete[] _cache;
+    _cache = 0;
 }
 
 uint32_t
@@ -227,15 +289,105 @@ AnonymizeIPAddr::find_node(uint32_t a)
     return 0;
 }
 
+void
+AnonymizeIPAddr::cryptopan(const uint32_t *in, uint32_t *out, int n) const
+{
+    // Bit pos of the one-time pad for address a is the top bit of
+    // AES(a's first pos bits, followed by the rest of _pad). Generate all
+    // blocks for a group of addresses first, so encrypt_blocks can overlap
+    // their encryptions.
+    enum { group = 4, nblocks = group * 32 };
+    unsigned char blocks[nblocks * AES128::block_size] CLICK_ALIGNED(16);
+    uint32_t pad_first4 = (_pad[0] << 24) | (_pad[1] << 16) | (_pad[2] << 8)
+	| _pad[3];
+
+    for (int g = 0; g < n; g += group) {
+	int ng = (n - g < group ? n - g : group);
+
+	unsigned char *b = blocks;
+	for (int j = g; j < g + ng; ++j)
+	    for (int pos = 0; pos < 32; ++pos, b += AES128::block_size) {
+		uint32_t mask = (pos ? 0xFFFFFFFFU << (32 - pos) : 0);
+		uint32_t x = (in[j] & mask) | (pad_first4 & ~mask);
+		b[0] = x >> 24;
+		b[1] = x >> 16;
+		b[2] = x >> 8;
+		b[3] = x;
+		memcpy(b + 4, _pad + 4, AES128::block_size - 4);
+	    }
+
+	_aes.encrypt_blocks(blocks, blocks, ng * 32);
+
+	b = blocks;
+	for (int j = g; j < g + ng; ++j) {
+	    uint32_t otp = 0;
+	    for (int pos = 0; pos < 32; ++pos, b += AES128::block_size)
+		otp |= (uint32_t) (b[0] >> 7) << (31 - pos);
+	    out[j] = in[j] ^ otp;
+	}
+    }
+}
+
+void
+AnonymizeIPAddr::cryptopan_addrs(uint32_t *a, int n)
+{
+    // a is in network byte order; n is small (one packet's addresses)
+    uint32_t miss_in[4], miss_out[4];
+    int miss_index[4], nmiss = 0;
+    assert(n <= 4);
+
+    for (int i = 0; i < n; ++i) {
+	uint32_t x = ntohl(a[i]);
+	if (x == 0 || x == 0xFFFFFFFFU)
+	    continue;
+	if (_cache) {
+	    uint64_t e = _cache[cache_slot(x)];
+	    if ((uint32_t) (e >> 32) == x) {
+		a[i] = htonl((uint32_t) e);
+		++_cache_hits;
+		continue;
+	    }
+	}
+	miss_in[nmiss] = x;
+	miss_index[nmiss] = i;
+	++nmiss;
+    }
+
+    if (nmiss) {
+	cryptopan(miss_in, miss_out, nmiss);
+	for (int k = 0; k < nmiss; ++k) {
+	    a[miss_index[k]] = htonl(miss_out[k]);
+	    if (_cache)
+		_cache[cache_slot(miss_in[k])] =
+		    ((uint64_t) miss_in[k] << 32) | miss_out[k];
+	}
+	_cache_misses += nmiss;
+    }
+}
+
 inline uint32_t
 AnonymizeIPAddr::anonymize_addr(uint32_t a)
 {
-    if (Node *n = find_node(ntohl(a)))
+    if (_cryptopan) {
+	cryptopan_addrs(&a, 1);
+	return a;
+    } else if (Node *n = find_node(ntohl(a)))
 	return htonl(n->output);
     else
 	return 0;
 }
 
+inline void
+AnonymizeIPAddr::anonymize_pair(uint32_t *a)
+{
+    if (_cryptopan)
+	cryptopan_addrs(a, 2);
+    else {
+	a[0] = anonymize_addr(a[0]);
+	a[1] = anonymize_addr(a[1]);
+    }
+}
+
 void
 AnonymizeIPAddr::handle_icmp(WritablePacket *q)
 {
@@ -251,15 +403,18 @@ AnonymizeIPAddr::handle_icmp(WritablePacket *q)
 	    || hlen < sizeof(click_ip))
 	    return;
 
-	uint32_t src = embedded_iph->ip_src.s_addr, dst = embedded_iph->ip_dst.s_addr;
+	uint32_t a[2];
+	uint32_t src = a[0] = embedded_iph->ip_src.s_addr;
+	uint32_t dst = a[1] = embedded_iph->ip_dst.s_addr;
 
 	// incrementally update IP checksum according to RFC1624:
 	// new_sum = ~(~old_sum + ~old_halfword + new_halfword)
 	uint32_t icmp_sum = (~icmph->icmp_cksum & 0xFFFF)
 	    + (~src & 0xFFFF) + (~src >> 16) + (~dst & 0xFFFF) + (~dst >> 16);
 
-	embedded_iph->ip_src.s_addr = src = anonymize_addr(src);
-	embedded_iph->ip_dst.s_addr = dst = anonymize_addr(dst);
+	anonymize_pair(a);
+	embedded_iph->ip_src.s_addr = src = a[0];
+	embedded_iph->ip_dst.s_addr = dst = a[1];
 
 	icmp_sum += (src & 0xFFFF) + (src >> 16) + (dst & 0xFFFF) + (dst >> 16);
 	icmp_sum = (icmp_sum & 0xFFFF) + (icmp_sum >> 16);
@@ -278,15 +433,18 @@ AnonymizeIPAddr::simple_action(Packet *p)
 	return 0;
     } else if (WritablePacket *q = p->uniqueify()) {
 	click_ip *iph = q->ip_header();
-	uint32_t src = iph->ip_src.s_addr, dst = iph->ip_dst.s_addr;
+	uint32_t a[2];
+	uint32_t src = a[0] = iph->ip_src.s_addr;
+	uint32_t dst = a[1] = iph->ip_dst.s_addr;
 
 	// incrementally update IP checksum according to RFC1624:
 	// new_sum = ~(~old_sum + ~old_halfword + new_halfword)
 	uint32_t sum = (~iph->ip_sum & 0xFFFF)
 	    + (~src & 0xFFFF) + (~src >> 16) + (~dst & 0xFFFF) + (~dst >> 16);
 
-	iph->ip_src.s_addr = src = anonymize_addr(src);
-	iph->ip_dst.s_addr = dst = anonymize_addr(dst);
+	anonymize_pair(a);
+	iph->ip_src.s_addr = src = a[0];
+	iph->ip_dst.s_addr = dst = a[1];
 
 	sum += (src & 0xFFFF) + (src >> 16) + (dst & 0xFFFF) + (dst >> 16);
 	sum = (sum & 0xFFFF) + (sum >> 16);
@@ -301,6 +459,15 @@ AnonymizeIPAddr::simple_action(Packet *p)
 	return 0;
 }
 
+void
+AnonymizeIPAddr::add_handlers()
+{
+    if (_cryptopan) {
+	add_data_handlers("cache_hits", Handler::OP_READ, &_cache_hits);
+	add_data_handlers("cache_misses", Handler::OP_READ, &_cache_misses);
+    }
+}
+
 int
 AnonymizeIPAddr::llrpc(unsigned command, void *data)
 {
@@ -2,12 +2,13 @@
 #ifndef CLICK_ANONIPADDR_HH
 #define CLICK_ANONIPADDR_HH
 #include <click/element.hh>
+#include <click/aes128.hh>
 CLICK_DECLS
 
 /*
 =c
 
-AnonymizeIPAddr
+AnonymizeIPAddr([I<KEYWORDS>])
 
 =s ip
 
@@ -32,6 +33,16 @@ AnonymizeIPAddr only manipulates the IP header pointed to by the IP header
 annotation. This differs from tcpdpriv, which also anonymizes addresses on
 encapsulated IP headers for protocol 4 (ipip).
 
+If a KEY is given, AnonymizeIPAddr uses the Crypto-PAn algorithm instead of
+tcpdpriv's. Crypto-PAn is also prefix-preserving, but its mapping is a keyed
+function of the address alone: two AnonymizeIPAddr elements, or two runs
+over different traces, produce the same output addresses given the same KEY,
+and the mapping does not depend on the order in which addresses are seen.
+Each address costs 32 AES encryptions; AnonymizeIPAddr encrypts a packet's
+addresses together, using AES-NI instructions where available, and
+remembers recent mappings in a cache. Without a KEY, the mapping is random
+and differs from run to run.
+
 Keyword arguments are:
 
 =over 8
@@ -46,6 +57,19 @@ preserves classes A, B, C, and D. The CLASS flag works by preserving leading
 one bits; higher CLASSes, up to 32, preserve more one bits. Default CLASS is 0
 E<lparen>no preservation).
 
+=item KEY
+
+String. A 32-byte Crypto-PAn key, given either as 64 hexadecimal digits or
+as a 32-byte string. The first 16 bytes are the AES key; the second 16 bytes
+determine the padding. Supplying KEY selects Crypto-PAn anonymization. KEY
+cannot be combined with CLASS or PRESERVE_8.
+
+=item CACHE
+
+Unsigned. The number of entries in the Crypto-PAn mapping cache, rounded up
+to a power of two. The cache is direct-mapped, and each entry takes 8 bytes.
+Zero disables the cache. Default is 65536.
+
 =item PRESERVE_8
 
 Space-separated list of integers. Preserve the listed 8-bit prefixes. For
@@ -81,15 +105,35 @@ very concerned about leaking your network topology, I would not
 recommend giving out trace information privatized with the I<-A50>
 option.  I wouldn't expect this to be the case for most organizations."
 
+=h cache_hits read-only
+
+Returns the number of Crypto-PAn cache hits. Only available with KEY.
+
+=h cache_misses read-only
+
+Returns the number of Crypto-PAn cache misses. Only available with KEY.
+
 =h CLICK_LLRPC_MAP_IPADDRESS llrpc
 
 Argument is a pointer to an IP address. An IP address is read from that
 location; the corresponding anonymized IP address is then stored into that
 location.
 
+=e
+
+Anonymize a trace reproducibly:
+
+  FromDump(trace.pcap, STOP true, FORCE_IP true)
+      -> AnonymizeIPAddr(KEY 3d3f5a8c0e7b4d6a91c2e4f60718293a4b5c6d7e8f90a1b2c3d4e5f60718293a)
+      -> ToDump(anon.pcap);
+
 =a
 
-tcpdpriv(1) */
+tcpdpriv(1)
+
+J. Xu, J. Fan, M. Ammar, and S. Moon, "Prefix-Preserving IP Address
+Anonymization: Measurement-based Security Evaluation and a New
+Cryptography-based Scheme", Proc. ICNP 2002. */
 
 class AnonymizeIPAddr : public Element { public:
 
@@ -102,6 +146,7 @@ class AnonymizeIPAddr : public Element { public:
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
     void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
 
     Packet *simple_action(Packet *);
 
@@ -123,6 +168,18 @@ class AnonymizeIPAddr : public Element { public:
     int _preserve_class;
     Vector<uint32_t> _preserve_8;
 
+    // Crypto-PAn state. Cache entries hold (input << 32) | output, both in
+    // host order, so a zeroed entry correctly maps 0.0.0.0 to itself and a
+    // racing reader never sees half an entry.
+    bool _cryptopan;
+    AES128 _aes;
+    unsigned char _pad[AES128::block_size];
+    uint64_t *_cache;
+    uint32_t _cache_mask;
+    int _cache_shift;
+    uint32_t _cache_hits;
+    uint32_t _cache_misses;
+
     Node *new_node();
     Node *new_node_block();
     void free_node(Node *);
@@ -131,6 +188,11 @@ class AnonymizeIPAddr : public Element { public:
     Node *make_peer(uint32_t, Node *);
     Node *find_node(uint32_t);
     inline uint32_t anonymize_addr(uint32_t);
+    inline void anonymize_pair(uint32_t *);
+
+    inline uint32_t cache_slot(uint32_t) const;
+    void cryptopan(const uint32_t *, uint32_t *, int) const;
+    void cryptopan_addrs(uint32_t *, int);
 
     void handle_icmp(WritablePacket *);
 
@@ -154,5 +216,11 @@ AnonymizeIPAddr::free_node(Node *n)
     _free = n;
 }
 
+inline uint32_t
+AnonymizeIPAddr::cache_slot(uint32_t a) const
+{
+    return (a * 0x9E3779B1U) >> _cache_shift;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -27,9 +27,9 @@
 CLICK_DECLS
 
 TimeSortedSched::TimeSortedSched()
-    : _pkt(0), _npkt(0), _input(0), _nready(0),
-      _notifier(Notifier::SEARCH_CONTINUE_WAKE), _buffer(1),
-      _well_ordered(true)
+    : _pkt(0), _npkt(0), _input(0), _nready(0), _tree(0), _tree_size(1),
+      _tree_dirty(false), _notifier(Notifier::SEARCH_CONTINUE_WAKE),
+      _buffer(1), _well_ordered(true), _disordered(0), _drops(0)
 {
 }
 
@@ -50,10 +50,11 @@ int
 TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _notifier.initialize(Notifier::EMPTY_NOTIFIER, router());
-    _stop = false;
+    _stop = _drop_disordered = false;
     if (Args(conf, this, errh)
 	.read("STOP", _stop)
 	.read("BUFFER", _buffer)
+	.read("DROP_DISORDERED", _drop_disordered)
 	.complete() < 0)
 	return -1;
     if (_buffer <= 0)
@@ -64,9 +65,12 @@ TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 TimeSortedSched::initialize(ErrorHandler *errh)
 {
-    _pkt = new packet_s[ninputs() * _buffer];
+    while (_tree_size < ninputs())
+	_tree_size *= 2;
+    _pkt = new Packet *[ninputs() * _buffer];
     _input = new input_s[ninputs()];
-    if (!_pkt || !_input)
+    _tree = new int[_tree_size];
+    if (!_pkt || !_input || !_tree)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++) {
 	_input[i].signal = Notifier::upstream_empty_signal(this, i, &_notifier);
@@ -74,64 +78,145 @@ TimeSortedSched::initialize(ErrorHandler *errh)
 	_input[i].ready = i;
     }
     _nready = ninputs();
+    rebuild_tree();
     return 0;
 }
 
 void
 TimeSortedSched::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _npkt; ++i)
-	_pkt[i].p->kill();
+    if (_input && _pkt)
+	for (int i = 0; i < ninputs(); ++i)
+	    for (int j = 0; j < _buffer - _input[i].space; ++j)
+		_pkt[i * _buffer + j]->kill();
     delete[] _pkt;
     delete[] _input;
+    delete[] _tree;
 }
 
-Packet*
+inline bool
+TimeSortedSched::input_less(int a, int b) const
+{
+    Packet *pa = head(a), *pb = head(b);
+    if (!pa)
+	return false;
+    else if (!pb)
+	return true;
+    else
+	return pa->timestamp_anno() < pb->timestamp_anno()
+	    || (pa->timestamp_anno() == pb->timestamp_anno() && a < b);
+}
+
+void
+TimeSortedSched::replay(int i)
+{
+    // Valid only when i is the current winner, which is the common case:
+    // the winner's head changes whenever a packet is emitted.
+    int winner = i;
+    for (int pos = (_tree_size + i) >> 1; pos > 0; pos >>= 1)
+	if (input_less(_tree[pos], winner)) {
+	    int t = _tree[pos];
+	    _tree[pos] = winner;
+	    winner = t;
+	}
+    _tree[0] = winner;
+}
+
+int
+TimeSortedSched::play(int pos)
+{
+    if (pos >= _tree_size)
+	return pos - _tree_size;
+    int a = play(2 * pos), b = play(2 * pos + 1);
+    if (input_less(b, a)) {
+	_tree[pos] = a;
+	return b;
+    } else {
+	_tree[pos] = b;
+	return a;
+    }
+}
+
+void
+TimeSortedSched::rebuild_tree()
+{
+    _tree[0] = play(1);
+    _tree_dirty = false;
+}
+
+Packet *
 TimeSortedSched::pull(int)
 {
-    bool signals_on = false;
-    // first maybe fill in buffer
-    for (int rpos = _nready - 1; rpos >= 0; --rpos) {
-	int i = _input[rpos].ready;
-	input_s &is = _input[i];
-	if (is.signal) {
-	    signals_on = true;
-	    while ((_pkt[_npkt].p = input(i).pull())) {
-		_pkt[_npkt].input = i;
-		++_npkt;
-		push_heap(_pkt, _pkt + _npkt, heap_less());
-		--is.space;
-		if (!is.space) {
-		    _input[rpos].ready = _input[_nready - 1].ready;
-		    --_nready;
-		    break;
+    while (1) {
+	bool signals_on = false;
+	// first maybe fill in buffers
+	for (int rpos = _nready - 1; rpos >= 0; --rpos) {
+	    int i = _input[rpos].ready;
+	    input_s &is = _input[i];
+	    if (is.signal) {
+		signals_on = true;
+		Packet **heap = _pkt + i * _buffer;
+		Packet *old_head = head(i);
+		int n = _buffer - is.space;
+		while (Packet *p = input(i).pull()) {
+		    heap[n] = p;
+		    ++n;
+		    push_heap(heap, heap + n, heap_less());
+		    ++_npkt;
+		    --is.space;
+		    if (!is.space) {
+			_input[rpos].ready = _input[_nready - 1].ready;
+			--_nready;
+			break;
+		    }
+		}
+		// a new earliest packet for a losing input invalidates the
+		// tree; rebuild it once after all inputs are filled
+		if (head(i) != old_head) {
+		    if (i == _tree[0] && !_tree_dirty)
+			replay(i);
+		    else
+			_tree_dirty = true;
 		}
 	    }
 	}
-    }
+	if (_tree_dirty)
+	    rebuild_tree();
 
-    // then maybe emit a packet
-    _notifier.set_active(_npkt > 0 || signals_on);
-    if (_npkt > 0) {
-	Packet *p = _pkt[0].p;
-	if (p->timestamp_anno()) {
-	    if (_last_emission && p->timestamp_anno() < _last_emission)
-		_well_ordered = false;
-	    _last_emission = p->timestamp_anno();
+	// then maybe emit a packet
+	_notifier.set_active(_npkt > 0 || signals_on);
+	int i = _tree[0];
+	Packet *p = head(i);
+	if (!p) {
+	    if (_stop && !signals_on)
+		router()->please_stop_driver();
+	    return 0;
 	}
-	input_s &is = _input[_pkt[0].input];
+
+	input_s &is = _input[i];
+	Packet **heap = _pkt + i * _buffer;
+	pop_heap(heap, heap + _buffer - is.space, heap_less());
 	++is.space;
+	--_npkt;
 	if (is.space == 1) {
-	    _input[_nready].ready = _pkt[0].input;
+	    _input[_nready].ready = i;
 	    ++_nready;
 	}
-	pop_heap(_pkt, _pkt + _npkt, heap_less());
-	--_npkt;
+	replay(i);
+
+	if (p->timestamp_anno()) {
+	    if (_last_emission && p->timestamp_anno() < _last_emission) {
+		_well_ordered = false;
+		++_disordered;
+		if (_drop_disordered) {
+		    ++_drops;
+		    p->kill();
+		    continue;
+		}
+	    }
+	    _last_emission = p->timestamp_anno();
+	}
 	return p;
-    } else {
-	if (_stop && !signals_on)
-	    router()->please_stop_driver();
-	return 0;
     }
 }
 
@@ -139,6 +224,9 @@ void
 TimeSortedSched::add_handlers()
 {
     add_data_handlers("well_ordered", Handler::OP_READ | Handler::CHECKBOX, &_well_ordered);
+    add_data_handlers("disordered", Handler::OP_READ, &_disordered);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_data_handlers("buffered", Handler::OP_READ, &_npkt);
 }
 
 CLICK_ENDDECLS
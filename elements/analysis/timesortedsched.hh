@@ -8,7 +8,7 @@ CLICK_DECLS
 /*
 =c
 
-TimeSortedSched(I<keywords> STOP, BUFFER)
+TimeSortedSched(I<keywords> STOP, BUFFER, DROP_DISORDERED)
 
 =s timestamps
 
@@ -31,6 +31,14 @@ TimeSortedSched emitted some packets out of order.  (But see BUFFER, below.)
 TimeSortedSched listens for notification from its inputs to avoid useless
 pulls, and provides notification for its output.
 
+TimeSortedSched keeps a small heap of buffered packets for each input, and
+selects among inputs with a loser tree, so each emitted packet costs about
+log2(I<N>) timestamp comparisons for I<N> inputs. An input is pulled
+only when its buffer has room, and then repeatedly until the buffer is full
+or the input runs dry, so upstream elements see bursts of pulls rather
+than one pull per emitted packet. This makes merges of hundreds of
+inputs practical.
+
 Keyword arguments are:
 
 =over 8
@@ -47,6 +55,12 @@ Integer. Up to BUFFER packets per input are buffered within
 TimeSortedSched. Default BUFFER is 1. Higher BUFFER values let TimeSortedSched
 cope with minor reordering in its input streams.
 
+=item DROP_DISORDERED
+
+Boolean. If true, then TimeSortedSched drops packets that would be emitted
+out of order (that is, packets with timestamps earlier than the previously
+emitted packet), so its output is always sorted. Default is false.
+
 =back
 
 =n
@@ -70,7 +84,20 @@ stream, and stops the driver when all the files are exhausted.
 
 Returns a Boolean string. If "false", then TimeSortedSched's output was not
 properly sorted by increasing timestamp, because one or more of its input
-streams was not so sorted.
+streams was not so sorted. With DROP_DISORDERED, returns "false" if any
+packets were dropped.
+
+=h disordered r
+
+Returns the number of packets that arrived too late to be emitted in order.
+
+=h drops r
+
+Returns the number of packets dropped by DROP_DISORDERED.
+
+=h buffered r
+
+Returns the number of packets currently buffered.
 
 =a
 
@@ -97,13 +124,9 @@ class TimeSortedSched : public Element { public:
 
   private:
 
-    struct packet_s {
-	Packet *p;
-	int input;		// for space, consider using annotation?
-    };
     struct heap_less {
-	inline bool operator()(packet_s &a, packet_s &b) {
-	    return a.p->timestamp_anno() < b.p->timestamp_anno();
+	inline bool operator()(Packet *a, Packet *b) {
+	    return a->timestamp_anno() < b->timestamp_anno();
 	}
     };
     struct input_s {
@@ -112,17 +135,38 @@ class TimeSortedSched : public Element { public:
 	int ready;
     };
 
-    packet_s *_pkt;
+    // Input i's buffered packets form a heap at _pkt[i*_buffer], with
+    // _buffer - _input[i].space elements.
+    Packet **_pkt;
     int _npkt;
 
     input_s *_input;
     int _nready;
 
+    // Loser tree over inputs. _tree[0] is the input with the earliest
+    // buffered packet; _tree[k], 0 < k < _tree_size, is the input that lost
+    // the match at internal node k. Leaves are inputs padded to a power of
+    // two; empty inputs and padding sort last.
+    int *_tree;
+    int _tree_size;
+    bool _tree_dirty;
+
     Notifier _notifier;
     int _buffer;
     Timestamp _last_emission;
     bool _stop;
+    bool _drop_disordered;
     bool _well_ordered;
+    uint32_t _disordered;
+    uint32_t _drops;
+
+    inline Packet *head(int i) const {
+	return (i < ninputs() && _input[i].space < _buffer ? _pkt[i * _buffer] : 0);
+    }
+    inline bool input_less(int a, int b) const;
+    void replay(int i);
+    int play(int pos);
+    void rebuild_tree();
 
 };
 
@@ -0,0 +1,430 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * toipfix.{cc,hh} -- export flows as IPFIX or NetFlow v9 records
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "toipfix.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+CLICK_DECLS
+
+// Template fields: IANA information element ID and length.
+static const uint16_t template_fields[][2] = {
+    { 8, 4 },			// sourceIPv4Address
+    { 12, 4 },			// destinationIPv4Address
+    { 7, 2 },			// sourceTransportPort
+    { 11, 2 },			// destinationTransportPort
+    { 4, 1 },			// protocolIdentifier
+    { 6, 1 },			// tcpControlBits
+    { 136, 1 },			// flowEndReason
+    { 2, 8 },			// packetDeltaCount
+    { 1, 8 },			// octetDeltaCount
+    { 152, 8 },			// flowStartMilliseconds
+    { 153, 8 }			// flowEndMilliseconds
+};
+enum {
+    NFIELDS = sizeof(template_fields) / sizeof(template_fields[0]),
+    RECORD_SIZE = 47
+};
+
+static inline void
+put16(char *x, uint16_t v)
+{
+    x[0] = v >> 8;
+    x[1] = v;
+}
+
+static inline void
+put32(char *x, uint32_t v)
+{
+    put16(x, v >> 16);
+    put16(x + 2, v);
+}
+
+static inline void
+put64(char *x, uint64_t v)
+{
+    put32(x, v >> 32);
+    put32(x + 4, v);
+}
+
+ToIPFIX::ToIPFIX()
+    : _agg_notifier(0), _f(0), _flush_timer(flush_hook, this),
+      _push_output(false), _msg_records(0), _set_offset(-1),
+      _msg_template(false), _out_head(0), _out_tail(0), _nrecords(0), _nmessages(0), _nevictions(0)
+{
+}
+
+ToIPFIX::~ToIPFIX()
+{
+}
+
+int
+ToIPFIX::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element *e = 0;
+    _version = 10;
+    _mtu = 1400;
+    _max_flows = 65536;
+    _template_refresh = 20;
+    _domain = 0;
+    _flush_interval_ms = 1000;
+
+    if (Args(conf, this, errh)
+	.read("NOTIFIER", e)
+	.read("FILENAME", FilenameArg(), _filename)
+	.read("VERSION", _version)
+	.read("MTU", _mtu)
+	.read("MAX_FLOWS", _max_flows)
+	.read("FLUSH_INTERVAL", SecondsArg(3), _flush_interval_ms)
+	.read("TEMPLATE_REFRESH", _template_refresh)
+	.read("DOMAIN", _domain)
+	.complete() < 0)
+	return -1;
+
+    if (e && !(_agg_notifier = (AggregateNotifier *)e->cast("AggregateNotifier")))
+	return errh->error("%s is not an AggregateNotifier", e->name().c_str());
+    if (_version != 9 && _version != 10)
+	return errh->error("VERSION must be 9 or 10");
+    if (_mtu < 128 || _mtu > 65535)
+	return errh->error("MTU out of range");
+    if (_max_flows == 0)
+	return errh->error("MAX_FLOWS must be positive");
+    if (_template_refresh == 0)
+	_template_refresh = 1;
+    if (!_filename && noutputs() < 2)
+	errh->warning("no FILENAME and no output 1, so records will be discarded");
+    return 0;
+}
+
+int
+ToIPFIX::initialize(ErrorHandler *errh)
+{
+    if (_filename == "-")
+	_f = stdout;
+    else if (_filename && !(_f = fopen(_filename.c_str(), "wb")))
+	return errh->error("%s: %s", _filename.c_str(), strerror(errno));
+    if (_agg_notifier)
+	_agg_notifier->add_listener(this);
+    _flush_timer.initialize(this);
+    _push_output = noutputs() > 1;
+    return 0;
+}
+
+void
+ToIPFIX::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_ROUTER_INITIALIZED) {
+	// Downstream elements may already be gone, so final records go only
+	// to FILENAME.
+	_push_output = false;
+	export_all(END_FORCED);
+	finish_message();
+    }
+    for (Table::iterator it = _table.begin(); it; ) {
+	Flow *f = _table.erase(it);
+	f->~Flow();
+	_alloc.deallocate(f);
+    }
+    _age.__clear();
+    if (_f && _f != stdout)
+	fclose(_f);
+    _f = 0;
+}
+
+void
+ToIPFIX::begin_message()
+{
+    _msg.clear();
+    _msg.extend(_version == 10 ? 16 : 20);
+    _msg_records = 0;
+    _set_offset = -1;
+
+    _msg_template = (_nmessages % _template_refresh == 0);
+    if (_msg_template) {
+	char *x = _msg.extend(8 + 4 * NFIELDS);
+	put16(x, _version == 10 ? 2 : 0);
+	put16(x + 2, 8 + 4 * NFIELDS);
+	put16(x + 4, TEMPLATE_ID);
+	put16(x + 6, NFIELDS);
+	for (int i = 0; i < NFIELDS; ++i) {
+	    put16(x + 8 + 4 * i, template_fields[i][0]);
+	    put16(x + 10 + 4 * i, template_fields[i][1]);
+	}
+    }
+}
+
+void
+ToIPFIX::finish_message()
+{
+    if (!_msg_records)
+	return;
+
+    // close the data set, padding it to a 4-byte boundary
+    while ((_msg.length() - _set_offset) & 3)
+	_msg << '\0';
+    put16(_msg.data() + _set_offset + 2, _msg.length() - _set_offset);
+
+    Timestamp now = _last_timestamp ? _last_timestamp : Timestamp::now();
+    char *x = _msg.data();
+    put16(x, _version);
+    if (_version == 10) {
+	put16(x + 2, _msg.length());
+	put32(x + 4, now.sec());
+	put32(x + 8, _nrecords);
+	put32(x + 12, _domain);
+    } else {
+	put16(x + 2, _msg_records + _msg_template);
+	put32(x + 4, (now - _first_timestamp).msecval());
+	put32(x + 8, now.sec());
+	put32(x + 12, _nmessages);
+	put32(x + 16, _domain);
+    }
+
+    if (_f)
+	ignore_result(fwrite(_msg.data(), 1, _msg.length(), _f));
+    if (_push_output)
+	if (WritablePacket *p = Packet::make(_msg.data(), _msg.length())) {
+	    // pushed by release_lock(), once _lock is released
+	    p->timestamp_anno() = now;
+	    if (_out_tail)
+		_out_tail->set_next(p);
+	    else
+		_out_head = p;
+	    _out_tail = p;
+	}
+
+    _nrecords += _msg_records;
+    _nmessages++;
+    _msg_records = 0;
+    _set_offset = -1;
+    _msg.clear();
+}
+
+void
+ToIPFIX::release_lock()
+{
+    Packet *p = _out_head;
+    _out_head = _out_tail = 0;
+    _lock.release();
+    while (p) {
+	Packet *next = p->next();
+	p->set_next(0);
+	output(1).push(p);
+	p = next;
+    }
+}
+
+void
+ToIPFIX::add_record(const Flow *f, int dir, int reason)
+{
+    // leave room for a set header and padding
+    if (_msg_records && _msg.length() + RECORD_SIZE + 3 > (int) _mtu)
+	finish_message();
+    if (!_msg_records)
+	begin_message();
+    if (_set_offset < 0) {
+	_set_offset = _msg.length();
+	char *x = _msg.extend(4);
+	put16(x, TEMPLATE_ID);
+    }
+
+    const Direction &d = f->_dir[dir];
+    IPFlowID flowid = (dir ? f->_flowid.reverse() : f->_flowid);
+    char *x = _msg.extend(RECORD_SIZE);
+    put32(x, ntohl(flowid.saddr().addr()));
+    put32(x + 4, ntohl(flowid.daddr().addr()));
+    put16(x + 8, ntohs(flowid.sport()));
+    put16(x + 10, ntohs(flowid.dport()));
+    x[12] = f->_ip_p;
+    x[13] = d.tcp_flags;
+    x[14] = reason;
+    put64(x + 15, d.packets);
+    put64(x + 23, d.bytes);
+    put64(x + 31, d.first.msecval());
+    put64(x + 39, d.last.msecval());
+    _msg_records++;
+
+    if (_flush_interval_ms && !_flush_timer.scheduled())
+	_flush_timer.schedule_after_msec(_flush_interval_ms);
+}
+
+void
+ToIPFIX::export_flow(Flow *f, int reason)
+{
+    for (int dir = 0; dir < 2; ++dir)
+	if (f->_dir[dir].packets)
+	    add_record(f, dir, reason);
+    _table.erase(f->_aggregate);
+    _age.erase(f);
+    f->~Flow();
+    _alloc.deallocate(f);
+}
+
+void
+ToIPFIX::export_all(int reason)
+{
+    while (Flow *f = _age.front())
+	export_flow(f, reason);
+}
+
+inline void
+ToIPFIX::smaction(Packet *p)
+{
+    uint32_t agg = AGGREGATE_ANNO(p);
+    int paint = PAINT_ANNO(p);
+    const click_ip *iph = p->ip_header();
+    if (!agg || paint >= 2 || !p->has_network_header()
+	|| (iph->ip_p != IP_PROTO_TCP && iph->ip_p != IP_PROTO_UDP))
+	return;
+
+    const Timestamp &ts = p->timestamp_anno();
+    _lock.acquire();
+    if (!_first_timestamp)
+	_first_timestamp = ts;
+    _last_timestamp = ts;
+
+    Table::iterator it = _table.find(agg);
+    Flow *f;
+    if (!it) {
+	if (_table.size() >= _max_flows) {
+	    export_flow(_age.front(), END_RESOURCES);
+	    _nevictions++;
+	    it = _table.find(agg);
+	}
+	void *x = _alloc.allocate();
+	if (!x) {
+	    release_lock();
+	    return;
+	}
+	f = new(x) Flow(agg);
+	if (IP_FIRSTFRAG(iph) && p->transport_length() >= 4)
+	    f->_flowid = IPFlowID(p, paint & 1);
+	else if (paint & 1)
+	    f->_flowid = IPFlowID(iph->ip_dst, 0, iph->ip_src, 0);
+	else
+	    f->_flowid = IPFlowID(iph->ip_src, 0, iph->ip_dst, 0);
+	f->_ip_p = iph->ip_p;
+	_table.set(it, f);
+	_age.push_back(f);
+    } else {
+	f = it.get();
+	_age.erase(f);
+	_age.push_back(f);
+    }
+
+    Direction &d = f->_dir[paint & 1];
+    if (!d.packets)
+	d.first = ts;
+    d.last = ts;
+    d.packets++;
+    d.bytes += ntohs(iph->ip_len);
+    if (iph->ip_p == IP_PROTO_TCP && IP_FIRSTFRAG(iph)
+	&& p->transport_length() >= 14)
+	d.tcp_flags |= p->tcp_header()->th_flags;
+
+    _table.balance();
+    release_lock();
+}
+
+void
+ToIPFIX::push(int, Packet *p)
+{
+    smaction(p);
+    output(0).push(p);
+}
+
+Packet *
+ToIPFIX::pull(int)
+{
+    Packet *p = input(0).pull();
+    if (p)
+	smaction(p);
+    return p;
+}
+
+void
+ToIPFIX::aggregate_notify(uint32_t agg, AggregateEvent event, const Packet *)
+{
+    if (event != DELETE_AGG)
+	return;
+    _lock.acquire();
+    if (Flow *f = _table.get(agg)) {
+	uint8_t flags = f->_dir[0].tcp_flags | f->_dir[1].tcp_flags;
+	export_flow(f, flags & (TH_FIN | TH_RST) ? END_DETECTED : END_IDLE);
+    }
+    release_lock();
+}
+
+void
+ToIPFIX::flush_hook(Timer *, void *thunk)
+{
+    ToIPFIX *fx = static_cast<ToIPFIX *>(thunk);
+    fx->_lock.acquire();
+    fx->finish_message();
+    fx->release_lock();
+}
+
+enum { H_FLUSH, H_COUNT, H_RECORDS, H_MESSAGES, H_EVICTIONS };
+
+String
+ToIPFIX::read_handler(Element *e, void *thunk)
+{
+    ToIPFIX *fx = static_cast<ToIPFIX *>(e);
+    switch ((intptr_t)thunk) {
+      case H_COUNT:
+	return String(fx->_table.size());
+      case H_RECORDS:
+	return String(fx->_nrecords);
+      case H_MESSAGES:
+	return String(fx->_nmessages);
+      case H_EVICTIONS:
+	return String(fx->_nevictions);
+      default:
+	return "<error>";
+    }
+}
+
+int
+ToIPFIX::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+    ToIPFIX *fx = static_cast<ToIPFIX *>(e);
+    switch ((intptr_t)thunk) {
+      case H_FLUSH:
+	fx->_lock.acquire();
+	fx->export_all(END_FORCED);
+	fx->finish_message();
+	fx->release_lock();
+	return 0;
+      default:
+	return -1;
+    }
+}
+
+void
+ToIPFIX::add_handlers()
+{
+    add_write_handler("flush", write_handler, H_FLUSH);
+    add_read_handler("count", read_handler, H_COUNT);
+    add_read_handler("records", read_handler, H_RECORDS);
+    add_read_handler("messages", read_handler, H_MESSAGES);
+    add_read_handler("evictions", read_handler, H_EVICTIONS);
+}
+
+ELEMENT_REQUIRES(userlevel AggregateNotifier)
+EXPORT_ELEMENT(ToIPFIX)
+CLICK_ENDDECLS
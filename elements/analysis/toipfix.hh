@@ -0,0 +1,239 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TOIPFIX_HH
+#define CLICK_TOIPFIX_HH
+#include <click/element.hh>
+#include <click/ipflowid.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/list.hh>
+#include <click/straccum.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+#include "aggregatenotifier.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ToIPFIX([I<KEYWORDS>])
+
+=s traces
+
+exports TCP/UDP flows as IPFIX or NetFlow v9 records
+
+=d
+
+ToIPFIX keeps per-flow packet and byte counts for TCP and UDP flows,
+distinguished by their aggregate annotations, and exports a record for each
+direction of a flow when the flow ends. Records are batched into IPFIX (RFC
+7011) or NetFlow version 9 (RFC 3954) export messages, each of which fits in
+one UDP datagram. Messages are written to FILENAME, emitted as packets on
+output 1, or both. You usually will run ToIPFIX downstream of an
+AggregateIPFlows element, and supply that element as NOTIFIER.
+
+Packets arriving on input 0 are passed unchanged to output 0. Packets with
+zero aggregate annotations, packets that are not TCP or UDP, and ICMP errors
+(paint annotation 2 or 3) are not counted.
+
+Each record contains the flow's source and destination addresses and ports,
+protocol, the union of its TCP flags, a flow end reason, packet and byte
+counts, and start and end timestamps in milliseconds. The first message, and
+every TEMPLATE_REFRESH-th message after it, begins with a template set, so
+that collectors joining late can decode the stream.
+
+ToIPFIX's memory use is bounded. At most MAX_FLOWS flows are tracked; when a
+new flow would exceed the limit, the oldest flow is exported early with end
+reason "lack of resources", and a later record may continue it. At most one
+partially filled message is buffered.
+
+Export times and flow timestamps are taken from packet timestamp annotations,
+so exporting a trace produces deterministic output.
+
+Keyword arguments are:
+
+=over 8
+
+=item NOTIFIER
+
+The name of an AggregateNotifier element, like AggregateIPFlows. If given,
+then ToIPFIX will ask the element for notification when flows are deleted,
+and will export their records at that time. Without a NOTIFIER, records are
+exported only when the flow table fills, when the C<flush> handler is called,
+or when the router is stopped. Records exported when the router is stopped
+are written only to FILENAME, since downstream elements may no longer exist;
+call C<flush> first to send them on output 1.
+
+=item FILENAME
+
+Filename. If given, append each export message to this file. 'C<->' means
+standard output. A file of concatenated IPFIX messages is a valid IPFIX file
+(RFC 5655).
+
+=item VERSION
+
+Either 10 (IPFIX) or 9 (NetFlow v9). Default is 10.
+
+=item MTU
+
+Unsigned. Maximum export message size in bytes. Default is 1400.
+
+=item MAX_FLOWS
+
+Unsigned. Maximum number of flows tracked at once. Default is 65536.
+
+=item FLUSH_INTERVAL
+
+Time in seconds. Buffered records are sent at least this often. Default is 1
+second. Zero means buffered records are sent only when a message fills.
+
+=item TEMPLATE_REFRESH
+
+Unsigned. Resend the template every TEMPLATE_REFRESH messages. Default is 20.
+
+=item DOMAIN
+
+Unsigned. The observation domain ID (IPFIX) or source ID (NetFlow v9) placed
+in each message header. Default is 0.
+
+=back
+
+=h flush write-only
+
+Export records for all tracked flows, then send any buffered records.
+
+=h count read-only
+
+Returns the number of flows currently tracked.
+
+=h records read-only
+
+Returns the number of data records exported so far.
+
+=h messages read-only
+
+Returns the number of export messages sent so far.
+
+=h evictions read-only
+
+Returns the number of flows exported early because MAX_FLOWS was reached.
+
+=n
+
+Only available in user-level processes.
+
+=e
+
+Export flows from a trace to a collector:
+
+  FromDump(trace.pcap, STOP true, FORCE_IP true)
+      -> af :: AggregateIPFlows
+      -> exp :: ToIPFIX(NOTIFIER af)
+      -> Discard;
+  exp[1] -> Socket(UDP, 10.0.0.1, 4739, CLIENT true);
+
+=a
+
+AggregateIPFlows, ToIPFlowDumps, Socket */
+
+class ToIPFIX : public Element, public AggregateListener { public:
+
+    ToIPFIX() CLICK_COLD;
+    ~ToIPFIX() CLICK_COLD;
+
+    const char *class_name() const	{ return "ToIPFIX"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return "a/ah"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    Packet *pull(int);
+
+    void aggregate_notify(uint32_t, AggregateEvent, const Packet *);
+
+    enum {
+	END_IDLE = 1, END_ACTIVE = 2, END_DETECTED = 3, END_FORCED = 4,
+	END_RESOURCES = 5
+    };
+
+  private:
+
+    struct Direction {
+	uint64_t packets;
+	uint64_t bytes;
+	Timestamp first;
+	Timestamp last;
+	uint8_t tcp_flags;
+    };
+
+    struct Flow {
+	uint32_t _aggregate;
+	Flow *_hashnext;
+	IPFlowID _flowid;
+	uint8_t _ip_p;
+	Direction _dir[2];
+	List_member<Flow> _age_link;
+	typedef uint32_t key_type;
+	typedef uint32_t key_const_reference;
+	Flow(uint32_t agg)
+	    : _aggregate(agg), _hashnext() {
+	    memset(_dir, 0, sizeof(_dir));
+	}
+	key_const_reference hashkey() const {
+	    return _aggregate;
+	}
+    };
+
+    typedef HashContainer<Flow> Table;
+    Table _table;
+    typedef List<Flow, &Flow::_age_link> AgeList;
+    AgeList _age;
+    SizedHashAllocator<sizeof(Flow)> _alloc;
+    Spinlock _lock;
+
+    AggregateNotifier *_agg_notifier;
+    String _filename;
+    FILE *_f;
+    int _version;
+    uint32_t _mtu;
+    uint32_t _max_flows;
+    uint32_t _template_refresh;
+    uint32_t _domain;
+    Timer _flush_timer;
+    uint32_t _flush_interval_ms;
+    bool _push_output;
+
+    StringAccum _msg;
+    uint32_t _msg_records;	// data records in _msg
+    int _set_offset;		// offset of open data set in _msg, or -1
+    bool _msg_template;		// _msg contains a template set
+    Timestamp _first_timestamp;
+    Timestamp _last_timestamp;
+    Packet *_out_head;		// finished messages waiting for output 1
+    Packet *_out_tail;
+
+    uint32_t _nrecords;
+    uint32_t _nmessages;
+    uint32_t _nevictions;
+
+    enum { TEMPLATE_ID = 256 };
+
+    inline void smaction(Packet *);
+    void begin_message();
+    void finish_message();
+    void release_lock();
+    void add_record(const Flow *, int dir, int reason);
+    void export_flow(Flow *, int reason);
+    void export_all(int reason);
+
+    static void flush_hook(Timer *, void *);
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -67,6 +67,11 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item BURST I<n>
+
+Pull inputs are served by a task that pulls up to I<n> packets from each
+input at a time. At most 256. Default is 32.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
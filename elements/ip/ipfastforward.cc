@@ -0,0 +1,227 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipfastforward.{cc,hh} -- IPv4 forwarding fast path
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipfastforward.hh"
+#include "iproutetable.hh"
+#include <elements/ethernet/arptable.hh>
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+IPFastForward::IPFastForward()
+    : _table(0), _mtu(0), _burst(32), _task(this)
+{
+    _forwarded = 0;
+    _exceptions = 0;
+    _drops = 0;
+}
+
+IPFastForward::~IPFastForward()
+{
+}
+
+int
+IPFastForward::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read_mp("TABLE", ElementCastArg("IPRouteTable"), _table)
+	.read("MTU", _mtu)
+	.read("BADSRC", _bad_src)
+	.read("BURST", _burst)
+	.consume() < 0)
+	return -1;
+    if (_burst < 1 || _burst > max_burst)
+	return errh->error("BURST must be between 1 and %d", (int) max_burst);
+
+    _nexthop.clear();
+    for (int i = 0; i < conf.size(); ++i) {
+	PrefixErrorHandler perrh(errh, "NEXTHOP" + String(i) + ": ");
+	Vector<String> words;
+	cp_spacevec(conf[i], words);
+	NextHop nh;
+	nh.arpt = 0;
+	Element *e;
+	if (words.size() != 2 || !EtherAddressArg().parse(words[0], nh.src))
+	    return perrh.error("expected %<SRC DST%>");
+	else if (EtherAddressArg().parse(words[1], nh.dst))
+	    /* static next hop */;
+	else if (!(e = cp_element(words[1], this))
+		 || !(nh.arpt = (ARPTable *) e->cast("ARPTable")))
+	    return perrh.error("DST must be an Ethernet address or ARPTable");
+	_nexthop.push_back(nh);
+    }
+    if (noutputs() != _nexthop.size() + 1)
+	return errh->error("need %d outputs, one per NEXTHOP plus the exception output", _nexthop.size() + 1);
+    _exception_port = _nexthop.size();
+    return 0;
+}
+
+int
+IPFastForward::initialize(ErrorHandler *errh)
+{
+    if (input_is_pull(0)) {
+	ScheduleInfo::initialize_task(this, &_task, errh);
+	_signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    }
+    return 0;
+}
+
+// Returns the output port for p, or -1 if p was dropped. Changes p only if
+// it is forwarded.
+inline int
+IPFastForward::forward(Packet *&p)
+{
+    if (p->length() < sizeof(click_ether) + sizeof(click_ip)) {
+    drop:
+	p->kill();
+	return -1;
+    }
+    const click_ip *ip = reinterpret_cast<const click_ip *>(p->data() + sizeof(click_ether));
+    int hlen = ip->ip_hl << 2;
+    unsigned len = ntohs(ip->ip_len);
+    if (ip->ip_v != 4 || hlen < (int) sizeof(click_ip)
+	|| len < (unsigned) hlen
+	|| len > p->length() - sizeof(click_ether)
+	|| click_in_cksum(reinterpret_cast<const unsigned char *>(ip), hlen) != 0)
+	goto drop;
+
+    IPAddress src(ip->ip_src), dst(ip->ip_dst);
+    if (src.addr() == 0xFFFFFFFFU || src.is_multicast())
+	goto drop;
+    for (const IPAddress *a = _bad_src.begin(); a != _bad_src.end(); ++a)
+	if (*a == src)
+	    goto drop;
+
+    if (p->length() > len + sizeof(click_ether))
+	p->take(p->length() - len - sizeof(click_ether));
+    p->set_ip_header(ip, hlen);
+    p->set_dst_ip_anno(dst);
+
+    // anything unusual goes to the slow path
+    if (hlen != sizeof(click_ip) || ip->ip_ttl <= 1
+	|| dst.addr() == 0xFFFFFFFFU || dst.is_multicast()
+	|| p->packet_type_anno() == Packet::BROADCAST
+	|| p->packet_type_anno() == Packet::MULTICAST
+	|| (_mtu && len > _mtu))
+	return _exception_port;
+
+    IPAddress gw;
+    int port = _table->lookup_route(dst, gw);
+    if (port < 0 || port >= _exception_port)
+	return _exception_port;
+    if (gw)
+	p->set_dst_ip_anno(gw);
+    else
+	gw = dst;
+
+    const NextHop &nh = _nexthop[port];
+    EtherAddress dst_eth;
+    if (!nh.arpt)
+	dst_eth = nh.dst;
+    else if (nh.arpt->lookup(gw, &dst_eth, 0) < 0)
+	return _exception_port;
+
+    WritablePacket *q = p->uniqueify();
+    if (!(p = q))
+	return -1;
+
+    // decrement TTL and update the checksum incrementally, as in DecIPTTL
+    click_ip *qip = q->ip_header();
+    --qip->ip_ttl;
+    unsigned long sum = (~ntohs(qip->ip_sum) & 0xFFFF) + 0xFEFF;
+    qip->ip_sum = ~htons(sum + (sum >> 16));
+
+    click_ether *ethh = reinterpret_cast<click_ether *>(q->data());
+    memcpy(ethh->ether_dhost, dst_eth.data(), 6);
+    memcpy(ethh->ether_shost, nh.src.data(), 6);
+    q->set_mac_header(q->data(), sizeof(click_ether));
+    return port;
+}
+
+void
+IPFastForward::push(int, Packet *p)
+{
+    int port = forward(p);
+    if (port == _exception_port)
+	_exceptions++;
+    else if (port >= 0)
+	_forwarded++;
+    else {
+	_drops++;
+	return;
+    }
+    output(port).push(p);
+}
+
+bool
+IPFastForward::run_task(Task *)
+{
+    Packet *batch[max_burst];
+    int port[max_burst];
+    int n = 0;
+
+    while (n < _burst)
+	if (Packet *p = input(0).pull())
+	    batch[n++] = p;
+	else
+	    break;
+
+    // Check and route the whole burst before pushing any of it, so the
+    // loop stays small and the route table stays in cache.
+    uint32_t forwarded = 0, exceptions = 0, drops = 0;
+    for (int i = 0; i < n; ++i) {
+	port[i] = forward(batch[i]);
+	if (port[i] == _exception_port)
+	    ++exceptions;
+	else if (port[i] >= 0)
+	    ++forwarded;
+	else
+	    ++drops;
+    }
+    for (int i = 0; i < n; ++i)
+	if (port[i] >= 0)
+	    output(port[i]).push(batch[i]);
+
+    if (forwarded)
+	_forwarded += forwarded;
+    if (exceptions)
+	_exceptions += exceptions;
+    if (drops)
+	_drops += drops;
+
+    if (n == _burst || _signal)
+	_task.fast_reschedule();
+    return n > 0;
+}
+
+void
+IPFastForward::add_handlers()
+{
+    add_data_handlers("forwarded", Handler::OP_READ, &_forwarded);
+    add_data_handlers("exceptions", Handler::OP_READ, &_exceptions);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    if (input_is_pull(0))
+	add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable ARPTable)
+EXPORT_ELEMENT(IPFastForward)
+ELEMENT_MT_SAFE(IPFastForward)
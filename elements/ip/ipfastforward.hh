@@ -0,0 +1,160 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPFASTFORWARD_HH
+#define CLICK_IPFASTFORWARD_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/etheraddress.hh>
+#include <click/ipaddress.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+CLICK_DECLS
+class IPRouteTable;
+class ARPTable;
+
+/*
+=c
+
+IPFastForward(TABLE, NEXTHOP0, ..., NEXTHOPI<n-1>, [I<keywords> MTU, BADSRC, BURST])
+
+=s ip
+
+forwards plain IPv4 packets in one step
+
+=d
+
+IPFastForward is the fast path of an IP router. It does the work of
+CheckIPHeader, LookupIPRoute, DecIPTTL and the Ethernet encapsulation of an
+ARPQuerier in a single element, for the packets that need nothing else, and
+sends all other packets to a slow path.
+
+Input packets are Ethernet frames carrying IPv4. For each packet,
+IPFastForward checks the IP header as CheckIPHeader would; looks up the
+destination in TABLE, an IPRouteTable element such as RadixIPLookup or
+DirectIPLookup; decrements the TTL, updating the checksum incrementally; and
+rewrites the Ethernet addresses for the next hop. The packet is then emitted
+on the output numbered by the route's port.
+
+IPFastForward has I<n>+1 outputs, where I<n> is the number of NEXTHOP
+arguments. Each NEXTHOP argument, "SRC DST", describes output port I<i>:
+SRC is the Ethernet address of the outgoing interface, and DST is either the
+next hop's Ethernet address, for a point-to-point link, or the name of an
+ARPTable element in which to look up the next hop's address.
+
+Output I<n> is the exception path. IPFastForward emits there, unchanged, any
+packet with IP options; TTL 1 or less; a broadcast or multicast destination
+or link-level packet type; length greater than MTU; no route, or a route to
+port I<n> or higher; or a next hop with no ARPTable entry. These packets
+have their network header and destination IP address annotation set;
+connect the exception output to Strip(14) followed by a conventional IP
+router configuration, which will generate ICMP errors, fragment, send ARP
+queries, and so forth. Packets with invalid IP headers, or source addresses
+listed in BADSRC, are dropped.
+
+IPFastForward does not generate ICMP redirects, and does not look at the
+paint annotation.
+
+If IPFastForward's input is pull, it runs as a task, pulling up to BURST
+packets at a time. It checks and routes the whole burst in one loop, and
+only then pushes the packets to its outputs. If its input is push, it
+processes each packet as it arrives.
+
+Keyword arguments are:
+
+=over 8
+
+=item MTU
+
+Unsigned. Packets with IP length greater than MTU go to the exception
+output. 0 means no limit. Default is 0.
+
+=item BADSRC
+
+Space-separated list of IP addresses. Packets with one of these source
+addresses are dropped. Packets with a broadcast or multicast source address
+are always dropped. Default is empty.
+
+=item BURST
+
+Unsigned. The maximum number of packets pulled at a time, if the input is
+pull. At most 256. Default is 32.
+
+=back
+
+=h forwarded read-only
+
+Returns the number of packets forwarded on the fast path.
+
+=h exceptions read-only
+
+Returns the number of packets sent to the exception output.
+
+=h drops read-only
+
+Returns the number of packets dropped for invalid headers.
+
+=e
+
+  arpt0 :: ARPTable;
+  arpt1 :: ARPTable;
+  rt :: RadixIPLookup(10.0.0.0/24 0, 10.0.1.0/24 1, 0/0 10.0.1.254 1);
+  Idle -> rt => Discard, Discard;    // rt is used only as a table
+  ff :: IPFastForward(rt, 00:00:c0:ae:67:ef arpt0, 00:00:c0:4f:71:ef arpt1);
+  FromDevice(eth0) -> c0 :: Classifier(12/0800, -) -> ff;
+  FromDevice(eth1) -> c1 :: Classifier(12/0800, -) -> ff;
+  ff[0] -> Queue -> ToDevice(eth0);
+  ff[1] -> Queue -> ToDevice(eth1);
+  ff[2] -> Strip(14) -> CheckIPHeader -> ... // full IP router, whose
+                                              // ARPQueriers use TABLE arpt0
+                                              // and TABLE arpt1
+
+=a
+
+CheckIPHeader, LookupIPRoute, DecIPTTL, ARPTable, ARPQuerier,
+IPInputCombo, IPOutputCombo */
+
+class IPFastForward : public Element { public:
+
+    IPFastForward() CLICK_COLD;
+    ~IPFastForward() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPFastForward"; }
+    const char *port_count() const	{ return "1/2-"; }
+    const char *processing() const	{ return "a/h"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    bool run_task(Task *);
+
+  private:
+
+    enum { max_burst = 256 };
+
+    struct NextHop {
+	EtherAddress src;
+	EtherAddress dst;
+	ARPTable *arpt;
+    };
+
+    IPRouteTable *_table;
+    Vector<NextHop> _nexthop;
+    Vector<IPAddress> _bad_src;
+    uint32_t _mtu;
+    int _burst;
+    int _exception_port;
+
+    Task _task;
+    NotifierSignal _signal;
+
+    atomic_uint32_t _forwarded;
+    atomic_uint32_t _exceptions;
+    atomic_uint32_t _drops;
+
+    inline int forward(Packet *&p);
+
+};
+
+CLICK_ENDDECLS
+#endif
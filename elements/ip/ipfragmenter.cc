@@ -29,6 +29,7 @@ IPFragmenter::IPFragmenter()
     : _honor_df(true), _verbose(false), _mtu(0)
 {
     _fragments = 0;
+    _shared = 0;
     _drops = 0;
 }
 
@@ -122,42 +123,69 @@ IPFragmenter::fragment(Packet *p_in)
 
     // output the remaining fragments
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
-
-    for (int off = first_dlen; off < in_dlen; ) {
-	// prepare packet
-	int out_dlen = (_mtu - out_hlen) & ~7;
+    int max_dlen = (_mtu - out_hlen) & ~7;
+
+    // Fragments share p's data where they can. A fragment's header goes
+    // just before its data, on top of the end of the previous fragment's
+    // data, so fragments alternate: odd-numbered fragments are copied into
+    // new packets, and even-numbered ones are clones of p, with their
+    // headers written into p after the previous fragment was copied. The
+    // bytes overwritten are never part of an earlier clone. If the header
+    // is bigger than a fragment's data, every fragment after the first is
+    // copied.
+    bool share = out_hlen <= max_dlen;
+    int n = 1;
+
+    for (int off = first_dlen; off < in_dlen; off += max_dlen, ++n) {
+	int out_dlen = max_dlen;
 	if (out_dlen + off > in_dlen)
 	    out_dlen = in_dlen - off;
+	bool last = out_dlen + off >= in_dlen;
+
+	Packet *q;
+	if (share && !(n & 1)) {
+	    click_ip *qip = reinterpret_cast<click_ip *>(p->transport_header() + off - out_hlen);
+	    fill_header(ip, qip, out_hlen, off, out_dlen, last && !had_mf);
+	    if ((q = p->clone())) {
+		q->pull((unsigned char *) qip - q->data());
+		q->take(q->length() - out_hlen - out_dlen);
+		q->set_network_header(q->data(), out_hlen);
+		q->clear_mac_header();
+		_shared++;
+	    }
+	} else if (WritablePacket *wq = Packet::make(_headroom, 0, out_hlen + out_dlen, 0)) {
+	    wq->set_network_header(wq->data(), out_hlen);
+	    fill_header(ip, wq->ip_header(), out_hlen, off, out_dlen, last && !had_mf);
+	    memcpy(wq->transport_header(), p->transport_header() + off, out_dlen);
+	    wq->copy_annotations(p);
+	    q = wq;
+	} else
+	    q = 0;
 
-	WritablePacket *q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0);
 	if (q) {
-	    q->set_network_header(q->data(), out_hlen);
-	    click_ip *qip = q->ip_header();
-
-	    memcpy(qip, ip, sizeof(click_ip));
-	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
-
-	    qip->ip_hl = out_hlen >> 2;
-	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
-	    if (out_dlen + off >= in_dlen && !had_mf)
-		qip->ip_off &= ~htons(IP_MF);
-	    qip->ip_len = htons(out_hlen + out_dlen);
-	    qip->ip_sum = 0;
-	    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
-
-	    q->copy_annotations(p);
-
 	    output(0).push(q);
 	    _fragments++;
 	}
-
-	off += out_dlen;
     }
 
     p->kill();
 }
 
+void
+IPFragmenter::fill_header(const click_ip *ip, click_ip *qip, int out_hlen,
+			  int off, int out_dlen, bool clear_mf)
+{
+    memcpy(qip, ip, sizeof(click_ip));
+    optcopy(ip, qip);
+    qip->ip_hl = out_hlen >> 2;
+    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
+    if (clear_mf)
+	qip->ip_off &= ~htons(IP_MF);
+    qip->ip_len = htons(out_hlen + out_dlen);
+    qip->ip_sum = 0;
+    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
+}
+
 void
 IPFragmenter::push(int, Packet *p)
 {
@@ -172,6 +200,7 @@ IPFragmenter::add_handlers()
 {
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("fragments", Handler::OP_READ, &_fragments);
+    add_data_handlers("shared", Handler::OP_READ, &_shared);
 }
 
 CLICK_ENDDECLS
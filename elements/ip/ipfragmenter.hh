@@ -22,6 +22,12 @@ CLICK_DECLS
  *
  * Copies all annotations to the fragments.
  *
+ * Where it can, IPFragmenter avoids copying packet data. The first fragment
+ * and every second fragment after it share the input packet's buffer, with
+ * their IP headers written in front of their data; only the other fragments
+ * are copied. The shared fragments have no MAC header (except the first)
+ * and are not writable without a copy.
+ *
  * Sends the fragments in order, starting with the first.
  *
  * It is best to Strip() the MAC header from a packet before sending it to
@@ -46,7 +52,23 @@ CLICK_DECLS
  * =item HEADROOM
  *
  * Unsigned.  Sets the headroom on the output packets to an explicit value,
- * rather than the default (which is usually about 28 bytes).
+ * rather than the default (which is usually about 28 bytes). Applies only to
+ * fragments that are copied.
+ *
+ * =back
+ *
+ * =h fragments read-only
+ *
+ * Returns the number of fragments emitted.
+ *
+ * =h shared read-only
+ *
+ * Returns the number of fragments after the first that shared the input
+ * packet's data rather than copying it.
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets sent to output 1 because of DF.
  *
  * =e
  *   ... -> fr::IPFragmenter(1024) -> Queue(20) -> ...
@@ -80,9 +102,12 @@ class IPFragmenter : public Element { public:
   unsigned _headroom;
   atomic_uint32_t _drops;
   atomic_uint32_t _fragments;
+  atomic_uint32_t _shared;
 
   void fragment(Packet *);
   int optcopy(const click_ip *ip1, click_ip *ip2);
+  void fill_header(const click_ip *ip, click_ip *qip, int out_hlen,
+		   int off, int out_dlen, bool clear_mf);
 
 };
 
@@ -36,10 +36,10 @@ CLICK_DECLS
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0),
+      _stat_bad_pkts(0), _stat_timeouts(0), _stat_evictions(0),
+      _stat_quota_drops(0)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
@@ -53,13 +53,22 @@ IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
     int mtu_anno = -1;
+    bool source_thresh_set;
+    uint32_t timeout = 30;
     if (Args(conf, this, errh)
 	.read("HIMEM", _mem_high_thresh)
+	.read("SOURCE_HIMEM", _source_thresh).read_status(source_thresh_set)
+	.read("TIMEOUT", SecondsArg(), timeout)
 	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
 	.complete() < 0)
 	return -1;
+    if (timeout > 0x7FFFFFFF)
+	return errh->error("TIMEOUT too large");
     _mtu_anno = mtu_anno;
+    _timeout = timeout;
     _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
+    if (!source_thresh_set)
+	_source_thresh = _mem_high_thresh >> 1;
     return 0;
 }
 
@@ -67,28 +76,45 @@ int
 IPReassembler::initialize(ErrorHandler *)
 {
     _mem_used = 0;
-    _reap_time = 0;
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
-	}
+    while (FragQueue *fq = _age.front()) {
+	_age.pop_front();
+	fq->p->kill();
+	fq->~FragQueue();
+	_alloc.deallocate(fq);
+    }
+    _table.clear();
+    _source_mem.clear();
+}
+
+inline uint32_t
+IPReassembler::source_mem(const FragKey &key) const
+{
+    return _source_mem.get(IPAddress(key.src));
+}
+
+inline void
+IPReassembler::charge(const FragQueue *fq, int32_t delta)
+{
+    _mem_used += delta;
+    if (_source_thresh) {
+	HashTable<IPAddress, uint32_t>::iterator it = _source_mem.find_insert(IPAddress(fq->key.src));
+	if (!(it.value() += delta))
+	    _source_mem.erase(it);
+    }
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, const Packet *p, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
     if (p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
 	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
@@ -104,41 +130,53 @@ IPReassembler::check(ErrorHandler *errh)
     if (!errh)
 	errh = ErrorHandler::default_handler();
     uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (q->has_network_header()) {
-		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
-		mem_used += IPH_MEM_USED + q->transport_length();
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		int off = 0;
+    size_t nqueues = 0;
+    HashTable<IPAddress, uint32_t> source_mem;
+    for (FragQueue *fq = _age.front(); fq; fq = fq->_age_link.next(), ++nqueues) {
+	WritablePacket *q = fq->p;
+	if (_table.find(fq->key).get() != fq)
+	    errh->error("queue missing from table");
+	if (q->has_network_header()) {
+	    const click_ip *qip = q->ip_header();
+	    if (!(FragKey(qip) == fq->key))
+		check_error(errh, q, "in wrong queue");
+	    mem_used += queue_mem(q);
+	    source_mem[IPAddress(fq->key.src)] += queue_mem(q);
+	    ChunkLink *chunk = &PACKET_CHUNK(q);
+	    int off = 0;
 #if VERBOSE_DEBUG
-		check_error(errh, b, q, "");
-		StringAccum sa;
-		while (chunk && (!off || off < q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-		errh->message("  %s", sa.c_str());
-		chunk = &PACKET_CHUNK(q);
-		off = 0;
+	    check_error(errh, q, "");
+	    StringAccum sa;
+	    while (chunk && (!off || off < q->transport_length())) {
+		sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
+		off = chunk->lastoff;
+		chunk = next_chunk(q, chunk);
+	    }
+	    errh->message("  %s", sa.c_str());
+	    chunk = &PACKET_CHUNK(q);
+	    off = 0;
 #endif
-		while (chunk) {
-		    if (chunk->off >= chunk->lastoff
-			|| chunk->lastoff > q->transport_length()
-			|| (off != 0 && chunk->off < off + 8)) {
-			check_error(errh, b, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
-			break;
-		    }
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
+	    while (chunk) {
+		if (chunk->off >= chunk->lastoff
+		    || chunk->lastoff > q->transport_length()
+		    || (off != 0 && chunk->off < off + 8)) {
+		    check_error(errh, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
+		    break;
 		}
-	    } else
-		errh->error("buck %d: missing IP header", b);
+		off = chunk->lastoff;
+		chunk = next_chunk(q, chunk);
+	    }
+	} else
+	    errh->error("queue %p: missing IP header", fq);
+    }
+    if (nqueues != _table.size())
+	errh->error("bad queue count: have %u, table has %u", (unsigned) nqueues, (unsigned) _table.size());
     if (mem_used != _mem_used)
 	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
+    if (_source_thresh)
+	for (HashTable<IPAddress, uint32_t>::iterator it = source_mem.begin(); it.live(); ++it)
+	    if (it.value() != _source_mem.get(it.key()))
+		errh->error("bad mem_used for %s: have %u, claim %u", it.key().unparse().c_str(), it.value(), _source_mem.get(it.key()));
     return 0;
 }
 
@@ -148,52 +186,40 @@ IPReassembler::debug_dump(Element *e, void *)
     IPReassembler *r = (IPReassembler *) e;
     r->check();
     StringAccum sa;
-    sa <<
-	"frags seen total:    " << r->_stat_frags_seen << "\n"
-	"good reassemblies:   " << r->_stat_good_assem << "\n"
-	"failed reassemblies: " << r->_stat_failed_assem << "\n"
-	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
-	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (const click_ip *qip = q->ip_header()) {
-		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		while (chunk &&
-		       (chunk->lastoff > chunk->off) &&
-		       (chunk->lastoff <= q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    chunk = next_chunk(q, chunk);
-		}
-		sa << '\n';
+    sa << read_handler(e, (void *) h_stats) << "cached chunk data:\n";
+    for (FragQueue *fq = r->_age.front(); fq; fq = fq->_age_link.next())
+	if (const click_ip *qip = fq->p->ip_header()) {
+	    WritablePacket *q = fq->p;
+	    sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
+	    ChunkLink *chunk = &PACKET_CHUNK(q);
+	    while (chunk &&
+		   (chunk->lastoff > chunk->off) &&
+		   (chunk->lastoff <= q->transport_length())) {
+		sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
+		chunk = next_chunk(q, chunk);
 	    }
+	    sa << '\n';
+	}
     return sa.take_string();
 }
 
 WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+IPReassembler::remove_queue(FragQueue *fq)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
-	    return q;
-	}
-    }
-    *store_pprev = &_map[bucket];
-    return 0;
+    WritablePacket *q = fq->p;
+    charge(fq, -queue_mem(q));
+    _table.erase(fq->key);
+    _age.erase(fq);
+    fq->~FragQueue();
+    _alloc.deallocate(fq);
+    return q;
 }
 
 Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::emit_whole_packet(FragQueue *fq, Packet *p_in)
 {
     ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
+    WritablePacket *q = remove_queue(fq);
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_len = htons(q->network_length());
@@ -206,13 +232,13 @@ IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
     q->set_next(0);
 
     p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
     return q;
 }
 
-void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+bool
+IPReassembler::make_queue(Packet *p, Table::iterator &it, int now)
 {
+    FragKey key(p->ip_header());
     int p_off = IP_BYTE_OFF(p->ip_header());
     int p_lastoff = p_off + PACKET_DLEN(p);
     WritablePacket *q;
@@ -221,14 +247,14 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	q = p->uniqueify();
 	if (!q) {
 	    click_chatter("out of memory");
-	    return;
+	    return false;
 	}
     } else {
 	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
 	if (!q) {
 	    p->kill();
 	    click_chatter("out of memory");
-	    return;
+	    return false;
 	}
 	q->set_ip_header((click_ip *)q->data(), 20);
 	memcpy(q->ip_header(), p->ip_header(), 20);
@@ -237,7 +263,12 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	p->kill();
     }
 
-    _mem_used += IPH_MEM_USED + p_lastoff;
+    void *x = _alloc.allocate();
+    if (!x) {
+	q->kill();
+	click_chatter("out of memory");
+	return false;
+    }
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
@@ -248,11 +279,14 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
     PACKET_CHUNK(q).off = p_off;
     PACKET_CHUNK(q).lastoff = p_lastoff;
 
-    // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
-
-    check();
+    // link it up; the table grows as needed
+    FragQueue *fq = new(x) FragQueue(key);
+    fq->p = q;
+    fq->expire = now + _timeout;
+    _table.set(it, fq, true);
+    _age.push_back(fq);
+    charge(fq, queue_mem(q));
+    return true;
 }
 
 IPReassembler::ChunkLink *
@@ -275,14 +309,13 @@ IPReassembler::simple_action(Packet *p)
 
     ++_stat_frags_seen;
 
-    // reap if necessary
+    // expire old queues
     int now = p->timestamp_anno().sec();
     if (!now) {
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
-	reap(now);
+    reap(now);
 
     // calculate packet edges
     int p_off = IP_BYTE_OFF(iph);
@@ -303,16 +336,34 @@ IPReassembler::simple_action(Packet *p)
 
     // clean up memory if necessary
     if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
+	reap_overfull();
 
     // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
+    FragKey key(iph);
+    Table::iterator it = _table.find(key);
+    FragQueue *fq = it.get();
+
+    // enforce the per-source bound before committing any memory
+    if (_source_thresh) {
+	uint32_t grow;
+	if (!fq)
+	    grow = IPH_MEM_USED + p_lastoff;
+	else if (p_lastoff > fq->p->transport_length())
+	    grow = p_lastoff - fq->p->transport_length();
+	else
+	    grow = 0;
+	if (grow && source_mem(key) + grow > _source_thresh) {
+	    p->kill();
+	    ++_stat_quota_drops;
+	    return 0;
+	}
+    }
+
+    if (!fq) {			// make a new queue
+	make_queue(p, it, now);
 	return 0;
     }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
+    WritablePacket *q = fq->p;
 
     if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
 	q->set_anno_u16(_mtu_anno, p->network_length());
@@ -336,18 +387,22 @@ IPReassembler::simple_action(Packet *p)
 	// request space
 	if (!(q = q->put(want_space))) {
 	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
+	    // put() freed the old buffer
+	    charge(fq, -(IPH_MEM_USED + old_transport_length));
+	    _table.erase(it);
+	    _age.erase(fq);
+	    fq->~FragQueue();
+	    _alloc.deallocate(fq);
 	    p->kill();
 	    return 0;
 	}
 	// get rid of extra space
 	q->take(q->transport_length() - p_lastoff);
 	// hook up packet, and add final chunk
-	*q_pprev = q;
+	fq->p = q;
 	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
 	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
+	charge(fq, p_lastoff - old_transport_length);
     }
 
     // find chunks before and after p
@@ -380,6 +435,7 @@ IPReassembler::simple_action(Packet *p)
 	    q = q->push(header_delta);
 	else if (header_delta < 0)
 	    q->pull(-header_delta);
+	fq->p = q;
 	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
         if (p->has_mac_header())
 	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
@@ -404,7 +460,7 @@ IPReassembler::simple_action(Packet *p)
     if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
 	&& PACKET_CHUNK(q).off == 0
 	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
+	return emit_whole_packet(fq, p);
 
     // Otherwise, done for now
     //check();
@@ -413,59 +469,73 @@ IPReassembler::simple_action(Packet *p)
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::expire_queue(FragQueue *fq)
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
-	}
+    WritablePacket *q = remove_queue(fq);
+    ++_stat_failed_assem;
+    checked_output_push(1, q);
+}
 
-    click_chatter("IPReassembler: cannot free enough memory!");
+void
+IPReassembler::reap_overfull()
+{
+    // throw away the oldest partial packets first
+    while (_mem_used > _mem_low_thresh)
+	if (FragQueue *fq = _age.front()) {
+	    ++_stat_evictions;
+	    expire_queue(fq);
+	} else
+	    break;
 }
 
 void
 IPReassembler::reap(int now)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
-    int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
-    }
+    // Queues are on the age list in creation order, so expiring them takes
+    // constant time per queue. (A packet with an earlier timestamp than its
+    // predecessor can delay expiry a little, which is harmless.)
+    while (FragQueue *fq = _age.front())
+	if (fq->expire < now) {
+	    ++_stat_timeouts;
+	    expire_queue(fq);
+	} else
+	    break;
+}
 
-    _reap_time = now + REAP_INTERVAL;
+String
+IPReassembler::read_handler(Element *e, void *user_data)
+{
+    IPReassembler *r = static_cast<IPReassembler *>(e);
+    switch ((intptr_t) user_data) {
+    case h_queues:
+	return String(r->_table.size());
+    case h_stats: {
+	StringAccum sa;
+	sa <<
+	    "frags seen total:    " << r->_stat_frags_seen << "\n"
+	    "good reassemblies:   " << r->_stat_good_assem << "\n"
+	    "failed reassemblies: " << r->_stat_failed_assem << "\n"
+	    "bad fragments seen:  " << r->_stat_bad_pkts << "\n"
+	    "timeouts:            " << r->_stat_timeouts << "\n"
+	    "evictions:           " << r->_stat_evictions << "\n"
+	    "source quota drops:  " << r->_stat_quota_drops << "\n";
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
 }
 
 void
 IPReassembler::add_handlers()
 {
     add_read_handler("dump", debug_dump);
+    add_read_handler("stats", read_handler, h_stats);
+    add_read_handler("queues", read_handler, h_queues);
+    add_data_handlers("mem_used", Handler::OP_READ, &_mem_used);
+    add_data_handlers("timeouts", Handler::OP_READ, &_stat_timeouts);
+    add_data_handlers("evictions", Handler::OP_READ, &_stat_evictions);
+    add_data_handlers("quota_drops", Handler::OP_READ, &_stat_quota_drops);
 }
 
 CLICK_ENDDECLS
@@ -5,6 +5,11 @@
 #include <click/glue.hh>
 #include <clicknet/ip.h>
 #include <click/timer.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/hashtable.hh>
+#include <click/ipaddress.hh>
+#include <click/list.hh>
 CLICK_DECLS
 
 /*
@@ -21,14 +26,22 @@ Reassembles fragmented IP packets
 Expects IP packets as input to port 0. If input packets are fragments,
 IPReassembler holds them until it has enough fragments to recreate a complete
 packet. When a complete packet is constructed, it is emitted onto output 0. If
-a set of fragments making a single packet is incomplete and dormant for 30
-seconds, the fragments are generally dropped. If IPReassembler has two
+a set of fragments making a single packet is incomplete and dormant for
+TIMEOUT seconds, the fragments are generally dropped. If IPReassembler has two
 outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
 IPReassembler's memory usage is bounded. When memory consumption rises above
 HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+drops below 3/4*HIMEM bytes. Default HIMEM is 256K. In addition, the
+fragments from any one source address may occupy at most SOURCE_HIMEM bytes;
+further fragments from that source are dropped until some of its packets are
+completed or time out. This keeps a flood of fragments from one source from
+evicting everyone else's partial packets.
+
+Partial packets are kept in a hash table keyed by source, destination,
+protocol and IP ID, which grows as needed, and in a list ordered by age, so
+that expiring and evicting old fragments takes constant time per packet.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -45,6 +58,16 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item SOURCE_HIMEM
+
+The upper bound for memory consumed by fragments from one source address, in
+bytes. 0 means no per-source bound. Default is HIMEM/2.
+
+=item TIMEOUT
+
+Time in seconds. How long to wait for the rest of a packet's fragments.
+Default is 30.
+
 =item MAX_MTU_ANNO
 
 Optional. A 2 byte annotation that will be filled with the maximum size of any
@@ -60,6 +83,37 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h mem_used read-only
+
+Returns the number of bytes used by partial packets.
+
+=h queues read-only
+
+Returns the number of partial packets.
+
+=h timeouts read-only
+
+Returns the number of partial packets dropped because they timed out.
+
+=h evictions read-only
+
+Returns the number of partial packets dropped to free memory for others.
+
+=h quota_drops read-only
+
+Returns the number of fragments dropped because their source exceeded
+SOURCE_HIMEM.
+
+=h stats read-only
+
+Returns counts of fragments seen, good and failed reassemblies, bad
+fragments, timeouts, evictions and quota drops.
+
+=h dump read-only
+
+Returns the statistics above, followed by a list of the partial packets and
+the byte ranges received for each.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -88,52 +142,96 @@ class IPReassembler : public Element { public:
 
   private:
 
-    enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
-	   IPH_MEM_USED = 40 };
+    enum { IPH_MEM_USED = 40 };
+    enum { h_queues, h_stats };
+
+    struct FragKey {
+	uint32_t src;		// network byte order
+	uint32_t dst;
+	uint16_t id;
+	uint8_t proto;
+
+	FragKey(const click_ip *iph)
+	    : src(iph->ip_src.s_addr), dst(iph->ip_dst.s_addr),
+	      id(iph->ip_id), proto(iph->ip_p) {
+	}
+	inline hashcode_t hashcode() const;
+	bool operator==(const FragKey &x) const {
+	    return src == x.src && dst == x.dst && id == x.id
+		&& proto == x.proto;
+	}
+    };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    struct FragQueue {
+	FragKey key;
+	FragQueue *_hashnext;
+	List_member<FragQueue> _age_link;
+	WritablePacket *p;	// reassembly buffer
+	int expire;		// seconds
+
+	typedef FragKey key_type;
+	typedef const FragKey &key_const_reference;
+	FragQueue(const FragKey &k)
+	    : key(k), _hashnext(), p() {
+	}
+	key_const_reference hashkey() const {
+	    return key;
+	}
+    };
 
-    int _reap_time;
+    typedef HashContainer<FragQueue> Table;
+    typedef List<FragQueue, &FragQueue::_age_link> AgeList;
+
+    Table _table;
+    AgeList _age;		// oldest first
+    SizedHashAllocator<sizeof(FragQueue)> _alloc;
+    HashTable<IPAddress, uint32_t> _source_mem;
+
+    int _timeout;
 
     uint32_t _stat_frags_seen;
     uint32_t _stat_good_assem;
     uint32_t _stat_failed_assem;
     uint32_t _stat_bad_pkts;
+    uint32_t _stat_timeouts;
+    uint32_t _stat_evictions;
+    uint32_t _stat_quota_drops;
 
     uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _source_thresh;	// defaults to 1/2 * _mem_high_thresh
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
-    static inline bool same_segment(const click_ip *, const click_ip *);
+    static inline uint32_t queue_mem(const WritablePacket *q) {
+	return IPH_MEM_USED + q->transport_length();
+    }
+    inline void charge(const FragQueue *fq, int32_t delta);
+    inline uint32_t source_mem(const FragKey &key) const;
+
+    static String read_handler(Element *, void *) CLICK_COLD;
     static String debug_dump(Element *e, void *);
 
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
+    bool make_queue(Packet *, Table::iterator &, int now);
+    WritablePacket *remove_queue(FragQueue *);
     static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
+    Packet *emit_whole_packet(FragQueue *, Packet *);
+    void expire_queue(FragQueue *);
+    void reap_overfull();
     void reap(int);
-    static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
+    static void check_error(ErrorHandler *, const Packet *, const char *, ...);
 
 };
 
 
-inline int
-IPReassembler::bucketno(const click_ip *h)
-{
-    return (h->ip_id % NMAP);
-}
-
-inline bool
-IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
+inline hashcode_t
+IPReassembler::FragKey::hashcode() const
 {
-    return h->ip_id == h2->ip_id && h->ip_p == h2->ip_p
-	&& h->ip_src.s_addr == h2->ip_src.s_addr
-	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
+    uint32_t x = src ^ (dst << 7 | dst >> 25) ^ ((uint32_t) id << 16 | proto);
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    return x;
 }
 
 CLICK_ENDDECLS
@@ -33,6 +33,7 @@
 #include <click/error.hh>
 #include <click/algorithm.hh>
 #include <click/heap.hh>
+#include <click/standard/scheduleinfo.hh>
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -68,7 +69,8 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this)
+    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this),
+      _burst(default_burst), _task(this)
 {
     _timeouts[0] = default_timeout;
     _timeouts[1] = default_guarantee;
@@ -158,8 +160,11 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("GUARANTEE", SecondsArg(), _timeouts[1])
 	.read("REAP_INTERVAL", SecondsArg(), _gc_interval_sec)
 	.read("REAP_TIME", Args::deprecated, SecondsArg(), _gc_interval_sec)
+	.read("BURST", _burst)
 	.consume() < 0)
 	return -1;
+    if (_burst < 1 || _burst > max_burst)
+	return errh->error("BURST must be between 1 and %d", (int) max_burst);
 
     if (capacity_word) {
 	Element *e;
@@ -199,10 +204,19 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 	    cerrh.error("reply element %<%s%> must share this MAPPING_CAPACITY", i, _input_specs[i].reply_element->name().c_str());
 	if (_input_specs[i].kind == IPRewriterInput::i_mapper)
 	    _input_specs[i].u.mapper->notify_rewriter(this, &_input_specs[i], &cerrh);
+	_input_specs[i].count.initialize(this);
+	_input_specs[i].failures.initialize(this);
     }
     _gc_timer.initialize(this);
     if (_gc_interval_sec)
 	_gc_timer.schedule_after_sec(_gc_interval_sec);
+    _signal = NotifierSignal::idle_signal();
+    for (int i = 0; i < ninputs(); ++i)
+	if (input_is_pull(i)) {
+	    if (!_task.initialized())
+		ScheduleInfo::initialize_task(this, &_task, errh);
+	    _signal += Notifier::upstream_empty_signal(this, i, &_task);
+	}
     return errh->nerrors() ? -1 : 0;
 }
 
@@ -281,13 +295,52 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     return &flow->entry(false);
 }
 
+IPRewriterFlow *
+IPRewriterHeap::top(int which)
+{
+    Vector<IPRewriterFlow *> &heap = _heaps[which];
+    while (heap.size() && heap[0]->_heap_expiry_j != heap[0]->_expiry_j) {
+	heap[0]->_heap_expiry_j = heap[0]->_expiry_j;
+	change_heap(heap.begin(), heap.end(), heap.begin(),
+		    IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
+    }
+    return heap.size() ? heap[0] : 0;
+}
+
+void
+IPRewriterBase::push_burst(int port, Packet **p, int n)
+{
+    for (int i = 0; i < n; ++i)
+	push(port, p[i]);
+}
+
+bool
+IPRewriterBase::run_task(Task *)
+{
+    Packet *burst[max_burst];
+    int npackets = 0;
+    bool more = false;
+    for (int port = 0; port < ninputs(); ++port)
+	if (input_is_pull(port)) {
+	    int n = 0;
+	    while (n < _burst && (burst[n] = input(port).pull()))
+		++n;
+	    if (n)
+		push_burst(port, burst, n);
+	    npackets += n;
+	    more = more || n == _burst;
+	}
+    if (more || _signal)
+	_task.fast_reschedule();
+    return npackets > 0;
+}
+
 void
 IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
 {
     // Shift flows with expired guarantees to the best-effort heap.
-    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->_heaps[1];
-    while (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
-	IPRewriterFlow *mf = guaranteed_heap[0];
+    IPRewriterFlow *mf;
+    while ((mf = _heap->top(1)) && mf->expired(now_j)) {
 	click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
 	mf->change_expiry(_heap, false, new_expiry);
     }
@@ -303,11 +356,10 @@ IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
     // In that case we always remove the current flow to honor previous
     // guarantees (= admission control).
     IPRewriterFlow *deadf;
-    if (_heap->_heaps[0].empty()) {
+    if (!(deadf = _heap->top(0))) {
 	assert(flow->guaranteed());
 	deadf = flow;
-    } else
-	deadf = _heap->_heaps[0][0];
+    }
     deadf->destroy(_heap);
     return deadf == flow;
 }
@@ -317,13 +369,14 @@ IPRewriterBase::shrink_heap(bool clear_all)
 {
     click_jiffies_t now_j = click_jiffies();
     shift_heap_best_effort(now_j);
-    Vector<IPRewriterFlow *> &best_effort_heap = _heap->_heaps[0];
-    while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
-	best_effort_heap[0]->destroy(_heap);
+    IPRewriterFlow *deadf;
+    while ((deadf = _heap->top(0)) && deadf->expired(now_j))
+	deadf->destroy(_heap);
 
     int32_t capacity = clear_all ? 0 : _heap->_capacity;
     while (_heap->size() > capacity) {
-	IPRewriterFlow *deadf = _heap->_heaps[_heap->_heaps[0].empty()][0];
+	if (!(deadf = _heap->top(0)))
+	    deadf = _heap->top(1);
 	deadf->destroy(_heap);
     }
 }
@@ -460,6 +513,11 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
 	if (writable_patterns)
 	    add_write_handler(name, pattern_write_handler, i);
     }
+    for (int i = 0; i < ninputs(); ++i)
+	if (input_is_pull(i)) {
+	    add_task_handlers(&_task);
+	    break;
+	}
 }
 
 int
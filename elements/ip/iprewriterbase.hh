@@ -2,8 +2,11 @@
 #ifndef CLICK_IPREWRITERBASE_HH
 #define CLICK_IPREWRITERBASE_HH
 #include <click/timer.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
 #include "elements/ip/iprwmapping.hh"
 #include <click/bitvector.hh>
+#include <click/sharded.hh>
 CLICK_DECLS
 class IPMapper;
 class IPRewriterPattern;
@@ -18,15 +21,15 @@ class IPRewriterInput { public:
     int foutput;
     IPRewriterBase *reply_element;
     int routput;
-    uint32_t count;
-    uint32_t failures;
+    ShardedCounter<uint32_t> count;
+    ShardedCounter<uint32_t> failures;
     union {
 	IPRewriterPattern *pattern;
 	IPMapper *mapper;
     } u;
 
     IPRewriterInput()
-	: kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
+	: kind(i_drop), foutput(-1), routput(-1) {
 	u.pattern = 0;
     }
 
@@ -64,6 +67,13 @@ class IPRewriterHeap { public:
 	return _capacity;
     }
 
+    /** @brief Return the next flow to expire in heap @a which, or null if
+     * that heap is empty.
+     *
+     * Flows whose expiration times were extended keep their old heap keys
+     * until they reach the top; this function updates them as it goes. */
+    IPRewriterFlow *top(int which);
+
   private:
 
     enum {
@@ -96,7 +106,7 @@ class IPRewriterBase : public Element { public:
     };
 
     const char *port_count() const	{ return "1-/1-"; }
-    const char *processing() const	{ return PUSH; }
+    const char *processing() const	{ return "a/h"; }
 
     int configure_phase() const		{ return CONFIGURE_PHASE_REWRITER; }
     int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
@@ -129,6 +139,14 @@ class IPRewriterBase : public Element { public:
 
     int llrpc(unsigned command, void *data);
 
+    /** @brief Process @a n packets that arrived together on input @a port.
+     *
+     * Called by run_task() with each burst pulled from a pull input. The
+     * default calls push() for each packet in turn; rewriters override it
+     * to overlap the flow table lookups of the whole burst. */
+    virtual void push_burst(int port, Packet **p, int n);
+    bool run_task(Task *);
+
   protected:
 
     Map _map;
@@ -140,10 +158,16 @@ class IPRewriterBase : public Element { public:
     uint32_t _gc_interval_sec;
     Timer _gc_timer;
 
+    int _burst;
+    Task _task;
+    NotifierSignal _signal;
+
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
-	default_gc_interval = 60 * 15 // 15 minutes
+	default_gc_interval = 60 * 15, // 15 minutes
+	default_burst = 32,
+	max_burst = 256
     };
 
     static uint32_t relevant_timeout(const uint32_t timeouts[2]) {
@@ -36,7 +36,7 @@ IPRewriterFlow::IPRewriterFlow(IPRewriterInput *owner, const IPFlowID &flowid,
 			       const IPFlowID &rewritten_flowid,
 			       uint8_t ip_p, bool guaranteed,
 			       click_jiffies_t expiry_j)
-    : _expiry_j(expiry_j), _ip_p(ip_p), _tflags(0),
+    : _expiry_j(expiry_j), _heap_expiry_j(expiry_j), _ip_p(ip_p), _tflags(0),
       _guaranteed(guaranteed), _reply_anno(0),
       _owner(owner)
 {
@@ -90,12 +90,11 @@ IPRewriterFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 }
 
 void
-IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
-			      click_jiffies_t expiry_j)
+IPRewriterFlow::reheap(IPRewriterHeap *h, bool guaranteed)
 {
     Vector<IPRewriterFlow *> &current_heap = h->_heaps[_guaranteed];
     assert(current_heap[_place] == this);
-    _expiry_j = expiry_j;
+    _heap_expiry_j = _expiry_j;
     if (_guaranteed != guaranteed) {
 	remove_heap(current_heap.begin(), current_heap.end(),
 		    current_heap.begin() + _place,
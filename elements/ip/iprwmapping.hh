@@ -98,9 +98,19 @@ class IPRewriterFlow { public:
     /** @brief Set expiration time to @a expiry_j.
      * @param h heap containing this flow
      * @param guaranteed whether the flow is guaranteed
-     * @param expiry_j expiration time in absolute jiffies */
+     * @param expiry_j expiration time in absolute jiffies
+     *
+     * Extending the expiration time of a flow that stays in the same heap
+     * is cheap: the flow keeps its heap position, and its heap key is
+     * brought up to date only when it reaches the top of the heap (see
+     * IPRewriterHeap::top()). */
     void change_expiry(IPRewriterHeap *h, bool guaranteed,
-		       click_jiffies_t expiry_j);
+		       click_jiffies_t expiry_j) {
+	_expiry_j = expiry_j;
+	if (unlikely(guaranteed != _guaranteed
+		     || click_jiffies_less(expiry_j, _heap_expiry_j)))
+	    reheap(h, guaranteed);
+    }
 
     /** @brief Set expiration time to a timeout after @a now_j.
      * @param h heap containing this flow
@@ -142,7 +152,7 @@ class IPRewriterFlow { public:
 
     struct heap_less {
 	inline bool operator()(IPRewriterFlow *a, IPRewriterFlow *b) {
-	    return click_jiffies_less(a->expiry(), b->expiry());
+	    return click_jiffies_less(a->_heap_expiry_j, b->_heap_expiry_j);
 	}
     };
     struct heap_place {
@@ -157,6 +167,7 @@ class IPRewriterFlow { public:
     uint16_t _ip_csum_delta;
     uint16_t _udp_csum_delta;
     click_jiffies_t _expiry_j;
+    click_jiffies_t _heap_expiry_j; // heap key, never after _expiry_j
     size_t _place : 32;
     uint8_t _ip_p;
     uint8_t _tflags;
@@ -166,9 +177,11 @@ class IPRewriterFlow { public:
 
     friend class IPRewriterBase;
     friend class IPRewriterEntry;
+    friend class IPRewriterHeap;
 
   private:
 
+    void reheap(IPRewriterHeap *heap, bool guaranteed);
     void destroy(IPRewriterHeap *heap);
 
 };
@@ -0,0 +1,280 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * rssswitch.{cc,hh} -- spreads flows over outputs like receive-side scaling
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "rssswitch.hh"
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+static const unsigned char default_key[] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+#if !defined(__SSE4_2__)
+static uint32_t crc32c_table[256];
+#endif
+
+RSSSwitch::RSSSwitch()
+    : _toeplitz(0), _table(0)
+{
+}
+
+RSSSwitch::~RSSSwitch()
+{
+    delete[] _toeplitz;
+    delete[] _table;
+    for (int t = 0; t < _counts.size(); ++t)
+	delete[] _counts[t];
+}
+
+void
+RSSSwitch::set_key(const unsigned char *key)
+{
+    // The Toeplitz hash XORs together, for each set bit of the input, the
+    // 32 key bits starting at that bit's position. Tabulate the result for
+    // each input byte position and value, so hashing takes one lookup per
+    // byte.
+    for (int i = 0; i < max_input; ++i)
+	for (int v = 0; v < 256; ++v) {
+	    uint32_t h = 0;
+	    for (int b = 0; b < 8; ++b)
+		if (v & (0x80 >> b)) {
+		    const unsigned char *k = key + i;
+		    uint64_t w = ((uint64_t) k[0] << 32) | ((uint32_t) k[1] << 24)
+			| (k[2] << 16) | (k[3] << 8) | k[4];
+		    h ^= (uint32_t) (w >> (8 - b));
+		}
+	    _toeplitz[i * 256 + v] = h;
+	}
+}
+
+int
+RSSSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String hash = "toeplitz", key((const char *) default_key, key_len);
+    uint32_t table_size = 128;
+    _symmetric = false;
+    _offset = 0;
+    if (Args(conf, this, errh)
+	.read("HASH", WordArg(), hash)
+	.read("KEY", key)
+	.read("SYMMETRIC", _symmetric)
+	.read("TABLE_SIZE", table_size)
+	.read("OFFSET", _offset)
+	.complete() < 0)
+	return -1;
+
+    if (table_size == 0 || table_size > max_table_size
+	|| (table_size & (table_size - 1)) != 0)
+	return errh->error("TABLE_SIZE must be a power of two no larger than %d", (int) max_table_size);
+
+    delete[] _toeplitz;
+    _toeplitz = 0;
+    if (hash == "toeplitz") {
+	if (key.length() != key_len)
+	    return errh->error("KEY must be %d bytes long", (int) key_len);
+	_toeplitz = new uint32_t[max_input * 256];
+	set_key(reinterpret_cast<const unsigned char *>(key.data()));
+    } else if (hash == "crc32c") {
+#if !defined(__SSE4_2__)
+	for (uint32_t i = 0; i < 256; ++i) {
+	    uint32_t c = i;
+	    for (int b = 0; b < 8; ++b)
+		c = (c >> 1) ^ (c & 1 ? 0x82F63B78 : 0);
+	    crc32c_table[i] = c;
+	}
+#endif
+    } else
+	return errh->error("HASH must be %<toeplitz%> or %<crc32c%>");
+
+    delete[] _table;
+    _table = new uint16_t[table_size];
+    _mask = table_size - 1;
+    for (uint32_t i = 0; i < table_size; ++i)
+	_table[i] = i % noutputs();
+    return 0;
+}
+
+int
+RSSSwitch::initialize(ErrorHandler *)
+{
+    // Each thread counts into its own array, so RX threads pushing at once
+    // neither lose counts nor share cache lines.
+    _counts.initialize(this);
+    for (int t = 0; t < _counts.size(); ++t) {
+	_counts[t] = new uint32_t[_mask + 1];
+	memset(_counts[t], 0, sizeof(uint32_t) * (_mask + 1));
+    }
+    return 0;
+}
+
+uint32_t
+RSSSwitch::crc32c(const unsigned char *data, int len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+#if defined(__SSE4_2__)
+    for (; len >= 4; data += 4, len -= 4)
+	crc = __builtin_ia32_crc32si(crc, *reinterpret_cast<const uint32_t *>(data));
+    for (; len > 0; ++data, --len)
+	crc = __builtin_ia32_crc32qi(crc, *data);
+#else
+    for (; len > 0; ++data, --len)
+	crc = (crc >> 8) ^ crc32c_table[(crc ^ *data) & 0xFF];
+#endif
+    return ~crc;
+}
+
+inline uint32_t
+RSSSwitch::hash(const Packet *p) const
+{
+    const unsigned char *nh, *end = p->end_data();
+    if (p->has_network_header())
+	nh = p->network_header();
+    else
+	nh = p->data() + _offset;
+    if (nh + 1 > end)
+	return 0;
+
+    // gather addresses, then ports, as RSS does
+    uint32_t buf[max_input / 4];
+    int alen, len;
+    const unsigned char *th;
+    uint8_t proto;
+    if ((*nh >> 4) == 4 && nh + sizeof(click_ip) <= end) {
+	const click_ip *iph = reinterpret_cast<const click_ip *>(nh);
+	memcpy(buf, &iph->ip_src, 8);
+	alen = 4;
+	th = nh + (iph->ip_hl << 2);
+	proto = IP_ISFRAG(iph) ? 0 : iph->ip_p;
+    } else if ((*nh >> 4) == 6 && nh + sizeof(click_ip6) <= end) {
+	const click_ip6 *ip6h = reinterpret_cast<const click_ip6 *>(nh);
+	memcpy(buf, &ip6h->ip6_src, 32);
+	alen = 16;
+	th = nh + sizeof(click_ip6);
+	proto = ip6h->ip6_nxt;
+    } else
+	return 0;
+    len = 2 * alen;
+    if ((proto == IP_PROTO_TCP || proto == IP_PROTO_UDP || proto == IP_PROTO_SCTP)
+	&& th + 4 <= end) {
+	memcpy(&buf[len / 4], th, 4);
+	len += 4;
+    }
+
+    unsigned char *data = reinterpret_cast<unsigned char *>(buf);
+    if (_symmetric) {
+	// order the endpoints so that both directions hash the same
+	int c = memcmp(data, data + alen, alen);
+	if (c > 0 || (c == 0 && len > 2 * alen
+		      && memcmp(data + len - 4, data + len - 2, 2) > 0)) {
+	    unsigned char tmp[16];
+	    memcpy(tmp, data, alen);
+	    memcpy(data, data + alen, alen);
+	    memcpy(data + alen, tmp, alen);
+	    if (len > 2 * alen) {
+		uint16_t *ports = reinterpret_cast<uint16_t *>(data + 2 * alen);
+		uint16_t t = ports[0];
+		ports[0] = ports[1];
+		ports[1] = t;
+	    }
+	}
+    }
+
+    if (!_toeplitz)
+	return crc32c(data, len);
+    uint32_t h = 0;
+    for (int i = 0; i < len; ++i)
+	h ^= _toeplitz[i * 256 + data[i]];
+    return h;
+}
+
+void
+RSSSwitch::push(int, Packet *p)
+{
+    uint32_t i = hash(p) & _mask;
+    _counts.local()[i]++;
+    output(_table[i]).push(p);
+}
+
+enum { h_table, h_counts, h_reset_counts };
+
+String
+RSSSwitch::read_handler(Element *e, void *user_data)
+{
+    RSSSwitch *rs = static_cast<RSSSwitch *>(e);
+    StringAccum sa;
+    for (uint32_t i = 0; i <= rs->_mask; ++i) {
+	if (i)
+	    sa << ' ';
+	if ((intptr_t) user_data == h_table)
+	    sa << rs->_table[i];
+	else {
+	    uint32_t n = 0;
+	    for (int t = 0; t < rs->_counts.size(); ++t)
+		n += rs->_counts[t][i];
+	    sa << n;
+	}
+    }
+    return sa.take_string();
+}
+
+int
+RSSSwitch::write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh)
+{
+    RSSSwitch *rs = static_cast<RSSSwitch *>(e);
+    if ((intptr_t) user_data == h_reset_counts) {
+	for (int t = 0; t < rs->_counts.size(); ++t)
+	    memset(rs->_counts[t], 0, sizeof(uint32_t) * (rs->_mask + 1));
+	return 0;
+    }
+
+    Vector<String> words;
+    cp_spacevec(str, words);
+    if (words.size() == 0 || words.size() > (int) rs->_mask + 1)
+	return errh->error("expected between 1 and %d output ports", rs->_mask + 1);
+    Vector<uint16_t> ports;
+    for (int i = 0; i < words.size(); ++i) {
+	int port;
+	if (!IntArg().parse(words[i], port) || port < 0 || port >= rs->noutputs())
+	    return errh->error("bad output port %<%s%>", words[i].c_str());
+	ports.push_back(port);
+    }
+    // Each entry changes with a single store, so a packet being pushed
+    // concurrently sees either its old port or its new one.
+    for (uint32_t i = 0; i <= rs->_mask; ++i)
+	rs->_table[i] = ports[i % ports.size()];
+    return 0;
+}
+
+void
+RSSSwitch::add_handlers()
+{
+    add_read_handler("table", read_handler, h_table);
+    add_write_handler("table", write_handler, h_table);
+    add_read_handler("counts", read_handler, h_counts);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::h_button);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(RSSSwitch)
+ELEMENT_MT_SAFE(RSSSwitch)
@@ -0,0 +1,152 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RSSSWITCH_HH
+#define CLICK_RSSSWITCH_HH
+#include <click/element.hh>
+#include <click/sharded.hh>
+CLICK_DECLS
+
+/*
+=c
+
+RSSSwitch([I<keywords> HASH, KEY, SYMMETRIC, TABLE_SIZE, OFFSET])
+
+=s ip
+
+spreads flows over outputs like receive-side scaling
+
+=d
+
+RSSSwitch does in software what a NIC's receive-side scaling (RSS) does in
+hardware. It hashes each packet's IPv4 or IPv6 5-tuple, looks the hash up in
+an indirection table, and emits the packet on the output the table names.
+Packets of the same flow always take the same output, so a single input can
+be spread over several threads, each pulling from its own ThreadSafeQueue,
+without reordering any flow.
+
+The hashed bytes are the source address, destination address, source port
+and destination port, in that order, as for RSS. Ports are included for TCP,
+UDP and SCTP packets that are not fragments; other packets, and all IPv4
+fragments, hash their addresses only, so the fragments of a packet stay
+together. IPv6 packets hash their ports only if the transport header
+immediately follows the IPv6 header. Packets that are not IP hash to 0.
+
+The low bits of the hash select an entry in the indirection table, which
+has TABLE_SIZE entries, each naming an output port. Initially entry I<i>
+names output I<i> mod I<n>, where I<n> is the number of outputs. The
+C<table> handler rewrites the table while packets flow, so load can be moved
+between outputs without moving any other flows; the C<counts> handler shows
+which entries are busy.
+
+If a packet has a network header annotation, RSSSwitch hashes the header it
+points to. Otherwise the IP header is taken to start OFFSET bytes into the
+packet data.
+
+Keyword arguments are:
+
+=over 8
+
+=item HASH
+
+Either C<toeplitz> or C<crc32c>. The Toeplitz hash is the one RSS NICs
+compute, and with the same KEY it chooses the same table entries they do.
+CRC32C is cheaper, and uses the SSE4.2 CRC32 instruction when Click is
+compiled for it. Default is C<toeplitz>.
+
+=item KEY
+
+String. The Toeplitz hash key, 40 bytes long, usually written in hex as
+C<\E<lt>...E<gt>>. Default is the key most NICs use by default, which begins
+with bytes 6d 5a 56 da.
+
+=item SYMMETRIC
+
+Boolean. If true, the two directions of a flow hash the same, so both go to
+the same output. Default is false.
+
+=item TABLE_SIZE
+
+Unsigned. The number of indirection table entries, a power of two no
+larger than 4096. Default is 128.
+
+=item OFFSET
+
+Unsigned. The offset of the IP header in packets that have no network header
+annotation. Default is 0.
+
+=back
+
+=h table read/write
+
+The indirection table, as a space-separated list of output ports. Writing a
+list shorter than TABLE_SIZE repeats it to fill the table, so writing C<0 1>
+splits the load evenly between outputs 0 and 1.
+
+=h counts read-only
+
+The number of packets that have matched each indirection table entry, as a
+space-separated list.
+
+=h reset_counts write-only
+
+Resets the C<counts> to zero.
+
+=e
+
+Spread the packets from one device over four threads:
+
+  FromDevice(eth0) -> rss :: RSSSwitch(OFFSET 14, SYMMETRIC true);
+  rss[0] -> q0 :: ThreadSafeQueue -> ... -> Discard;
+  rss[1] -> q1 :: ThreadSafeQueue -> ... -> Discard;
+  rss[2] -> q2 :: ThreadSafeQueue -> ... -> Discard;
+  rss[3] -> q3 :: ThreadSafeQueue -> ... -> Discard;
+  StaticThreadSched(q0 0, q1 1, q2 2, q3 3);
+
+Later, writing C<1 1 2 3> to C<rss.table> moves output 0's share of the
+flows to output 1.
+
+=a
+
+HashSwitch, RoundRobinSwitch, ThreadSafeQueue, StaticThreadSched */
+
+class RSSSwitch : public Element { public:
+
+    RSSSwitch() CLICK_COLD;
+    ~RSSSwitch() CLICK_COLD;
+
+    const char *class_name() const	{ return "RSSSwitch"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+
+  private:
+
+    enum {
+	key_len = 40,
+	max_input = 36,		// IPv6 addresses and ports
+	max_table_size = 4096
+    };
+
+    uint32_t *_toeplitz;	// [max_input][256] per-byte hash contributions
+    uint16_t *_table;
+    Sharded<uint32_t *> _counts;	// per thread: [TABLE_SIZE] packet counts
+    uint32_t _mask;
+    uint32_t _offset;
+    bool _symmetric;
+
+    void set_key(const unsigned char *key) CLICK_COLD;
+    inline uint32_t hash(const Packet *p) const;
+
+    static uint32_t crc32c(const unsigned char *data, int len);
+
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -35,7 +35,7 @@
 CLICK_DECLS
 
 Aes::Aes()
-  : _op(0)
+  : _op(0), _legacy(false)
 {
 }
 
@@ -44,6 +44,7 @@ Aes::~Aes()
 }
 
 Aes::Aes(int decrypt)
+  : _legacy(false)
 {
   _op = decrypt;
 }
@@ -54,7 +55,11 @@ Aes::configure(Vector<String> &conf, ErrorHandler *errh)
   int dec_int;
   _ignore = 12;/*This is the message digest*/
 
-  if (Args(conf, this, errh).read_mp("ENCRYPT", dec_int).complete() < 0)
+  if (Args(conf, this, errh)
+      .read_mp("ENCRYPT", dec_int)
+      .read("IGNORE", _ignore)
+      .read("LEGACY", _legacy)
+      .complete() < 0)
     return -1;
   _op = dec_int;
   return 0;
@@ -66,46 +71,99 @@ Aes::initialize(ErrorHandler *)
  return 0;
 }
 
+/*
+  The CBC variant below chains only the first 8 bytes of each 16-byte block,
+  since the ESP header carries an 8-byte IV. Keep it bit-compatible with
+  existing peers.
+*/
+static void
+cbc8_encrypt(const AES128 &aes, const unsigned char *iv, unsigned char *idat, int nblocks)
+{
+  const unsigned char *chain = iv;
+  for (; nblocks > 0; --nblocks, idat += 16) {
+    for (int i = 0; i < 8; i++)
+      idat[i] ^= chain[i];
+    aes.encrypt(idat, idat);
+    chain = idat;
+  }
+}
+
+static void
+cbc8_decrypt(const AES128 &aes, const unsigned char *iv, unsigned char *idat, int nblocks)
+{
+  /* Unlike encryption, decryption of different blocks is independent, so
+     hand the cipher several blocks at once. */
+  enum { GROUP = 8 };
+  unsigned char chain[GROUP + 1][8];
+  memcpy(chain[0], iv, 8);
+  while (nblocks > 0) {
+    int n = (nblocks < GROUP ? nblocks : GROUP);
+    for (int b = 0; b < n; b++)
+      memcpy(chain[b + 1], idat + 16 * b, 8);
+    aes.decrypt_blocks(idat, idat, n);
+    for (int b = 0; b < n; b++)
+      for (int i = 0; i < 8; i++)
+	idat[16 * b + i] ^= chain[b][i];
+    memcpy(chain[0], chain[n], 8);
+    idat += 16 * n;
+    nblocks -= n;
+  }
+}
+
 Packet *
 Aes::simple_action(Packet *p_in)
 {
-
   WritablePacket *p = p_in->uniqueify();
-  unsigned char hold[8];
+  if (!p)
+    return 0;
   struct esp_new *esp = (struct esp_new *)p->data();
-  SADataTuple * sa_data;
-  unsigned char iv[8];
-  unsigned char *ivp = esp->esp_iv;
   unsigned char * idat = p->data() + sizeof(esp_new);
   int plen = p->length() - sizeof(esp_new) - _ignore;
-  int i;
+  SADataTuple * sa_data =(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
+
+  if (sa_data == NULL) {
+    if (_op == AES_DECRYPT)
+      click_chatter("AES: No SADataTuple reference annotation. check man page\n");
+    else
+      click_chatter("AES: No SADataTuple annotation. This module is not properly placed check man page\n");
+    p->kill();
+    return 0;
+  }
+
   /*
     Since plen is a multiple of 8 bytes we check whether it is a multiple of 16 bytes as well.
     if it is not we force the first 8 bytes of the message digest to be encrypted rather than changing ESP
     encapsulation process to use a different padding scheme, because 128-bit key AES operates on 16 byte blocks
   */
   if ((plen % 16) != 0) { plen += 8; }
-  i = plen;
 
-  sa_data =(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
+  if (_legacy)
+    legacy_crypt(esp->esp_iv, idat, plen, sa_data);
+  else if (plen > 0) {
+    /* The key schedule is cached in the SA, so no per-packet key setup */
+    if (_op == AES_DECRYPT)
+      cbc8_decrypt(sa_data->aes_schedule, esp->esp_iv, idat, (plen + 15) / 16);
+    else
+      cbc8_encrypt(sa_data->aes_schedule, esp->esp_iv, idat, (plen + 15) / 16);
+  }
+
+  return(p);
+}
+
+void
+Aes::legacy_crypt(unsigned char *ivp, unsigned char *idat, int plen, SADataTuple *sa_data)
+{
+  unsigned char hold[8];
+  unsigned char iv[8];
+  AES_KEY key;
+  int i;
 
   if (_op == AES_DECRYPT) {
     memcpy(iv, ivp, 8);
-    if(sa_data==NULL) {
-	click_chatter("AES: No SADataTuple reference annotation. check man page\n");
-        p->kill();
-        return 0;
-    }
     /*Set the Decrypt key*/
-    AES_set_decrypt_key((const unsigned char *)&sa_data->Encryption_key, 128, &_key);
-  } else {
-    if(sa_data==NULL) {
-	click_chatter("AES: No SADataTuple annotation. This module is not properly placed check man page\n");
-        p->kill();
-        return 0;
-    }
-    AES_set_encrypt_key((const unsigned char *)&sa_data->Encryption_key, 128,&_key);
-  }
+    AES_set_decrypt_key((const unsigned char *)&sa_data->Encryption_key, 128, &key);
+  } else
+    AES_set_encrypt_key((const unsigned char *)&sa_data->Encryption_key, 128,&key);
 
 #ifdef DEBUG
    click_chatter("Key: %x%x%x%x%x%x%x%x",sa_data->Encryption_key[0], sa_data->Encryption_key[1], sa_data->Encryption_key[2], sa_data->Encryption_key[3],sa_data->Encryption_key[4], sa_data->Encryption_key[5], sa_data->Encryption_key[6], sa_data->Encryption_key[7]);
@@ -116,7 +174,7 @@ Aes::simple_action(Packet *p_in)
 
     if(_op == AES_DECRYPT) {
       memcpy(hold, idat, 8);
-      AES_decrypt((const unsigned char *)idat, (unsigned char *)idat, (const AES_KEY *)&_key);
+      AES_decrypt((const unsigned char *)idat, (unsigned char *)idat, (const AES_KEY *)&key);
       /* CBC: XOR with the IV */
       for (i = 0; i < 8; i++)
 	idat[i] ^= ivp[i];
@@ -125,7 +183,7 @@ Aes::simple_action(Packet *p_in)
       /* CBC: XOR with the IV */
       for (i = 0; i < 8; i++)
 	idat[i] ^= ivp[i];
-      AES_encrypt((const unsigned char *)idat, (unsigned char *)idat,&_key);
+      AES_encrypt((const unsigned char *)idat, (unsigned char *)idat,&key);
       ivp = idat;
     }
     idat += 16;
@@ -133,8 +191,6 @@ Aes::simple_action(Packet *p_in)
   }
   if (_op == AES_DECRYPT)
     memcpy(ivp, iv, 8);
-
-  return(p);
 }
 
 /***************************AES BELOW********************************/
@@ -1239,3 +1295,4 @@ void Aes::AES_decrypt(const unsigned char *in, unsigned char *out,
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Aes)
+ELEMENT_MT_SAFE(Aes)
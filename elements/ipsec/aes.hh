@@ -6,18 +6,41 @@ CLICK_DECLS
 
 /*
  * =c
- * IPsecAES(ENCRYPT)
+ * IPsecAES(ENCRYPT [, IGNORE, LEGACY])
  * =s ipsec
- * encrypt packet using DES-CBC
+ * encrypt packet using AES-CBC
  * =d
  *
- * Encrypts or decrypts packet using DES-CBC. If the first argument is 0,
+ * Encrypts or decrypts packet using AES-128-CBC. If the first argument is 0,
  * IPsecAES will decrypt. If the first argument is 1, IPsecAES will encrypt.
- * KEY is the DES secret key. Gets IV value from ESP header. IGNORE is the
- * number of bytes at the end of the payload to ignore. By default, IGNORE is
- * 12, which is the number of SHA1 authentication digest bytes for ESP or AH.
+ * The key is taken from the SADataTuple annotation, whose key schedule is
+ * expanded once per security association. Gets IV value from ESP header.
+ * The last IGNORE bytes of the payload, which hold the authentication
+ * digest for ESP or AH, are not encrypted.
  *
- * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthSHA1
+ * Where available, the AES-NI instructions are used, and decryption works
+ * on several blocks at once.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item IGNORE
+ *
+ * Unsigned. The number of bytes at the end of the payload to leave
+ * unencrypted. Default is 12, the length of the IPsecAuthHMACSHA1 digest;
+ * use 16 with IPsecAuthHMACSHA256.
+ *
+ * =item LEGACY
+ *
+ * Boolean. If true, expand the key for every packet and use the original
+ * table-driven implementation. Produces identical output; useful only for
+ * benchmarking. Default is false.
+ *
+ * =back
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthHMACSHA1, IPsecAuthHMACSHA256,
+ * IPsecAESGCM
  */
 
 # define GETU32(pt) (((unsigned long)(pt)[0] << 24) ^ ((unsigned long)(pt)[1] << 16) ^ ((unsigned long)(pt)[2] <<  8) ^ ((unsigned long)(pt)[3]))
@@ -35,6 +58,7 @@ typedef struct aes_key_st AES_KEY;
 
 
 class Address;
+class SADataTuple;
 
 
 class Aes : public Element {
@@ -58,9 +82,10 @@ class Aes : public Element {
    int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
    void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
    void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
+   void legacy_crypt(unsigned char *ivp, unsigned char *idat, int plen, SADataTuple *sa_data);
    unsigned _op;
+   bool _legacy;
    int _ignore;
-   AES_KEY _key;
 };
 
 CLICK_ENDDECLS
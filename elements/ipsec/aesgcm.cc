@@ -0,0 +1,159 @@
+/*
+ * aesgcm.{cc,hh} -- element implements IPsec ESP using AES-GCM (RFC 4106)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "aesgcm.hh"
+#include "esp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include <click/machine.hh>
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+IPsecAESGCM::IPsecAESGCM()
+  : _op(AES_ENCRYPT), _icv_len(16)
+{
+}
+
+IPsecAESGCM::~IPsecAESGCM()
+{
+}
+
+int
+IPsecAESGCM::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  if (Args(conf, this, errh)
+      .read_mp("ENCRYPT", _op)
+      .read("ICV_LENGTH", _icv_len)
+      .complete() < 0)
+    return -1;
+  if (_icv_len != 8 && _icv_len != 12 && _icv_len != 16)
+    return errh->error("ICV_LENGTH must be 8, 12, or 16");
+  return 0;
+}
+
+int
+IPsecAESGCM::initialize(ErrorHandler *)
+{
+  _drops = 0;
+  return 0;
+}
+
+void
+IPsecAESGCM::drop(Packet *p)
+{
+  if (_drops == 0)
+    click_chatter("Invalid AES-GCM integrity check value");
+  _drops++;
+  checked_output_push(1, p);
+}
+
+/*
+  Allocate the next IV. Only 32-bit atomics are available, so the 64-bit
+  counter is two words. The low word holds 0xFFFFFFFF only while the thread
+  that used its last value carries into the high word; others wait.
+*/
+static uint64_t
+next_iv(SADataTuple *sa_data)
+{
+  while (1) {
+    uint32_t lo = sa_data->gcm_iv_lo;
+    click_fence();
+    uint32_t hi = sa_data->gcm_iv_hi;
+    if (lo == 0xFFFFFFFFU)
+      click_relax_fence();
+    else if (atomic_uint32_t::compare_swap(sa_data->gcm_iv_lo, lo, lo + 1) == lo) {
+      if (lo == 0xFFFFFFFEU) {
+	sa_data->gcm_iv_hi = hi + 1;
+	click_fence();
+	sa_data->gcm_iv_lo = 0;
+      }
+      return ((uint64_t) hi << 32) | lo;
+    }
+  }
+}
+
+Packet *
+IPsecAESGCM::simple_action(Packet *p)
+{
+  SADataTuple *sa_data = (SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
+  if (sa_data == NULL) {
+    click_chatter("AES-GCM: No SADataTuple annotation. This module is not properly placed check man page\n");
+    p->kill();
+    return 0;
+  }
+
+  unsigned char nonce[AES128GCM::nonce_size];
+  unsigned char tag[AES128GCM::tag_size];
+  memcpy(nonce, sa_data->Authentication_key, 4);	// salt
+
+  if (_op == AES_ENCRYPT) {
+    if (p->length() < sizeof(esp_new)) {
+      p->kill();
+      return 0;
+    }
+    WritablePacket *q = p->put(_icv_len);
+    if (!q)
+      return 0;
+    struct esp_new *esp = (struct esp_new *)q->data();
+    // The IV must never repeat for a key; the ESP sequence number may wrap,
+    // so use a separate 64-bit counter.
+    uint64_t iv = next_iv(sa_data);
+    for (int i = 0; i < 8; i++)
+      esp->esp_iv[i] = iv >> (56 - 8 * i);
+    memcpy(nonce + 4, esp->esp_iv, 8);
+
+    unsigned char *payload = q->data() + sizeof(esp_new);
+    int len = q->length() - sizeof(esp_new) - _icv_len;
+    // AAD is the SPI and sequence number
+    sa_data->gcm_context.encrypt(nonce, q->data(), 8, payload, payload, len, tag);
+    memcpy(payload + len, tag, _icv_len);
+    return q;
+
+  } else {
+    if (p->length() < sizeof(esp_new) + _icv_len) {
+      drop(p);
+      return 0;
+    }
+    WritablePacket *q = p->uniqueify();
+    if (!q)
+      return 0;
+    struct esp_new *esp = (struct esp_new *)q->data();
+    memcpy(nonce + 4, esp->esp_iv, 8);
+
+    unsigned char *payload = q->data() + sizeof(esp_new);
+    int len = q->length() - sizeof(esp_new) - _icv_len;
+    if (!sa_data->gcm_context.decrypt(nonce, q->data(), 8, payload, payload, len, payload + len, _icv_len)) {
+      drop(q);
+      return 0;
+    }
+    q->take(_icv_len);
+    return q;
+  }
+}
+
+void
+IPsecAESGCM::add_handlers()
+{
+  add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPsecAESGCM)
+ELEMENT_MT_SAFE(IPsecAESGCM)
@@ -0,0 +1,79 @@
+#ifndef CLICK_IPSECAESGCM_HH
+#define CLICK_IPSECAESGCM_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecAESGCM(ENCRYPT [, ICV_LENGTH])
+ * =s ipsec
+ * encrypt and authenticate ESP packets using AES-GCM
+ * =d
+ *
+ * Encrypts and authenticates, or verifies and decrypts, ESP packets using
+ * AES-128-GCM as described in RFC 4106. IPsecAESGCM replaces both
+ * IPsecAuthHMACSHA1 and IPsecAES in an ESP pipeline. If the first argument
+ * is 1, IPsecAESGCM will encrypt; if it is 0, IPsecAESGCM will decrypt.
+ *
+ * When encrypting, IPsecAESGCM expects a packet from IPsecESPEncap. It
+ * replaces the ESP IV with a per-SA counter, encrypts the payload, and
+ * appends an integrity check value (ICV). The SPI and sequence number are
+ * authenticated but not encrypted. When decrypting, IPsecAESGCM verifies and
+ * removes the ICV; packets that fail verification are dropped, or emitted
+ * on output 1 if it exists.
+ *
+ * The key is taken from the SADataTuple annotation. AES-GCM needs no
+ * separate authentication key, so the first 4 bytes of the SA's
+ * authentication key serve as the RFC 4106 salt.
+ *
+ * Where available, the AES-NI and PCLMULQDQ instructions are used.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item ICV_LENGTH
+ *
+ * Integer. ICV length in bytes: 8, 12, or 16. Default is 16.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAES
+ */
+
+class IPsecAESGCM : public Element {
+
+public:
+  IPsecAESGCM() CLICK_COLD;
+  ~IPsecAESGCM() CLICK_COLD;
+
+  const char *class_name() const	{ return "IPsecAESGCM"; }
+  const char *port_count() const	{ return PORTS_1_1X2; }
+  const char *processing() const	{ return PROCESSING_A_AH; }
+
+  int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  int initialize(ErrorHandler *) CLICK_COLD;
+  void add_handlers() CLICK_COLD;
+
+  Packet *simple_action(Packet *);
+
+  enum { AES_DECRYPT = 0, AES_ENCRYPT = 1 };
+
+private:
+
+  int _op;
+  int _icv_len;
+  atomic_uint32_t _drops;
+
+  void drop(Packet *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -41,39 +41,74 @@ IPsecESPUnencap::~IPsecESPUnencap()
 {
 }
 
+/*
+  Anti-replay check (RFC 2406 section 3.4.3). Packets of one SA may be
+  checked on several threads at once, so the window uses no locks: each
+  bitmap slot carries the block number it covers and is claimed or marked
+  with one compare-and-swap, and the right edge of the window (lastseq) is
+  advanced with compare-and-swap.
+*/
 int
-IPsecESPUnencap::checkreplaywindow(SADataTuple * sa_data,unsigned long seq)
-  {
-	unsigned long diff;
+IPsecESPUnencap::checkreplaywindow(SADataTuple * sa_data,unsigned long seq_ul)
+{
+	uint32_t seq = seq_ul;
+	uint32_t top = sa_data->lastseq;
+	uint32_t win = sa_data->ooowin;
 
 	if (seq == 0)
 		return 0;		/* first == 0 or wrapped */
-	/*This logic has been added for the time being to deal with replay rollover*/
-	if((seq == sa_data->replay_start_counter) && (sa_data->lastseq!=sa_data->replay_start_counter)) { sa_data->bitmap=0;sa_data->lastseq=seq;return 1;}
-
-	if (seq > sa_data->lastseq)	/* new larger sequence number */
-	{
-		diff = seq - sa_data->lastseq;
-		if (diff < sa_data->ooowin) /* In win, set bit for this pkt */
-			sa_data->bitmap = (sa_data->bitmap << diff) | 1;
-		else
-			sa_data->bitmap = 1; /* This packet has way larger */
-
-		sa_data->lastseq = seq;
-		return 1;		/* larger is good */
+	/*ooowin is 8 bits wide, so the bitmap always covers the window*/
+	static_assert(SADataTuple::REPLAY_WINDOW >= 255, "replay bitmap too small");
+
+	/*The sender's counter restarts at replay_start_counter when it rolls
+	  over; restart the window once when that happens*/
+	if (seq == sa_data->replay_start_counter && top >= 0x80000000U
+	    && atomic_uint32_t::compare_swap(sa_data->lastseq, top, seq) == top) {
+		for (int i = 0; i < SADataTuple::REPLAY_SLOTS; i++)
+			sa_data->replay_slot[i] = 0;
+		top = seq;
 	}
-	diff = sa_data->lastseq - seq;
-	if (diff >= sa_data->ooowin) {	/* too old or wrapped */
+
+	if (seq <= top && top - seq >= win) {	/* too old or wrapped */
 		click_chatter("Replay protection: This packet is too old to be accepted\n");
 		return 0;
+	}
 
-        }
-	if (sa_data->bitmap & (1 << diff)) { /* this packet already seen */
-		click_chatter("Replay protection: This packet is already seen...\n");
-		return 0;
-        }
-	sa_data->bitmap |= (1 << diff);	/* mark as seen */
-	return 1;			/* out of order but good */
+	/*Mark this packet in its slot, claiming the slot if it still covers
+	  an older block*/
+	uint32_t block = seq / 8;
+	uint32_t tag = block / SADataTuple::REPLAY_SLOTS;
+	uint32_t bit = 1 << (seq % 8);
+	uint32_t &slot = sa_data->replay_slot[block % SADataTuple::REPLAY_SLOTS];
+	uint32_t old = slot;
+	while (1) {
+		uint32_t next;
+		if ((old >> 8) == tag) {
+			if (old & bit) {	/* this packet already seen */
+				click_chatter("Replay protection: This packet is already seen...\n");
+				return 0;
+			}
+			next = old | bit;
+		} else if ((old >> 8) < tag)
+			next = (tag << 8) | bit;
+		else {	/* a much newer packet took the slot */
+			click_chatter("Replay protection: This packet is too old to be accepted\n");
+			return 0;
+		}
+		uint32_t actual = atomic_uint32_t::compare_swap(slot, old, next);
+		if (actual == old)
+			break;
+		old = actual;
+	}
+
+	/*Advance the window*/
+	while (seq > top) {
+		uint32_t actual = atomic_uint32_t::compare_swap(sa_data->lastseq, top, seq);
+		if (actual == top)
+			break;
+		top = actual;
+	}
+	return 1;
 }
 
 Packet *
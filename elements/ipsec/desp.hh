@@ -13,10 +13,14 @@ CLICK_DECLS
  * removes IPSec encapsulation
  * =d
  *
- * Removes ESP header added by IPsecESPEncap. see RFC 2406. Does not perform
- * the optional anti-replay attack checks.
+ * Removes ESP header added by IPsecESPEncap. see RFC 2406. Drops packets
+ * that fail the anti-replay check: those whose sequence number was already
+ * seen, or that are older than the security association's out-of-order
+ * window (at most 255 packets, since the window size is stored in 8 bits).
+ * The check is lock-free, so packets of one security association may be
+ * processed on several threads at once.
  *
- * =a IPsecESPUnencap, IPsecDES, IPsecAuthSHA1
+ * =a IPsecESPEncap, IPsecESPReorder, IPsecDES, IPsecAuthSHA1
  */
 
 class IPsecESPUnencap : public Element {
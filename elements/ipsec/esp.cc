@@ -49,6 +49,22 @@ IPsecESPEncap::configure(Vector<String> &, ErrorHandler *)
   return 0;
 }
 
+uint32_t
+IPsecESPEncap::next_sequence(SADataTuple *sa_data)
+{
+  // Several threads may encapsulate packets for the same SA, so claim the
+  // sequence number with compare-and-swap.
+  uint32_t seq = sa_data->cur_rpl;
+  while (1) {
+    //if the replay counter rolls over...set it to the agreed start value
+    uint32_t next = (seq == 0 ? sa_data->replay_start_counter : seq + 1);
+    uint32_t actual = atomic_uint32_t::compare_swap(sa_data->cur_rpl, seq, next);
+    if (actual == seq)
+      return seq;
+    seq = actual;
+  }
+}
+
 Packet *
 IPsecESPEncap::simple_action(Packet *p)
 {
@@ -74,12 +90,7 @@ IPsecESPEncap::simple_action(Packet *p)
   // copy in ESP header
   // Get SPI from packet user annotation. This is the fourth user integer.
   esp->esp_spi = htonl((uint32_t)IPSEC_SPI_ANNO(p));
-  esp->esp_rpl = htonl(sa_data->cur_rpl);
-
-  if((sa_data->cur_rpl++) == 0) {
-	//if the replay counter rolls over...set it to the agreed start value
-        sa_data->cur_rpl = sa_data->replay_start_counter;
-  }
+  esp->esp_rpl = htonl(next_sequence(sa_data));
   i = click_random() >> 2;
   memmove(&esp->esp_iv[0], &i, 4);
   i = click_random() >> 2;
@@ -18,11 +18,16 @@ CLICK_DECLS
  * RFC 2406: pad[0] = 1, pad[1] = 2, pad[2] = 3, etc.
  *
  * The ESP header added to the packet includes the 32 bit SPI, 32 bit replay
- * counter, and 64 bit Integrity Vector (IV).
+ * counter, and 64 bit Integrity Vector (IV). Replay counters are allocated
+ * atomically, so packets of one security association may be encapsulated on
+ * several threads at once; use IPsecESPReorder to restore their order
+ * afterwards.
  *
- * =a IPsecESPUnencap, IPsecAuthSHA1, IPsecDES
+ * =a IPsecESPUnencap, IPsecESPReorder, IPsecAuthSHA1, IPsecDES
  */
 
+class SADataTuple;
+
 struct esp_new {
   uint32_t esp_spi;
   uint32_t esp_rpl;
@@ -46,6 +51,8 @@ public:
 private:
 
   enum { BLKS = 8 };
+
+  static uint32_t next_sequence(SADataTuple *sa_data);
 };
 
 CLICK_ENDDECLS
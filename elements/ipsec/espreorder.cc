@@ -0,0 +1,301 @@
+// -*- c-basic-offset: 2 -*-
+/*
+ * espreorder.{cc,hh} -- restore per-SA ESP sequence number order
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "espreorder.hh"
+#include "esp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+IPsecESPReorder::IPsecESPReorder()
+  : _timer(this), _idle_timer(this), _ready_head(0), _ready_tail(0), _draining(false),
+    _held(0), _late(0), _skipped(0)
+{
+}
+
+IPsecESPReorder::~IPsecESPReorder()
+{
+}
+
+int
+IPsecESPReorder::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  uint32_t window = 256;
+  _timeout = Timestamp::make_msec(10);
+  _idle_timeout = Timestamp(60);
+  if (Args(conf, this, errh)
+      .read("WINDOW", window)
+      .read("TIMEOUT", _timeout)
+      .read("IDLE_TIMEOUT", _idle_timeout)
+      .complete() < 0)
+    return -1;
+  if (window == 0 || window > 65536)
+    return errh->error("WINDOW must be between 1 and 65536");
+  for (_window = 1; _window < window; _window *= 2)
+    /* nada */;
+  _mask = _window - 1;
+  return 0;
+}
+
+int
+IPsecESPReorder::initialize(ErrorHandler *)
+{
+  _timer.initialize(this);
+  _idle_timer.initialize(this);
+  if (_idle_timeout)
+    _idle_timer.schedule_after(_idle_timeout);
+  return 0;
+}
+
+void
+IPsecESPReorder::cleanup(CleanupStage)
+{
+  for (HashTable<uint32_t, SAState *>::iterator it = _table.begin(); it.live(); ++it) {
+    SAState *s = it.value();
+    for (uint32_t i = 0; i < _window; i++)
+      if (s->slot[i])
+	s->slot[i]->kill();
+    delete[] s->slot;
+    delete s;
+  }
+  _table.clear();
+  while (Packet *p = _ready_head) {
+    _ready_head = p->next();
+    p->kill();
+  }
+}
+
+inline void
+IPsecESPReorder::ready(Packet *p)
+{
+  p->set_next(0);
+  if (_ready_tail)
+    _ready_tail->set_next(p);
+  else
+    _ready_head = p;
+  _ready_tail = p;
+}
+
+void
+IPsecESPReorder::release(SAState *s)
+{
+  while (Packet *&x = s->slot[s->next & _mask]) {
+    ready(x);
+    x = 0;
+    s->held--;
+    _held--;
+    s->next++;
+    s->gap_since = Timestamp();
+  }
+  if (s->held && !s->gap_since)
+    s->gap_since = Timestamp::now_steady();
+}
+
+void
+IPsecESPReorder::advance(SAState *s, uint32_t next)
+{
+  uint32_t gap = next - s->next;
+  uint32_t n = (gap < _window ? gap : _window);
+  for (uint32_t i = 0; i < n; i++)
+    if (Packet *&x = s->slot[(s->next + i) & _mask]) {
+      ready(x);
+      x = 0;
+      s->held--;
+      _held--;
+      gap--;
+    }
+  _skipped += gap;
+  s->next = next;
+  s->gap_since = Timestamp();
+}
+
+void
+IPsecESPReorder::skip(SAState *s)
+{
+  // give up on the missing packets before the first held one
+  while (!s->slot[s->next & _mask]) {
+    s->next++;
+    _skipped++;
+  }
+  s->gap_since = Timestamp();
+  release(s);
+}
+
+void
+IPsecESPReorder::insert(SAState *s, uint32_t seq, Packet *p)
+{
+  if ((int32_t) (seq - s->next) < 0) {
+    // already emitted or given up
+    _late++;
+    ready(p);
+    return;
+  }
+  if (seq - s->next >= _window)
+    advance(s, seq - _window + 1);
+  Packet *&x = s->slot[seq & _mask];
+  if (x) {
+    // duplicate sequence number; leave it to the replay check
+    _late++;
+    ready(p);
+    return;
+  }
+  x = p;
+  s->held++;
+  _held++;
+  release(s);
+}
+
+void
+IPsecESPReorder::drain()
+{
+  // Called with _lock held; releases it. Only one thread emits packets at a
+  // time, and it does so without the lock, so that other threads can keep
+  // adding packets to the ready list.
+  if (_draining) {
+    _lock.release();
+    return;
+  }
+  _draining = true;
+  while (Packet *p = _ready_head) {
+    _ready_head = _ready_tail = 0;
+    _lock.release();
+    while (p) {
+      Packet *next = p->next();
+      p->set_next(0);
+      output(0).push(p);
+      p = next;
+    }
+    _lock.acquire();
+  }
+  _draining = false;
+  _lock.release();
+}
+
+void
+IPsecESPReorder::push(int, Packet *p)
+{
+  if (p->length() < sizeof(esp_new)) {
+    output(0).push(p);
+    return;
+  }
+  const esp_new *esp = reinterpret_cast<const esp_new *>(p->data());
+  uint32_t spi = ntohl(esp->esp_spi);
+  uint32_t seq = ntohl(esp->esp_rpl);
+
+  _lock.acquire();
+  SAState *s = _table.get(spi);
+  if (!s) {
+    s = new SAState;
+    s->next = seq;
+    s->held = 0;
+    s->slot = new Packet *[_window];
+    memset(s->slot, 0, sizeof(Packet *) * _window);
+    _table.set(spi, s);
+  }
+  if (_idle_timeout)
+    s->last_seen = Timestamp::recent_steady();
+  insert(s, seq, p);
+  drain();
+
+  // The timer thread holds the timer lock while it runs our timer, which
+  // takes _lock, so schedule only after releasing _lock.
+  if (_held && !_timer.scheduled())
+    _timer.schedule_after(_timeout);
+}
+
+void
+IPsecESPReorder::expire(const Timestamp &now)
+{
+  // Called with _lock held. Free the state of security associations that
+  // have been idle for _idle_timeout, emitting any packets they hold.
+  HashTable<uint32_t, SAState *>::iterator it = _table.begin();
+  while (it.live()) {
+    SAState *s = it.value();
+    if (s->last_seen + _idle_timeout <= now) {
+      while (s->held)
+	skip(s);
+      delete[] s->slot;
+      delete s;
+      it = _table.erase(it);
+    } else
+      ++it;
+  }
+}
+
+void
+IPsecESPReorder::run_timer(Timer *t)
+{
+  _lock.acquire();
+  Timestamp now = Timestamp::now_steady();
+  if (t == &_idle_timer) {
+    expire(now);
+    drain();
+    _idle_timer.reschedule_after(_idle_timeout);
+    return;
+  }
+  for (HashTable<uint32_t, SAState *>::iterator it = _table.begin(); it.live(); ++it) {
+    SAState *s = it.value();
+    if (s->held && s->gap_since + _timeout <= now)
+      skip(s);
+  }
+  drain();
+  // check again soon while packets are held, so no gap waits much longer
+  // than TIMEOUT
+  if (_held)
+    _timer.schedule_after(_timeout / 2);
+}
+
+String
+IPsecESPReorder::read_handler(Element *e, void *)
+{
+  IPsecESPReorder *r = static_cast<IPsecESPReorder *>(e);
+  r->_lock.acquire();
+  int n = r->_table.size();
+  r->_lock.release();
+  return String(n);
+}
+
+int
+IPsecESPReorder::flush_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+  IPsecESPReorder *r = static_cast<IPsecESPReorder *>(e);
+  r->_lock.acquire();
+  for (HashTable<uint32_t, SAState *>::iterator it = r->_table.begin(); it.live(); ++it) {
+    SAState *s = it.value();
+    while (s->held)
+      r->skip(s);
+  }
+  r->drain();
+  return 0;
+}
+
+void
+IPsecESPReorder::add_handlers()
+{
+  add_data_handlers("held", Handler::OP_READ, &_held);
+  add_data_handlers("late", Handler::OP_READ, &_late);
+  add_data_handlers("skipped", Handler::OP_READ, &_skipped);
+  add_read_handler("sas", read_handler, 0);
+  add_write_handler("flush", flush_handler, 0);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPsecESPReorder)
+ELEMENT_MT_SAFE(IPsecESPReorder)
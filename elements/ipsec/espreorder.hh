@@ -0,0 +1,157 @@
+#ifndef CLICK_IPSECESPREORDER_HH
+#define CLICK_IPSECESPREORDER_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecESPReorder([I<keywords> WINDOW, TIMEOUT, IDLE_TIMEOUT])
+ * =s ipsec
+ * restores ESP sequence number order
+ * =d
+ *
+ * Re-sequences ESP packets per security association. Use it after packets of
+ * one security association have been processed in parallel, for example by
+ * IPsecAES or IPsecAuthHMACSHA1 elements running on several threads, to emit
+ * them in the order given by their ESP sequence numbers. Input packets must
+ * start with the ESP header, so place IPsecESPReorder after the cipher and
+ * authentication elements but before IPsecEncap or IPsecESPUnencap.
+ *
+ * The first packet seen for an SPI sets the expected sequence number.
+ * Packets that arrive ahead of a missing sequence number are held. They are
+ * released when the gap fills; when the held packets span more than WINDOW
+ * sequence numbers; or when the gap is older than TIMEOUT, in which case the
+ * missing packets are given up for lost. A packet whose sequence number was
+ * already emitted or given up is emitted immediately and counted as late.
+ * Sequence numbers are compared modulo 2^32, so a packet more than 2^31
+ * sequence numbers ahead of the expected one also counts as late. The state
+ * for a security association is freed once it has seen no packets for
+ * IDLE_TIMEOUT; a security association that restarts its sequence numbers,
+ * such as one whose SPI is reused after rekeying, is only recognized after
+ * that.
+ *
+ * IPsecESPReorder may receive packets on several threads at once. Packets
+ * are emitted by one thread at a time, in order.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item WINDOW
+ *
+ * Unsigned. Maximum number of sequence numbers held per security
+ * association, rounded up to a power of two. Default is 256.
+ *
+ * =item TIMEOUT
+ *
+ * Time in seconds. How long to wait for a missing packet. Default is 0.01.
+ *
+ * =item IDLE_TIMEOUT
+ *
+ * Time in seconds. How long to keep the state for a security association
+ * that receives no packets. Zero means forever. Default is 60.
+ *
+ * =back
+ *
+ * =h held read-only
+ *
+ * Returns the number of packets currently held.
+ *
+ * =h late read-only
+ *
+ * Returns the number of packets emitted out of order because they arrived
+ * too late.
+ *
+ * =h skipped read-only
+ *
+ * Returns the number of sequence numbers given up for lost.
+ *
+ * =h sas read-only
+ *
+ * Returns the number of security associations with state.
+ *
+ * =h flush write-only
+ *
+ * Emits all held packets, giving up on any missing ones.
+ *
+ * =e
+ *
+ * Encapsulate and encrypt one tunnel's packets on four threads, then
+ * restore their order.
+ *
+ *   q :: ThreadSafeQueue;
+ *   q -> u0 :: Unqueue -> w :: Null;
+ *   ...
+ *   q -> u3 :: Unqueue -> w;
+ *   w -> rt :: RadixIPsecLookup(...);
+ *   rt[1] -> IPsecESPEncap -> IPsecAuthHMACSHA1(0) -> IPsecAES(1)
+ *       -> IPsecESPReorder -> IPsecEncap(50) -> ...;
+ *   StaticThreadSched(u0 1, u1 2, u2 3, u3 4);
+ *
+ * See also conf/ipsec-parallel.click.
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap
+ */
+
+class IPsecESPReorder : public Element { public:
+
+  IPsecESPReorder() CLICK_COLD;
+  ~IPsecESPReorder() CLICK_COLD;
+
+  const char *class_name() const	{ return "IPsecESPReorder"; }
+  const char *port_count() const	{ return PORTS_1_1; }
+  const char *processing() const	{ return PUSH; }
+
+  int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  int initialize(ErrorHandler *) CLICK_COLD;
+  void cleanup(CleanupStage) CLICK_COLD;
+  void add_handlers() CLICK_COLD;
+
+  void push(int, Packet *);
+  void run_timer(Timer *);
+
+ private:
+
+  struct SAState {
+    uint32_t next;		// next sequence number to emit
+    uint32_t held;
+    Timestamp gap_since;	// when the oldest gap opened, if held
+    Timestamp last_seen;
+    Packet **slot;		// indexed by sequence number & _mask
+  };
+
+  HashTable<uint32_t, SAState *> _table;
+  Spinlock _lock;
+  Timer _timer;
+  Timer _idle_timer;
+  uint32_t _window;
+  uint32_t _mask;
+  Timestamp _timeout;
+  Timestamp _idle_timeout;
+
+  Packet *_ready_head;		// packets to emit, in order
+  Packet *_ready_tail;
+  bool _draining;
+
+  uint32_t _held;
+  uint32_t _late;
+  uint32_t _skipped;
+
+  inline void ready(Packet *);
+  void insert(SAState *, uint32_t seq, Packet *);
+  void release(SAState *);
+  void advance(SAState *, uint32_t next);
+  void skip(SAState *);
+  void drain();
+  void expire(const Timestamp &now);
+
+  static String read_handler(Element *, void *) CLICK_COLD;
+  static int flush_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
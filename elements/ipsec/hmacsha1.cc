@@ -37,6 +37,7 @@ CLICK_DECLS
 #define KEY_SIZE 16
 
 IPsecAuthHMACSHA1::IPsecAuthHMACSHA1()
+  : _legacy(false)
 {
 }
 
@@ -47,7 +48,10 @@ IPsecAuthHMACSHA1::~IPsecAuthHMACSHA1()
 int
 IPsecAuthHMACSHA1::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh).read_mp("VERIFY", _op).complete();
+    return Args(conf, this, errh)
+	.read_mp("VERIFY", _op)
+	.read("LEGACY", _legacy)
+	.complete();
 }
 
 int
@@ -68,7 +72,11 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
 
   if (_op == COMPUTE_AUTH) {
     unsigned char digest [SHA_DIGEST_LEN];
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length(),digest,&len);
+    if (_legacy)
+      HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length(),digest,&len);
+    else
+      /* The SA caches the hashed key pads, so only the payload is hashed */
+      sa_data->hmac_sha1.compute(p->data(), p->length(), digest, 12);
     WritablePacket *q = p->put(12);
     u_char *ah = ((u_char*)q->data())+q->length()-12;
     memmove(ah, digest, 12);
@@ -76,10 +84,15 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
   }
   else {
     const u_char *ah = p->data()+p->length()-12;
-    unsigned char digest [SHA_DIGEST_LEN];
+    bool ok;
 
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
-    if (memcmp(ah, digest, 12)) {
+    if (_legacy) {
+      unsigned char digest [SHA_DIGEST_LEN];
+      HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
+      ok = !memcmp(ah, digest, 12);
+    } else
+      ok = sa_data->hmac_sha1.verify(p->data(), p->length()-12, ah, 12);
+    if (!ok) {
       if (_drops == 0)
 	click_chatter("Invalid SHA1 authentication digest");
       _drops++;
@@ -7,16 +7,37 @@ CLICK_DECLS
 
 /*
  * =c
- * IPsecAuthHMACSHA1(VERIFY)
+ * IPsecAuthHMACSHA1(VERIFY [, LEGACY])
  * =s ipsec
  * verify SHA1 authentication digest.
  * =d
  *
  * If first argument is 0, computes SHA1 authentication digest for ESP packet
  * per RFC 2404, 2406. If first argument is 1, verify SHA1 digest and remove
- * authentication bits.
+ * authentication bits. Packets that fail verification are sent to output 1,
+ * if present, and otherwise dropped.
  *
- * =a IPsecESPEncap, IPsecDES
+ * The key is taken from the SADataTuple annotation, which holds the SHA1
+ * state after the HMAC inner and outer key pads, so each packet hashes only
+ * its own bytes. Where available, the SHA-NI instructions are used.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item LEGACY
+ *
+ * Boolean. If true, hash the key pads for every packet and use the original
+ * portable implementation. Produces identical output; useful only for
+ * benchmarking. Default is false.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =a IPsecESPEncap, IPsecDES, IPsecAES, IPsecAuthHMACSHA256
  */
 
 class IPsecAuthHMACSHA1 : public Element {
@@ -39,6 +60,7 @@ public:
 private:
 
   int _op;
+  bool _legacy;
   atomic_uint32_t _drops;
 
   enum { COMPUTE_AUTH = 0, VERIFY_AUTH = 1 };
@@ -0,0 +1,83 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hmacsha256.{cc,hh} -- IPsec HMAC-SHA-256-128 authentication
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "hmacsha256.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+IPsecAuthHMACSHA256::IPsecAuthHMACSHA256()
+{
+}
+
+IPsecAuthHMACSHA256::~IPsecAuthHMACSHA256()
+{
+}
+
+int
+IPsecAuthHMACSHA256::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh).read_mp("VERIFY", _op).complete();
+}
+
+int
+IPsecAuthHMACSHA256::initialize(ErrorHandler *)
+{
+    _drops = 0;
+    return 0;
+}
+
+Packet *
+IPsecAuthHMACSHA256::simple_action(Packet *p)
+{
+    SADataTuple *sa_data = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p);
+
+    if (_op == COMPUTE_AUTH) {
+	unsigned char digest[ICV_LENGTH];
+	sa_data->hmac_sha256.compute(p->data(), p->length(), digest, ICV_LENGTH);
+	WritablePacket *q = p->put(ICV_LENGTH);
+	if (q)
+	    memcpy(q->end_data() - ICV_LENGTH, digest, ICV_LENGTH);
+	return q;
+    }
+
+    if (p->length() < ICV_LENGTH
+	|| !sa_data->hmac_sha256.verify(p->data(), p->length() - ICV_LENGTH,
+					p->end_data() - ICV_LENGTH, ICV_LENGTH)) {
+	if (_drops == 0)
+	    click_chatter("Invalid SHA-256 authentication digest");
+	_drops++;
+	checked_output_push(1, p);
+	return 0;
+    }
+    p->take(ICV_LENGTH);
+    return p;
+}
+
+void
+IPsecAuthHMACSHA256::add_handlers()
+{
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPsecAuthHMACSHA256)
+ELEMENT_MT_SAFE(IPsecAuthHMACSHA256)
@@ -0,0 +1,57 @@
+#ifndef CLICK_IPSECAUTHHMACSHA256_HH
+#define CLICK_IPSECAUTHHMACSHA256_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecAuthHMACSHA256(VERIFY)
+ * =s ipsec
+ * verify SHA-256 authentication digest.
+ * =d
+ *
+ * If first argument is 0, computes the HMAC-SHA-256-128 authentication
+ * digest for an ESP packet per RFC 4868 and appends it. If first argument is
+ * 1, verifies the digest and removes the authentication bits. Packets that
+ * fail verification are sent to output 1, if present, and otherwise dropped.
+ *
+ * The digest is 16 bytes long, so configure IPsecAES with IGNORE 16 when
+ * combining the two. The key is taken from the SADataTuple annotation, which
+ * holds the SHA-256 state after the HMAC key pads. Where available, the
+ * SHA-NI instructions are used.
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =a IPsecAuthHMACSHA1, IPsecESPEncap, IPsecAES
+ */
+
+class IPsecAuthHMACSHA256 : public Element {
+
+public:
+  IPsecAuthHMACSHA256();
+  ~IPsecAuthHMACSHA256();
+
+  const char *class_name() const	{ return "IPsecAuthHMACSHA256"; }
+  const char *port_count() const	{ return PORTS_1_1X2; }
+  const char *processing() const	{ return PROCESSING_A_AH; }
+
+  int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  int initialize(ErrorHandler *) CLICK_COLD;
+
+  Packet *simple_action(Packet *);
+  void add_handlers() CLICK_COLD;
+
+private:
+
+  int _op;
+  atomic_uint32_t _drops;
+
+  enum { COMPUTE_AUTH = 0, VERIFY_AUTH = 1, ICV_LENGTH = 16 };
+};
+
+CLICK_ENDDECLS
+#endif
@@ -5,6 +5,8 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include <click/aes128.hh>
+#include <click/hmacsha.hh>
 CLICK_DECLS
 
 /*
@@ -74,28 +76,52 @@ class SADataTuple {
     //SA Data must be added here...
     uint8_t Encryption_key[KEY_SIZE]; // The Data key
     uint8_t Authentication_key[KEY_SIZE];//The Authentication key
-    /*These fields below deal with replay protection*/
+    /*These fields below deal with replay protection. Several threads may
+      process packets of the same SA, so cur_rpl, lastseq and replay_slot
+      are only updated with compare-and-swap*/
     uint32_t replay_start_counter;
     uint32_t cur_rpl;
     uint8_t  ooowin;	/* out-of-order window size */
-    uint32_t bitmap;	/* Support out-of-order receive support */
     uint32_t lastseq;	/* in host order */
+    /*Out-of-order receive bitmap. Slot (seq / 8) % REPLAY_SLOTS covers 8
+      sequence numbers; its top 24 bits hold seq / (8 * REPLAY_SLOTS), and its
+      low 8 bits mark which of the 8 have been seen*/
+    enum { REPLAY_SLOTS = 64, REPLAY_WINDOW = (REPLAY_SLOTS - 1) * 8 };
+    uint32_t replay_slot[REPLAY_SLOTS];
+    /*Key schedules derived from Encryption_key, expanded once per SA
+      rather than once per packet*/
+    AES128 aes_schedule;
+    AES128GCM gcm_context;
+    uint32_t gcm_iv_lo;	/* next explicit IV for AES-GCM ESP, as two */
+    uint32_t gcm_iv_hi;	/* words so it can be allocated atomically */
+    /*HMAC inner and outer pad states derived from Authentication_key*/
+    HMACSHA1 hmac_sha1;
+    HMACSHA256 hmac_sha256;
 
     SADataTuple() {
-	memset(this, 0, sizeof(*this));
+	memset(static_cast<void *>(this), 0, sizeof(*this));
+	set_keys();
     }
 
     SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
      {
-		memset(this, 0, sizeof(*this));
+		memset(static_cast<void *>(this), 0, sizeof(*this));
 		memcpy(Encryption_key, enc_key, KEY_SIZE);
 		memcpy(Authentication_key, Auth_key, KEY_SIZE);
 		replay_start_counter = counter;
 		ooowin = o_oowin;
-	        bitmap=0;
 		lastseq=cur_rpl=counter;
+		set_keys();
      }
 
+    void set_keys()
+    {
+	aes_schedule.set_key(Encryption_key);
+	gcm_context.set_key(Encryption_key);
+	hmac_sha1.set_key(Authentication_key, KEY_SIZE);
+	hmac_sha256.set_key(Authentication_key, KEY_SIZE);
+    }
+
      operator bool() const
      {
          return ((cur_rpl != 0));
@@ -31,8 +31,8 @@ AverageCounter::AverageCounter()
 void
 AverageCounter::reset()
 {
-  _count = 0;
-  _byte_count = 0;
+  for (int i = 0; i < _stats.size(); ++i)
+    _stats[i] = stats();
   _first = 0;
   _last = 0;
 }
@@ -47,9 +47,28 @@ AverageCounter::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+uint32_t
+AverageCounter::count() const
+{
+  uint32_t x = 0;
+  for (int i = 0; i < _stats.size(); ++i)
+    x += _stats[i].count;
+  return x;
+}
+
+uint32_t
+AverageCounter::byte_count() const
+{
+  uint32_t x = 0;
+  for (int i = 0; i < _stats.size(); ++i)
+    x += _stats[i].byte_count;
+  return x;
+}
+
 int
 AverageCounter::initialize(ErrorHandler *)
 {
+  _stats.initialize(this);
   reset();
   return 0;
 }
@@ -58,12 +77,17 @@ Packet *
 AverageCounter::simple_action(Packet *p)
 {
     uint32_t jpart = click_jiffies();
-    _first.compare_swap(0, jpart);
+    // write the shared timestamps only when they change, so their cache
+    // line is not dirtied by every packet
+    if (!_first)
+	_first.compare_swap(0, jpart);
     if (jpart - _first >= _ignore) {
-	_count++;
-	_byte_count += p->length();
+	stats &s = _stats.local();
+	s.count++;
+	s.byte_count += p->length();
     }
-    _last = jpart;
+    if (_last != jpart)
+	_last = jpart;
     return p;
 }
 
@@ -106,10 +130,10 @@ averagecounter_reset_write_handler
 void
 AverageCounter::add_handlers()
 {
-  add_read_handler("count", averagecounter_read_count_handler, 0);
-  add_read_handler("byte_count", averagecounter_read_count_handler, 1);
-  add_read_handler("rate", averagecounter_read_rate_handler, 0);
-  add_read_handler("byte_rate", averagecounter_read_rate_handler, 1);
+  add_read_handler("count", averagecounter_read_count_handler, 0, Handler::NONEXCLUSIVE);
+  add_read_handler("byte_count", averagecounter_read_count_handler, 1, Handler::NONEXCLUSIVE);
+  add_read_handler("rate", averagecounter_read_rate_handler, 0, Handler::NONEXCLUSIVE);
+  add_read_handler("byte_rate", averagecounter_read_rate_handler, 1, Handler::NONEXCLUSIVE);
   add_write_handler("reset", averagecounter_reset_write_handler, 0, Handler::BUTTON);
 }
 
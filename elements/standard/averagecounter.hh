@@ -4,6 +4,7 @@
 #include <click/ewma.hh>
 #include <click/atomic.hh>
 #include <click/timer.hh>
+#include <click/sharded.hh>
 CLICK_DECLS
 
 /*
@@ -38,6 +39,10 @@ CLICK_DECLS
  *
  * =h reset write-only
  * Resets the count and rate to zero.
+ *
+ * =n
+ * Threads sharing an AverageCounter count separately; the handlers add up
+ * their counts.
  */
 
 class AverageCounter : public Element { public:
@@ -48,8 +53,8 @@ class AverageCounter : public Element { public:
     const char *port_count() const		{ return PORTS_1_1; }
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
-    uint32_t count() const			{ return _count; }
-    uint32_t byte_count() const			{ return _byte_count; }
+    uint32_t count() const;
+    uint32_t byte_count() const;
     uint32_t first() const			{ return _first; }
     uint32_t last() const			{ return _last; }
     uint32_t ignore() const			{ return _ignore; }
@@ -62,8 +67,15 @@ class AverageCounter : public Element { public:
 
   private:
 
-    atomic_uint32_t _count;
-    atomic_uint32_t _byte_count;
+    struct stats {
+	uint32_t count;
+	uint32_t byte_count;
+	stats()
+	    : count(0), byte_count(0) {
+	}
+    };
+
+    Sharded<stats> _stats;
     atomic_uint32_t _first;
     atomic_uint32_t _last;
     atomic_uint32_t _first_count;
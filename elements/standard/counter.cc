@@ -38,8 +38,55 @@ Counter::~Counter()
 void
 Counter::reset()
 {
-  _count = _byte_count = 0;
-  _count_triggered = _byte_triggered = false;
+  for (int i = 0; i < _stats.size(); ++i)
+    _stats[i].count = _stats[i].byte_count = 0;
+  _count_triggered = _byte_triggered = 0;
+}
+
+Counter::counter_t
+Counter::count() const
+{
+  counter_t x = 0;
+  for (int i = 0; i < _stats.size(); ++i)
+    x += _stats[i].count;
+  return x;
+}
+
+Counter::counter_t
+Counter::byte_count() const
+{
+  counter_t x = 0;
+  for (int i = 0; i < _stats.size(); ++i)
+    x += _stats[i].byte_count;
+  return x;
+}
+
+// The per-thread rates share a scale, so their scaled averages add up.
+// update(0) on a copy drops the rate of threads that have gone idle without
+// writing to state the owning thread is updating.
+
+Counter::rate_t::signed_value_type
+Counter::scaled_rate()
+{
+  rate_t::signed_value_type x = 0;
+  for (int i = 0; i < _stats.size(); ++i) {
+    rate_t r = _stats[i].rate;
+    r.update(0);
+    x += r.scaled_average() * r.epoch_frequency();
+  }
+  return x;
+}
+
+Counter::byte_rate_t::signed_value_type
+Counter::scaled_byte_rate()
+{
+  byte_rate_t::signed_value_type x = 0;
+  for (int i = 0; i < _stats.size(); ++i) {
+    byte_rate_t r = _stats[i].byte_rate;
+    r.update(0);
+    x += r.scaled_average() * r.epoch_frequency();
+  }
+  return x;
 }
 
 int
@@ -81,6 +128,7 @@ Counter::initialize(ErrorHandler *errh)
     return -1;
   if (_byte_trigger_h && _byte_trigger_h->initialize_write(this, errh) < 0)
     return -1;
+  _stats.initialize(this);
   reset();
   return 0;
 }
@@ -88,21 +136,20 @@ Counter::initialize(ErrorHandler *errh)
 Packet *
 Counter::simple_action(Packet *p)
 {
-    _count++;
-    _byte_count += p->length();
-    _rate.update(1);
-    _byte_rate.update(p->length());
-
-  if (_count == _count_trigger && !_count_triggered) {
-    _count_triggered = true;
-    if (_count_trigger_h)
-      (void) _count_trigger_h->call_write();
-  }
-  if (_byte_count >= _byte_trigger && !_byte_triggered) {
-    _byte_triggered = true;
-    if (_byte_trigger_h)
-      (void) _byte_trigger_h->call_write();
-  }
+    stats &s = _stats.local();
+    s.count++;
+    s.byte_count += p->length();
+    s.rate.update(1);
+    s.byte_rate.update(p->length());
+
+  // Other threads' increments can skip past the trigger, so test with >=;
+  // the compare-and-swap makes sure only one thread makes the call.
+  if (_count_trigger_h && !_count_triggered && count() >= _count_trigger
+      && _count_triggered.compare_swap(0, 1) == 0)
+    (void) _count_trigger_h->call_write();
+  if (_byte_trigger_h && !_byte_triggered && byte_count() >= _byte_trigger
+      && _byte_triggered.compare_swap(0, 1) == 0)
+    (void) _byte_trigger_h->call_write();
 
   return p;
 }
@@ -117,23 +164,22 @@ Counter::read_handler(Element *e, void *thunk)
     Counter *c = (Counter *)e;
     switch ((intptr_t)thunk) {
       case H_COUNT:
-	return String(c->_count);
+	return String(c->count());
       case H_BYTE_COUNT:
-	return String(c->_byte_count);
+	return String(c->byte_count());
       case H_RATE:
-	c->_rate.update(0);	// drop rate after idle period
-	return c->_rate.unparse_rate();
-      case H_BIT_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
+	return cp_unparse_real2(c->scaled_rate(), c->_stats[0].rate.scale());
+      case H_BIT_RATE: {
+	unsigned scale = c->_stats[0].byte_rate.scale();
 	// avoid integer overflow by adjusting scale factor instead of
 	// multiplying
-	if (c->_byte_rate.scale() >= 3)
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency(), c->_byte_rate.scale() - 3);
+	if (scale >= 3)
+	    return cp_unparse_real2(c->scaled_byte_rate(), scale - 3);
 	else
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency() * 8, c->_byte_rate.scale());
+	    return cp_unparse_real2(c->scaled_byte_rate() * 8, scale);
+      }
       case H_BYTE_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
-	return c->_byte_rate.unparse_rate();
+	return cp_unparse_real2(c->scaled_byte_rate(), c->_stats[0].byte_rate.scale());
       case H_COUNT_CALL:
 	if (c->_count_trigger_h)
 	    return String(c->_count_trigger);
@@ -155,14 +201,14 @@ Counter::write_handler(const String &in_str, Element *e, void *thunk, ErrorHandl
 	    return errh->error("'count_call' first word should be unsigned (count)");
 	if (HandlerCall::reset_write(c->_count_trigger_h, str, c, errh) < 0)
 	    return -1;
-	c->_count_triggered = false;
+	c->_count_triggered = 0;
 	return 0;
       case H_BYTE_COUNT_CALL:
 	  if (!IntArg().parse(cp_shift_spacevec(str), c->_byte_trigger))
 	    return errh->error("'byte_count_call' first word should be unsigned (count)");
 	if (HandlerCall::reset_write(c->_byte_trigger_h, str, c, errh) < 0)
 	    return -1;
-	c->_byte_triggered = false;
+	c->_byte_triggered = 0;
 	return 0;
       case H_RESET:
 	c->reset();
@@ -175,11 +221,11 @@ Counter::write_handler(const String &in_str, Element *e, void *thunk, ErrorHandl
 void
 Counter::add_handlers()
 {
-    add_read_handler("count", read_handler, H_COUNT);
-    add_read_handler("byte_count", read_handler, H_BYTE_COUNT);
-    add_read_handler("rate", read_handler, H_RATE);
-    add_read_handler("bit_rate", read_handler, H_BIT_RATE);
-    add_read_handler("byte_rate", read_handler, H_BYTE_RATE);
+    add_read_handler("count", read_handler, H_COUNT, Handler::NONEXCLUSIVE);
+    add_read_handler("byte_count", read_handler, H_BYTE_COUNT, Handler::NONEXCLUSIVE);
+    add_read_handler("rate", read_handler, H_RATE, Handler::NONEXCLUSIVE);
+    add_read_handler("bit_rate", read_handler, H_BIT_RATE, Handler::NONEXCLUSIVE);
+    add_read_handler("byte_rate", read_handler, H_BYTE_RATE, Handler::NONEXCLUSIVE);
     add_write_handler("reset", write_handler, H_RESET, Handler::BUTTON);
     add_write_handler("reset_counts", write_handler, H_RESET, Handler::BUTTON | Handler::UNCOMMON);
     add_read_handler("count_call", read_handler, H_COUNT_CALL);
@@ -194,15 +240,14 @@ Counter::llrpc(unsigned command, void *data)
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0)
       return -EINVAL;
-    _rate.update(0);		// drop rate after idle period
-    *val = _rate.rate();
+    *val = scaled_rate() >> _stats[0].rate.scale();
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNT) {
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0 && *val != 1)
       return -EINVAL;
-    *val = (*val == 0 ? _count : _byte_count);
+    *val = (*val == 0 ? count() : byte_count());
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNTS) {
@@ -213,9 +258,9 @@ Counter::llrpc(unsigned command, void *data)
       return -EINVAL;
     for (unsigned i = 0; i < cs.n; i++) {
       if (cs.keys[i] == 0)
-	cs.values[i] = _count;
+	cs.values[i] = count();
       else if (cs.keys[i] == 1)
-	cs.values[i] = _byte_count;
+	cs.values[i] = byte_count();
       else
 	return -EINVAL;
     }
@@ -227,3 +272,4 @@ Counter::llrpc(unsigned command, void *data)
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Counter)
+ELEMENT_MT_SAFE(Counter)
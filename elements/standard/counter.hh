@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/ewma.hh>
 #include <click/llrpc.h>
+#include <click/sharded.hh>
 CLICK_DECLS
 class HandlerCall;
 
@@ -27,8 +28,8 @@ Keyword arguments are:
 
 =item COUNT_CALL
 
-Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the packet count reaches I<N>,
-call the write handler I<HANDLER> with value I<VALUE> before emitting the
+Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the packet count reaches or
+exceeds I<N>, call the write handler I<HANDLER> with value I<VALUE> before emitting the
 packet.
 
 =item BYTE_COUNT_CALL
@@ -96,6 +97,14 @@ Argument is a pointer to a click_llrpc_counts_st structure (see
 count). Stores the corresponding counts in the corresponding C<values>
 components.
 
+=n
+
+Counter is safe to use from several threads at once. Each thread keeps its
+own counts and rates, in its own cache line, and the handlers report their
+sums, so threads sharing a Counter do not slow each other down. With
+COUNT_CALL or BYTE_COUNT_CALL, though, every packet sums the counts of all
+threads to check the trigger.
+
 */
 
 class Counter : public Element { public:
@@ -105,6 +114,7 @@ class Counter : public Element { public:
 
     const char *class_name() const		{ return "Counter"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    bool can_keep_across_hotswap() const	{ return true; }
 
     void reset();
 
@@ -128,10 +138,18 @@ class Counter : public Element { public:
     typedef RateEWMAX<RateEWMAXParameters<4, 4> > byte_rate_t;
 #endif
 
-    counter_t _count;
-    counter_t _byte_count;
-    rate_t _rate;
-    byte_rate_t _byte_rate;
+    // each thread counts into its own copy; handlers sum the copies
+    struct stats {
+	counter_t count;
+	counter_t byte_count;
+	rate_t rate;
+	byte_rate_t byte_rate;
+	stats()
+	    : count(0), byte_count(0) {
+	}
+    };
+
+    Sharded<stats> _stats;
 
     counter_t _count_trigger;
     HandlerCall *_count_trigger_h;
@@ -139,8 +157,13 @@ class Counter : public Element { public:
     counter_t _byte_trigger;
     HandlerCall *_byte_trigger_h;
 
-    bool _count_triggered : 1;
-    bool _byte_triggered : 1;
+    atomic_uint32_t _count_triggered;
+    atomic_uint32_t _byte_triggered;
+
+    counter_t count() const;
+    counter_t byte_count() const;
+    rate_t::signed_value_type scaled_rate() CLICK_COLD;
+    byte_rate_t::signed_value_type scaled_byte_rate() CLICK_COLD;
 
     static String read_handler(Element *, void *) CLICK_COLD;
     static int write_handler(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
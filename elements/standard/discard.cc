@@ -71,6 +71,7 @@ Discard::run_task(Task *)
     unsigned sent = _burst - x;
 
     _count += sent;
+    _task.add_work(sent);
     if (_active && (sent || _signal))
 	_task.fast_reschedule();
     return sent != 0;
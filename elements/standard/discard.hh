@@ -57,6 +57,7 @@ class Discard : public Element { public:
 
     const char *class_name() const		{ return "Discard"; }
     const char *port_count() const		{ return PORTS_1_0; }
+    bool can_keep_across_hotswap() const	{ return true; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
     int initialize(ErrorHandler *errh) CLICK_COLD;
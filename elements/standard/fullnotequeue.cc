@@ -21,6 +21,7 @@
 CLICK_DECLS
 
 FullNoteQueue::FullNoteQueue()
+    : _push_node(-1)
 {
 }
 
@@ -43,6 +44,13 @@ FullNoteQueue::configure(Vector<String> &conf, ErrorHandler *errh)
     return NotifierQueue::configure(conf, errh);
 }
 
+int
+FullNoteQueue::initialize(ErrorHandler *errh)
+{
+    _cross_node_handoffs.initialize(this);
+    return NotifierQueue::initialize(errh);
+}
+
 int
 FullNoteQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -76,22 +84,29 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
-#if CLICK_DEBUG_SCHEDULING
 String
-FullNoteQueue::read_handler(Element *e, void *)
+FullNoteQueue::read_handler(Element *e, void *thunk)
 {
     FullNoteQueue *fq = static_cast<FullNoteQueue *>(e);
+    if (thunk)
+	return String(fq->_cross_node_handoffs.value());
+#if CLICK_DEBUG_SCHEDULING
     return "nonempty " + fq->_empty_note.unparse(fq->router())
 	+ "\nnonfull " + fq->_full_note.unparse(fq->router());
+#else
+    return String();
+#endif
 }
 
 void
 FullNoteQueue::add_handlers()
 {
     NotifierQueue::add_handlers();
+#if CLICK_DEBUG_SCHEDULING
     add_read_handler("notifier_state", read_handler, 0);
-}
 #endif
+    add_read_handler("cross_node_handoffs", read_handler, 1, Handler::h_nonexclusive);
+}
 
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(NotifierQueue)
@@ -62,6 +62,15 @@ When written, resets the C<drops> and C<highwater_length> counters.
 
 When written, drops all packets in the queue.
 
+=h cross_node_handoffs read-only
+
+Returns the number of packets pulled on a different NUMA node from the one
+they were most recently pushed on.  Only threads bound to CPUs (see
+StaticThreadSched and B<click>'s B<--affinity> option) have a known node; the
+count is approximate when several threads push at once, and is always 0 in
+drivers without thread-local storage.  A high count suggests that the
+elements on either side of the queue should run on the same node.
+
 =a ThreadSafeQueue, QuickNoteQueue, SimpleQueue, NotifierQueue, MixedQueue,
 FrontDropQueue */
 
@@ -73,10 +82,9 @@ class FullNoteQueue : public NotifierQueue { public:
     void *cast(const char *);
 
     int configure(Vector<String> &conf, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
     int live_reconfigure(Vector<String> &conf, ErrorHandler *errh);
-#if CLICK_DEBUG_SCHEDULING
     void add_handlers() CLICK_COLD;
-#endif
 
     void push(int port, Packet *p);
     Packet *pull(int port);
@@ -84,6 +92,8 @@ class FullNoteQueue : public NotifierQueue { public:
   protected:
 
     ActiveNotifier _full_note;
+    int _push_node;
+    ShardedCounter<uint32_t> _cross_node_handoffs;
 
     inline void push_success(Storage::index_type h, Storage::index_type t,
 			     Storage::index_type nt, Packet *p);
@@ -91,10 +101,9 @@ class FullNoteQueue : public NotifierQueue { public:
     inline Packet *pull_success(Storage::index_type h,
 				Storage::index_type nh);
     inline Packet *pull_failure();
+    inline void note_pull_node();
 
-#if CLICK_DEBUG_SCHEDULING
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
-#endif
 
 };
 
@@ -105,6 +114,10 @@ FullNoteQueue::push_success(Storage::index_type h, Storage::index_type t,
     _q[t] = p;
     packet_memory_barrier(_q[t], _tail);
     _tail = nt;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    if (_push_node != click_current_numa_node)
+	_push_node = click_current_numa_node;
+#endif
 
     int s = size(h, nt);
     if (s > _highwater_length)
@@ -127,12 +140,22 @@ FullNoteQueue::push_success(Storage::index_type h, Storage::index_type t,
 inline void
 FullNoteQueue::push_failure(Packet *p)
 {
-    if (_drops == 0 && _capacity > 0)
+    if (_drops.local_value() == 0 && _capacity > 0)
 	click_chatter("%p{element}: overflow", this);
     _drops++;
     checked_output_push(1, p);
 }
 
+inline void
+FullNoteQueue::note_pull_node()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    if (click_current_numa_node != _push_node
+	&& click_current_numa_node >= 0 && _push_node >= 0)
+	++_cross_node_handoffs;
+#endif
+}
+
 inline Packet *
 FullNoteQueue::pull_success(Storage::index_type h,
 			    Storage::index_type nh)
@@ -140,6 +163,7 @@ FullNoteQueue::pull_success(Storage::index_type h,
     Packet *p = _q[h];
     packet_memory_barrier(_q[h], _head);
     _head = nh;
+    note_pull_node();
 
     _sleepiness = 0;
     _full_note.wake();
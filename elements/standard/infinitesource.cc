@@ -128,6 +128,7 @@ InfiniteSource::run_task(Task *)
 	output(0).push(p);
     }
     _count += n;
+    _task.add_work(n);
     if (n > 0)
 	_task.fast_reschedule();
     else if (_end_h && _limit >= 0 && _count >= (ucounter_t) _limit)
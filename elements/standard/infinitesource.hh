@@ -112,6 +112,7 @@ class InfiniteSource : public Element, public ActiveNotifier { public:
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
   int initialize(ErrorHandler *) CLICK_COLD;
   bool can_live_reconfigure() const		{ return true; }
+  bool can_keep_across_hotswap() const	{ return true; }
   void cleanup(CleanupStage) CLICK_COLD;
 
   bool run_task(Task *);
@@ -34,6 +34,7 @@ class Paint : public Element { public:
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     bool can_live_reconfigure() const		{ return true; }
+    bool can_keep_across_hotswap() const	{ return true; }
     void add_handlers() CLICK_COLD;
 
     Packet *simple_action(Packet *);
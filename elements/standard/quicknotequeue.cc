@@ -43,6 +43,7 @@ QuickNoteQueue::pull(int)
 	p = _q[h];
 	packet_memory_barrier(_q[h], _head);
 	_head = h = next_i(h);
+	note_pull_node();
 	_full_note.wake();
     } else
 	p = 0;
@@ -93,6 +93,7 @@ class RatedSource : public Element { public:
 
     const char *class_name() const		{ return "RatedSource"; }
     const char *port_count() const		{ return PORTS_0_1; }
+    bool can_keep_across_hotswap() const	{ return true; }
     void add_handlers() CLICK_COLD;
 
     int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
@@ -114,6 +114,38 @@ Script::static_cleanup()
 #endif
 }
 
+/* Reports errors as ContextErrorHandler(errh, "While calling %<%s%>:",
+   hc.unparse().c_str()) or ContextErrorHandler(errh, "While executing
+   %<%p{element}%>:", script) would, but formats the context only if an error
+   is reported.  Most calls succeed, and for them formatting the context costs
+   more than the call itself. */
+class Script::CallErrorHandler : public ContextErrorHandler { public:
+    CallErrorHandler(ErrorHandler *errh, const HandlerCall &hc)
+	: ContextErrorHandler(errh, ""), _hc(&hc), _script(0),
+	  _have_context(false) {
+    }
+    CallErrorHandler(ErrorHandler *errh, Script *script)
+	: ContextErrorHandler(errh, ""), _hc(0), _script(script),
+	  _have_context(false) {
+    }
+    String decorate(const String &str) {
+	if (!_have_context) {
+	    String context;
+	    if (_hc)
+		context = format("While calling %<%s%>:", _hc->unparse().c_str());
+	    else
+		context = format("While executing %<%p{element}%>:", _script);
+	    set_context(combine_anno(context, String::make_stable("{context:context}", 17)));
+	    _have_context = true;
+	}
+	return ContextErrorHandler::decorate(str);
+    }
+  private:
+    const HandlerCall *_hc;
+    Script *_script;
+    bool _have_context;
+};
+
 Script::Script()
     : _type(type_active), _write_status(0), _timer(this), _cur_steps(0)
 {
@@ -163,6 +195,241 @@ Script::find_variable(const String &name, bool add)
     return i;
 }
 
+Script::Expr
+Script::compile(const String &text, int depth)
+{
+    // Scan the text as cp_expand() does, but record the references instead
+    // of expanding them.
+    Expr x;
+    x.source = text;
+    x.depth = depth;
+    const char *s = text.begin(), *end = text.end();
+    const char *uninterpolated = s;
+    int quote = 0;
+
+    if (find(text, '$') != end)
+	for (; s < end; s++)
+	    switch (*s) {
+
+	    case '\\':
+		if (s + 1 < end && quote == '\"')
+		    s++;
+		break;
+
+	    case '\'':
+	    case '\"':
+		if (quote == 0)
+		    quote = *s;
+		else if (quote == *s)
+		    quote = 0;
+		break;
+
+	    case '/':
+		if (s + 1 < end && (s[1] == '/' || s[1] == '*') && quote == 0)
+		    s = cp_skip_comment_space(s, end) - 1;
+		break;
+
+	    case '$': {
+		if (s + 1 >= end || quote == '\'' || depth > 10)
+		    break;
+
+		const char *beforedollar = s, *cstart;
+		Ref r;
+		bool expand_name = false;
+
+		if (s[1] == '{') {
+		    r.type = '{';
+		    s += 2;
+		    for (cstart = s; s < end && *s != '}'; s++)
+			if (*s == '$')
+			    expand_name = true;
+		    if (s == end)
+			goto done;
+		    r.name = text.substring(cstart, s++);
+
+		} else if (s[1] == '(') {
+		    int level = 1, nquote = 0;
+		    r.type = '(';
+		    s += 2;
+		    for (cstart = s; s < end && level; s++)
+			switch (*s) {
+			case '(':
+			    if (nquote == 0)
+				level++;
+			    break;
+			case ')':
+			    if (nquote == 0)
+				level--;
+			    break;
+			case '\"':
+			case '\'':
+			    if (nquote == 0)
+				nquote = *s;
+			    else if (nquote == *s)
+				nquote = 0;
+			    break;
+			case '\\':
+			    if (s + 1 < end && nquote != '\'')
+				s++;
+			    break;
+			case '$':
+			    if (nquote != '\'')
+				expand_name = true;
+			    break;
+			}
+		    if (s == cstart || s[-1] != ')')
+			goto done;
+		    r.name = text.substring(cstart, s - 1);
+
+		} else if (isalnum((unsigned char) s[1]) || s[1] == '_') {
+		    r.type = 'a';
+		    s++;
+		    for (cstart = s; s < end && (isalnum((unsigned char) *s) || *s == '_'); s++)
+			/* nada */;
+		    r.name = text.substring(cstart, s);
+
+		} else if (s[1] == '?' || s[1] == '#' || s[1] == '$') {
+		    r.type = 'a';
+		    s++;
+		    r.name = text.substring(s, s + 1);
+		    s++;
+
+		} else
+		    break;
+
+		r.prefix = text.substring(uninterpolated, beforedollar);
+		r.source = text.substring(beforedollar, s);
+		r.name_expr = -1;
+		if (expand_name) {
+		    Expr nx = compile(r.name, depth + 1);
+		    r.name_expr = _exprs.size();
+		    _exprs.push_back(nx);
+		}
+		r.slot = -1;
+		r.quote = quote;
+		x.refs.push_back(r);
+		uninterpolated = s;
+		s--;
+		break;
+	    }
+	    }
+
+  done:
+    x.tail = text.substring(uninterpolated, end);
+    return x;
+}
+
+// Remove a print redirection, "> FILE" or ">> FILE", from the front of
+// 'text'; return the filename.
+static String
+shift_print_redirection(String &text, bool *append)
+{
+    *append = (text.length() > 1 && text[1] == '>');
+    text = text.substring(1 + *append);
+    return cp_shift_spacevec(text);
+}
+
+void
+Script::compile_insns()
+{
+    _exprs.clear();
+    _exprs.resize(_insns.size());
+    _times.assign(_insns.size(), Timestamp());
+    for (int i = 0; i < _insns.size(); i++) {
+	String text = _args3[i];
+	int insn = _insns[i];
+	if ((insn == INSN_PRINT || insn == INSN_PRINTQ || insn == INSN_PRINTN
+	     || insn == INSN_PRINTNQ)
+	    && text.length() && text[0] == '>') {
+	    bool append;
+	    (void) shift_print_redirection(text, &append);
+	}
+	Expr x = compile(text, 0);
+	_exprs[i] = x;
+	if (insn == INSN_WAIT_TIME && !x.refs.size()
+	    && cp_time(text, &_times[i]))
+	    _args[i] = 1;
+    }
+}
+
+String
+Script::expand(int expr, const Expander &expander, bool expand_quote)
+{
+    Expr &x = _exprs[expr];
+    if (!x.refs.size())
+	return x.source;
+
+    // Mirrors cp_expand(), down to returning the source unchanged if nothing
+    // but failed references and the tail would be output.
+    StringAccum sa;
+    const String *failed = 0;
+    for (Ref *r = x.refs.begin(); r != x.refs.end(); ++r) {
+	if (failed) {
+	    sa << *failed;
+	    failed = 0;
+	}
+	sa << r->prefix;
+
+	String name = (r->name_expr >= 0 ? expand(r->name_expr, expander) : r->name);
+	String text;
+	int result;
+	int v = (r->slot >= 0 ? r->slot : find_variable(name, false));
+	if (v < _vars.size()) {
+	    if (r->name_expr < 0)
+		r->slot = v;	// variables are never removed
+	    text = _vars[v + 1];
+	    result = true;
+	} else
+	    result = expander.expand_nonvariable(name, text, r->type);
+
+	if (!result) {
+	    if (r->name_expr >= 0)
+		sa << r->source[0] << r->source[1] << name << r->source.back();
+	    else
+		failed = &r->source;
+	} else if (r->quote == '\"' || (expand_quote && r->quote == 0)) {
+	    text = cp_quote(text);
+	    if (text[0] == '\"')
+		text = text.substring(text.begin() + 1, text.end() - 1);
+	    if (r->quote == '\"')
+		sa << text;
+	    else
+		sa << '\"' << text << '\"';
+	} else
+	    sa << text;
+    }
+
+    if (!sa.length())
+	return x.source;
+    if (failed)
+	sa << *failed;
+    sa << x.tail;
+    return sa.take_string();
+}
+
+int
+Script::initialize_call(HandlerCall &hc, const String &text, int flags, ErrorHandler *errh)
+{
+    // Scripts call the same few handlers over and over, so remember the
+    // element and handler each handler name found.
+    String value = text;
+    String hname = cp_shift_spacevec(value);
+    if (const HandlerCall *c = _calls.get_pointer(hname)) {
+	if (flags & HandlerCall::UNQUOTE_PARAM)
+	    value = cp_unquote(value);
+	return hc.assign(c->element(), c->handler(), value, flags, errh);
+    }
+
+    hc = HandlerCall(text);
+    int r = hc.initialize(flags, this, errh);
+    if (r >= 0 && hname) {
+	if (_calls.size() >= max_calls)
+	    _calls.clear();
+	_calls.set(hname, hc);
+    }
+    return r;
+}
+
 int
 Script::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -245,14 +512,20 @@ Script::configure(Vector<String> &conf, ErrorHandler *errh)
 	case INSN_PRINTQ:
 	case INSN_PRINTN:
 	case INSN_PRINTNQ:
-#if CLICK_USERLEVEL
-	case insn_save:
-	case insn_append:
-#endif
 	case INSN_GOTO:
 	    add_insn(insn, 0, 0, conf[i]);
 	    break;
 
+#if CLICK_USERLEVEL
+	case insn_save:
+	case insn_append: {
+	    String word = cp_shift_spacevec(conf[i]);
+	    String file = (conf[i] ? conf[i] : "-");
+	    add_insn(INSN_PRINT, 0, 0, (&">>"[insn == insn_save]) + file + " " + word);
+	    break;
+	}
+#endif
+
 	case INSN_RETURN:
 	case insn_returnq:
 	    conf[i] = "_ " + conf[i];
@@ -317,6 +590,7 @@ Script::configure(Vector<String> &conf, ErrorHandler *errh)
 	add_insn(INSN_WAIT_STEP, 1, 0);
     add_insn(_type == type_driver ? insn_stop : insn_end, 0);
 
+    compile_insns();
     return errh->nerrors() ? -1 : 0;
 }
 
@@ -332,9 +606,9 @@ Script::initialize(ErrorHandler *errh)
     expander.errh = errh;
     for (int i = 0; i < _insns.size(); i++)
 	if (_insns[i] == insn_init || _insns[i] == insn_export)
-	    _vars[_args[i] + 1] = cp_expand(_args3[i], expander);
+	    _vars[_args[i] + 1] = expand(i, expander);
 	else if (_insns[i] == insn_initq || _insns[i] == insn_exportq)
-	    _vars[_args[i] + 1] = cp_unquote(cp_expand(_args3[i], expander));
+	    _vars[_args[i] + 1] = cp_unquote(expand(i, expander));
 
     int insn = _insns[_insn_pos];
     assert(insn == INSN_INITIAL || insn == INSN_WAIT_STEP || INSN_WAIT_TIME);
@@ -342,8 +616,8 @@ Script::initialize(ErrorHandler *errh)
 	|| _type == type_proxy)
 	/* passive, do nothing */;
     else if (insn == INSN_WAIT_TIME) {
-	Timestamp ts;
-	if (cp_time(cp_expand(_args3[_insn_pos], expander), &ts))
+	Timestamp ts = _times[_insn_pos];
+	if (_args[_insn_pos] || cp_time(expand(_insn_pos, expander), &ts))
 	    _timer.schedule_after(ts);
 	else
 	    errh->error("syntax error at %<wait%>");
@@ -404,8 +678,8 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_WAIT_TIME:
 	    if (_step_count == nsteps) {
-		Timestamp ts;
-		if (cp_time(cp_expand(_args3[ipos], expander), &ts)) {
+		Timestamp ts = _times[ipos];
+		if (_args[ipos] || cp_time(expand(ipos, expander), &ts)) {
 		    _timer.schedule_after(ts);
 		    _insn_pos--;
 		} else
@@ -423,15 +697,6 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	    }
 	    break;
 
-#if CLICK_USERLEVEL
-	case insn_save:
-	case insn_append: {
-	    String word = cp_shift_spacevec(_args3[ipos]);
-	    String file = (_args3[ipos] ? _args3[ipos] : "-");
-	    _args3[ipos] = (&">>"[insn == insn_save]) + file + " " + word;
-	    /* FALLTHRU */
-	}
-#endif
 	case INSN_PRINT:
 	case INSN_PRINTQ:
 	case INSN_PRINTN:
@@ -441,9 +706,8 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 #if CLICK_USERLEVEL
 	    FILE *f = stdout;
 	    if (text.length() && text[0] == '>') {
-		bool append = (text.length() > 1 && text[1] == '>');
-		text = text.substring(1 + append);
-		String filename = cp_shift_spacevec(text);
+		bool append;
+		String filename = shift_print_redirection(text, &append);
 		if (filename && filename != "-"
 		    && !(f = fopen(filename.c_str(), append ? "ab" : "wb"))) {
 		    errh->error("%s: %s", filename.c_str(), strerror(errno));
@@ -453,21 +717,22 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 #else
 	    if (text.length() && text[0] == '>') {
 		errh->error("file redirection not supported here");
-		(void) cp_shift_spacevec(text);
+		bool append;
+		(void) shift_print_redirection(text, &append);
 	    }
 #endif
 
 	    int before = errh->nerrors();
 	    String result;
 	    if (text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_')) {
-		HandlerCall hc(cp_expand(text, expander));
+		HandlerCall hc;
 		int flags = HandlerCall::OP_READ + ((insn == INSN_PRINTQ || insn == INSN_PRINTNQ) ? HandlerCall::UNQUOTE_PARAM : 0);
-		if (hc.initialize(flags, this, errh) >= 0) {
-		    ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
+		if (initialize_call(hc, expand(ipos, expander), flags, errh) >= 0) {
+		    CallErrorHandler c_errh(errh, hc);
 		    result = hc.call_read(&c_errh);
 		}
 	    } else
-		result = cp_unquote(cp_expand(text, expander, true));
+		result = cp_unquote(expand(ipos, expander, true));
 	    if (errh->nerrors() == before
 		&& (!result || result.back() != '\n')
 		&& insn != INSN_PRINTN
@@ -488,10 +753,10 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_READ:
 	case INSN_READQ: {
-	    HandlerCall hc(cp_expand(_args3[ipos], expander));
+	    HandlerCall hc;
 	    int flags = HandlerCall::OP_READ + (insn == INSN_READQ ? HandlerCall::UNQUOTE_PARAM : 0);
-	    if (hc.initialize(flags, this, errh) >= 0) {
-		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
+	    if (initialize_call(hc, expand(ipos, expander), flags, errh) >= 0) {
+		CallErrorHandler c_errh(errh, hc);
 		String result = hc.call_read(&c_errh);
 		ErrorHandler *d_errh = ErrorHandler::default_handler();
 		d_errh->message("%s:\n%.*s\n", hc.handler()->unparse_name(hc.element()).c_str(), result.length(), result.data());
@@ -501,10 +766,10 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_WRITE:
 	case INSN_WRITEQ: {
-	    HandlerCall hc(cp_expand(_args3[ipos], expander));
+	    HandlerCall hc;
 	    int flags = HandlerCall::OP_WRITE + (insn == INSN_WRITEQ ? HandlerCall::UNQUOTE_PARAM : 0);
-	    if (hc.initialize(flags, this, errh) >= 0) {
-		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
+	    if (initialize_call(hc, expand(ipos, expander), flags, errh) >= 0) {
+		CallErrorHandler c_errh(errh, hc);
 		_write_status = hc.call_write(&c_errh);
 	    }
 	    break;
@@ -515,7 +780,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	case INSN_SET:
 	case insn_setq: {
 	    expander.errh = errh;
-	    _vars[_args[ipos] + 1] = cp_expand(_args3[ipos], expander);
+	    _vars[_args[ipos] + 1] = expand(ipos, expander);
 	    if (insn == insn_setq || insn == insn_returnq)
 		_vars[_args[ipos] + 1] = cp_unquote(_vars[_args[ipos] + 1]);
 	    if ((insn == INSN_RETURN || insn == insn_returnq)
@@ -528,7 +793,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_GOTO: {
 	    // reset intervening instructions
-	    String cond_text = cp_expand(_args3[ipos], expander);
+	    String cond_text = expand(ipos, expander);
 	    bool cond;
 	    if (cond_text && !BoolArg().parse(cond_text, cond))
 		errh->error("bad condition %<%s%>", cond_text.c_str());
@@ -545,7 +810,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case insn_error:
 	case insn_errorq: {
-	    String msg = cp_expand(_args3[ipos], expander);
+	    String msg = expand(ipos, expander);
 	    if (insn == insn_errorq)
 		msg = cp_unquote(msg);
 	    if (msg)
@@ -618,7 +883,7 @@ Script::run_timer(Timer *)
     // called when a timer expires
     assert(_insns[_insn_pos] == INSN_WAIT_TIME || _insns[_insn_pos] == INSN_INITIAL);
     ErrorHandler *errh = ErrorHandler::default_handler();
-    ContextErrorHandler cerrh(errh, "While executing %<%p{element}%>:", this);
+    CallErrorHandler cerrh(errh, this);
     step(1, STEP_TIMER, 0, &cerrh);
     complete_step(0);
 }
@@ -627,7 +892,7 @@ void
 Script::push(int port, Packet *p)
 {
     ErrorHandler *errh = ErrorHandler::default_handler();
-    ContextErrorHandler cerrh(errh, "While executing %<%p{element}%>:", this);
+    CallErrorHandler cerrh(errh, this);
 
     // This is slow, but it probably doesn't need to be fast.
     int i = find_variable(String::make_stable("input", 5), true);
@@ -651,7 +916,7 @@ Script::pull(int)
 	return 0;
 
     ErrorHandler *errh = ErrorHandler::default_handler();
-    ContextErrorHandler cerrh(errh, "While executing %<%p{element}%>:", this);
+    CallErrorHandler cerrh(errh, this);
 
     // This is slow, but it probably doesn't need to be fast.
     int i = find_variable(String::make_stable("input", 5), true);
@@ -679,8 +944,14 @@ Script::Expander::expand(const String &vname, String &out, int vartype, int) con
     if (x < script->_vars.size()) {
 	out = script->_vars[x + 1];
 	return true;
-    }
+    } else
+	return expand_nonvariable(vname, out, vartype);
+}
 
+int
+Script::Expander::expand_nonvariable(const String &vname, String &out, int vartype) const
+{
+    int x;
     if (vname.length() == 1 && vname[0] == '?') {
 	out = String(script->_write_status);
 	return true;
@@ -730,8 +1001,8 @@ Script::Expander::expand(const String &vname, String &out, int vartype, int) con
     }
 
     if (vartype == '(') {
-	HandlerCall hc(vname);
-	if (hc.initialize_read(script, errh) >= 0) {
+	HandlerCall hc;
+	if (script->initialize_call(hc, vname, HandlerCall::OP_READ, errh) >= 0) {
 	    out = hc.call_read(errh);
 	    return true;
 	}
@@ -4,6 +4,8 @@
 #include <click/element.hh>
 #include <click/timer.hh>
 #include <click/variableenv.hh>
+#include <click/handlercall.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -480,7 +482,8 @@ class Script : public Element { public:
     };
 
     enum {
-	max_jumps = 1000, STEP_NORMAL = 0, STEP_ROUTER, STEP_TIMER, STEP_JUMP
+	max_jumps = 1000, STEP_NORMAL = 0, STEP_ROUTER, STEP_TIMER, STEP_JUMP,
+	max_calls = 256
     };
 
     Vector<int> _insns;
@@ -489,6 +492,7 @@ class Script : public Element { public:
     Vector<String> _args3;
 
     Vector<String> _vars;
+    HashTable<String, HandlerCall> _calls;
     String _run_handler_name;
     String _run_args;
     int _run_op;
@@ -504,12 +508,39 @@ class Script : public Element { public:
     Timer _timer;
     int *_cur_steps;
 
+    class CallErrorHandler;
+
     class Expander : public VariableExpander { public:
 	Script *script;
 	ErrorHandler *errh;
 	int expand(const String &var, String &expansion, int vartype, int depth) const;
+	int expand_nonvariable(const String &var, String &expansion, int vartype) const;
+    };
+
+    // Instruction text is scanned for substitutions once, at configuration
+    // time.  An Expr is the result: literal text interleaved with references
+    // ($x, ${x}, $(x)).  Expanding an Expr gives the same string cp_expand()
+    // would give for its source.
+    struct Ref {
+	String prefix;		// literal text before the reference
+	String source;		// the reference itself, kept if it fails
+	String name;
+	int name_expr;		// _exprs index of name, if it has references
+	int slot;		// _vars index of name, once found; or -1
+	char type;		// 'a', '{', or '('
+	char quote;		// surrounding quote character, or 0
     };
 
+    struct Expr {
+	String source;
+	Vector<Ref> refs;
+	String tail;		// literal text after the last reference
+	int depth;
+    };
+
+    Vector<Expr> _exprs;	// [i] is instruction i's text, then names
+    Vector<Timestamp> _times;	// [i] is wait time i, if _args[i] is set
+
     enum {
 	ST_STEP = 0, ST_RUN, ST_GOTO,
 	ar_add = 0, ar_sub, ar_min, ar_max, ar_mul, ar_div, ar_idiv, ar_mod, ar_rem,
@@ -527,6 +558,10 @@ class Script : public Element { public:
     int complete_step(String *retval);
     int find_label(const String &) const;
     int find_variable(const String &name, bool add);
+    int initialize_call(HandlerCall &hc, const String &text, int flags, ErrorHandler *errh);
+    Expr compile(const String &text, int depth);
+    void compile_insns();
+    String expand(int expr, const Expander &expander, bool expand_quote = false);
 
     static int step_handler(int, String&, Element*, const Handler*, ErrorHandler*);
     enum { error_one_number, error_two_numbers };
@@ -56,7 +56,8 @@ SimpleQueue::initialize(ErrorHandler *errh)
     _q = (Packet **) CLICK_LALLOC(sizeof(Packet *) * (_capacity + 1));
     if (_q == 0)
 	return errh->error("out of memory");
-    _drops = 0;
+    _drops.initialize(this);
+    _drops.clear();
     _highwater_length = 0;
     return 0;
 }
@@ -153,7 +154,7 @@ SimpleQueue::push(int, Packet *p)
 
     } else {
 	// if (!(_drops % 100))
-	if (_drops == 0 && _capacity > 0)
+	if (_drops.local_value() == 0 && _capacity > 0)
 	    click_chatter("%p{element}: overflow", this);
 	_drops++;
 	checked_output_push(1, p);
@@ -180,7 +181,7 @@ SimpleQueue::read_handler(Element *e, void *thunk)
       case 2:
 	return String(q->capacity());
       case 3:
-	return String(q->_drops);
+	return String(q->_drops.value());
       default:
 	return "";
     }
@@ -200,7 +201,7 @@ SimpleQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler
     int which = reinterpret_cast<intptr_t>(thunk);
     switch (which) {
       case 0:
-	q->_drops = 0;
+	q->_drops.clear();
 	q->_highwater_length = q->size();
 	return 0;
       case 1:
@@ -214,10 +215,10 @@ SimpleQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler
 void
 SimpleQueue::add_handlers()
 {
-    add_read_handler("length", read_handler, 0);
-    add_read_handler("highwater_length", read_handler, 1);
+    add_read_handler("length", read_handler, 0, Handler::h_nonexclusive);
+    add_read_handler("highwater_length", read_handler, 1, Handler::h_nonexclusive);
     add_read_handler("capacity", read_handler, 2, Handler::h_calm);
-    add_read_handler("drops", read_handler, 3);
+    add_read_handler("drops", read_handler, 3, Handler::h_nonexclusive);
     add_write_handler("capacity", reconfigure_keyword_handler, "0 CAPACITY");
     add_write_handler("reset_counts", write_handler, 0, Handler::h_button | Handler::h_nonexclusive);
     add_write_handler("reset", write_handler, 1, Handler::h_button);
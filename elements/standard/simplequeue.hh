@@ -3,6 +3,7 @@
 #define CLICK_SIMPLEQUEUE_HH
 #include <click/element.hh>
 #include <click/standard/storage.hh>
+#include <click/sharded.hh>
 CLICK_DECLS
 
 /*
@@ -66,7 +67,7 @@ class SimpleQueue : public Element, public Storage { public:
 
     SimpleQueue() CLICK_COLD;
 
-    int drops() const				{ return _drops; }
+    int drops() const				{ return _drops.value(); }
     int highwater_length() const		{ return _highwater_length; }
 
     inline bool enq(Packet*);
@@ -90,6 +91,7 @@ class SimpleQueue : public Element, public Storage { public:
     int initialize(ErrorHandler*) CLICK_COLD;
     void cleanup(CleanupStage) CLICK_COLD;
     bool can_live_reconfigure() const		{ return true; }
+    bool can_keep_across_hotswap() const	{ return true; }
     int live_reconfigure(Vector<String>&, ErrorHandler*);
     void take_state(Element*, ErrorHandler*);
     void add_handlers() CLICK_COLD;
@@ -100,7 +102,7 @@ class SimpleQueue : public Element, public Storage { public:
   protected:
 
     Packet* volatile * _q;
-    volatile int _drops;
+    ShardedCounter<int> _drops;
     int _highwater_length;
 
     friend class MixedQueue;
@@ -24,6 +24,7 @@ class Strip : public Element { public:
 
     const char *class_name() const		{ return "Strip"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    bool can_keep_across_hotswap() const	{ return true; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
@@ -31,6 +31,7 @@ class Tee : public Element {
   const char *class_name() const		{ return "Tee"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return PUSH; }
+  bool can_keep_across_hotswap() const	{ return true; }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
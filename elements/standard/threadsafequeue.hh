@@ -49,6 +49,11 @@ When written, resets the C<drops> and C<highwater_length> counters.
 
 When written, drops all packets in the queue.
 
+=h cross_node_handoffs read-only
+
+Returns the number of packets pulled on a different NUMA node from the one
+they were most recently pushed on.  See Queue.
+
 =a Queue, SimpleQueue, NotifierQueue, MixedQueue, FrontDropQueue */
 
 class ThreadSafeQueue : public FullNoteQueue { public:
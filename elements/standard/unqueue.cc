@@ -81,6 +81,7 @@ Unqueue::run_task(Task *)
 
     _task.fast_reschedule();
   out:
+    _task.add_work(worked);
     return worked > 0;
 }
 
@@ -70,6 +70,7 @@ class Unqueue : public Element { public:
     const char *class_name() const		{ return "Unqueue"; }
     const char *port_count() const		{ return PORTS_1_1; }
     const char *processing() const		{ return PULL_TO_PUSH; }
+    bool can_keep_across_hotswap() const	{ return true; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
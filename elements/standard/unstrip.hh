@@ -28,6 +28,7 @@ class Unstrip : public Element {
 
   const char *class_name() const	{ return "Unstrip"; }
   const char *port_count() const	{ return PORTS_1_1; }
+  bool can_keep_across_hotswap() const	{ return true; }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
@@ -109,26 +109,34 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
     return store_flow(flow, input, _udp_map, &reply_udp_map(rwinput));
 }
 
-void
-IPRewriter::push(int port, Packet *p_in)
+// Returns the flow table for p, or 0 if p is not the first fragment of a
+// TCP or UDP packet.
+inline IPRewriter::Map *
+IPRewriter::flow_map(Packet *p)
 {
-    WritablePacket *p = p_in->uniqueify();
-    click_ip *iph = p->ip_header();
-
-    // handle non-first fragments
+    const click_ip *iph = p->ip_header();
     if ((iph->ip_p != IP_PROTO_TCP && iph->ip_p != IP_PROTO_UDP)
 	|| !IP_FIRSTFRAG(iph)
-	|| p->transport_length() < 8) {
-	const IPRewriterInput &is = _input_specs[port];
-	if (is.kind == IPRewriterInput::i_nochange)
-	    output(is.foutput).push(p);
-	else
-	    p->kill();
-	return;
-    }
+	|| p->transport_length() < 8)
+	return 0;
+    return iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map;
+}
 
+inline void
+IPRewriter::push_nonflow(int port, Packet *p)
+{
+    const IPRewriterInput &is = _input_specs[port];
+    if (is.kind == IPRewriterInput::i_nochange)
+	output(is.foutput).push(p);
+    else
+	p->kill();
+}
+
+inline void
+IPRewriter::rewrite(int port, WritablePacket *p, Map *map)
+{
+    click_ip *iph = p->ip_header();
     IPFlowID flowid(p);
-    HashContainer<IPRewriterEntry> *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
     IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
@@ -165,6 +173,43 @@ IPRewriter::push(int port, Packet *p_in)
     output(m->output()).push(p);
 }
 
+void
+IPRewriter::push(int port, Packet *p_in)
+{
+    WritablePacket *p = p_in->uniqueify();
+    if (Map *map = flow_map(p))
+	rewrite(port, p, map);
+    else
+	push_nonflow(port, p);
+}
+
+void
+IPRewriter::push_burst(int port, Packet **burst, int n)
+{
+    // A flow lookup usually misses the cache twice, once on the bucket and
+    // once on the flow. Prefetch every packet's bucket, then every bucket's
+    // first flow, and only then rewrite, so the burst's misses overlap.
+    // Bucket numbers are only hints: adding a flow may rehash the table,
+    // so rewrite() looks each flow up again.
+    Map *map[max_burst];
+    Map::size_type bucket[max_burst];
+    for (int i = 0; i < n; ++i) {
+	burst[i] = burst[i]->uniqueify();
+	if ((map[i] = flow_map(burst[i]))) {
+	    bucket[i] = map[i]->bucket(IPFlowID(burst[i]));
+	    map[i]->prefetch_bucket(bucket[i]);
+	}
+    }
+    for (int i = 0; i < n; ++i)
+	if (map[i])
+	    map[i]->prefetch_bucket_element(bucket[i]);
+    for (int i = 0; i < n; ++i)
+	if (map[i])
+	    rewrite(port, static_cast<WritablePacket *>(burst[i]), map[i]);
+	else
+	    push_nonflow(port, burst[i]);
+}
+
 String
 IPRewriter::udp_mappings_handler(Element *e, void *)
 {
@@ -111,6 +111,11 @@ packets, and second and subsequent fragments, are dropped unless they arrive
 on a 'pass' input port.  IPRewriter changes IP packet data and, optionally,
 destination IP address annotations; see the DST_ANNO keyword argument below.
 
+IPRewriter's inputs may be push or pull. Packets pulled from pull inputs are
+processed in bursts of up to BURST packets: IPRewriter prefetches the flow
+table entries for the whole burst before rewriting any of it, which is
+faster than pushing packets one at a time when there are many flows.
+
 Keyword arguments determine how often stale mappings should be removed.
 
 =over 5
@@ -164,6 +169,11 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item BURST I<n>
+
+Pull inputs are served by a task that pulls up to I<n> packets from each
+input at a time. At most 256. Default is 32.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -239,6 +249,7 @@ class IPRewriter : public TCPRewriter { public:
     }
 
     void push(int, Packet *);
+    void push_burst(int port, Packet **p, int n);
 
     void add_handlers() CLICK_COLD;
 
@@ -262,6 +273,10 @@ class IPRewriter : public TCPRewriter { public:
     }
     static String udp_mappings_handler(Element *e, void *user_data);
 
+    inline Map *flow_map(Packet *p);
+    inline void push_nonflow(int port, Packet *p);
+    inline void rewrite(int port, WritablePacket *p, Map *map);
+
 };
 
 
@@ -30,6 +30,7 @@ TCPFragmenter::TCPFragmenter()
 {
     _fragments = 0;
     _fragmented_count = 0;
+    _shared = 0;
     _count = 0;
 }
 
@@ -40,7 +41,7 @@ TCPFragmenter::~TCPFragmenter()
 int
 TCPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint16_t mtu;
+    uint16_t mtu = 0;
     int mtu_anno = -1;
 
     if (Args(conf, this, errh)
@@ -57,6 +58,40 @@ TCPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+void
+TCPFragmenter::fix_segment(unsigned char *hdr, const Segment &seg,
+			   int n, int offset, int len, bool last,
+			   uint32_t payload_sum)
+{
+    click_ip *ip = reinterpret_cast<click_ip *>(hdr + seg.ip_off);
+    int ip_hlen = ip->ip_hl << 2;
+    click_tcp *tcp = reinterpret_cast<click_tcp *>(hdr + seg.ip_off + ip_hlen);
+
+    ip->ip_len = htons(seg.hdr_len - seg.ip_off + len);
+    ip->ip_id = htons(seg.id + n);
+    ip->ip_sum = 0;
+#if HAVE_FAST_CHECKSUM
+    ip->ip_sum = ip_fast_csum((unsigned char *)ip, ip_hlen >> 2);
+#else
+    ip->ip_sum = click_in_cksum((unsigned char *)ip, ip_hlen);
+#endif
+
+    // like TSO: CWR only on the first segment, FIN and PSH only on the last
+    uint8_t flags = seg.flags;
+    if (n)
+	flags &= ~TH_CWR;
+    if (!last)
+	flags &= ~(TH_FIN | TH_PUSH);
+    tcp->th_flags = flags;
+    tcp->th_seq = htonl(seg.seq + offset);
+    tcp->th_sum = 0;
+
+    // now calculate tcp header cksum; the payload is already summed
+    int tcp_hlen = seg.hdr_len - seg.ip_off - ip_hlen;
+    unsigned csum = ~click_in_cksum_partial((unsigned char *)tcp, tcp_hlen, payload_sum) & 0xFFFF;
+    tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, tcp_hlen + len);
+}
+
 void
 TCPFragmenter::push(int, Packet *p)
 {
@@ -65,64 +100,87 @@ TCPFragmenter::push(int, Packet *p)
 	(!mtu || mtu > p->anno_u16(_mtu_anno)))
 	mtu = p->anno_u16(_mtu_anno);
 
-    int32_t hlen;
-    int32_t tcp_len;
+    int32_t hlen = 0;
+    int32_t tcp_len = 0;
     {
         const click_ip *ip = p->ip_header();
-        const click_tcp *tcp = p->tcp_header();
-        hlen = (ip->ip_hl<<2) + (tcp->th_off<<2);
-        tcp_len = ntohs(ip->ip_len) - hlen;
+	if (ip->ip_p == IP_PROTO_TCP && !IP_ISFRAG(ip)) {
+	    const click_tcp *tcp = p->tcp_header();
+	    hlen = (ip->ip_hl<<2) + (tcp->th_off<<2);
+	    tcp_len = ntohs(ip->ip_len) - hlen;
+	}
     }
 
     int max_tcp_len = mtu - hlen;
 
     _count++;
-    if (!mtu || max_tcp_len <= 0 || tcp_len < max_tcp_len) {
+    if (!mtu || !hlen || max_tcp_len <= 0 || tcp_len <= max_tcp_len
+	|| p->network_header_offset() + hlen + tcp_len > (int) p->length()) {
         output(0).push(p);
         return;
     }
 
+    WritablePacket *wp = p->uniqueify();
+    if (!wp)
+	return;
     _fragmented_count++;
-    for (int offset = 0; offset < tcp_len; offset += max_tcp_len) {
-        Packet *p_clone;
-        if (offset + max_tcp_len < tcp_len)
-            p_clone = p->clone();
-        else {
-            p_clone = p;
-            p = 0;
-        }
-        if (!p_clone)
-            break;
-        WritablePacket *q = p_clone->uniqueify();
-        p_clone = 0;
-        click_ip *ip = q->ip_header();
-        click_tcp *tcp = q->tcp_header();
-        uint8_t *tcp_data = ((uint8_t *)tcp) + (tcp->th_off<<2);
-        int this_len = tcp_len - offset > max_tcp_len ? max_tcp_len : tcp_len - offset;
-        if (offset != 0)
-            memcpy(tcp_data, tcp_data + offset, this_len);
-        q->take(tcp_len - this_len);
-        ip->ip_len = htons(q->end_data() - q->network_header());
-        ip->ip_sum = 0;
-#if HAVE_FAST_CHECKSUM
-        ip->ip_sum = ip_fast_csum((unsigned char *)ip, q->network_header_length() >> 2);
-#else
-        ip->ip_sum = click_in_cksum((unsigned char *)ip, q->network_header_length());
-#endif
 
-        if ((tcp->th_flags & TH_FIN) && offset + mtu < tcp_len)
-            tcp->th_flags ^= TH_FIN;
-
-        tcp->th_seq = htonl(ntohl(tcp->th_seq) + offset);
-        tcp->th_sum = 0;
-
-        // now calculate tcp header cksum
-        int plen = q->end_data() - (uint8_t*)tcp;
-        unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
-        tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
+    Segment seg;
+    seg.ip_off = wp->network_header_offset();
+    seg.hdr_len = seg.ip_off + hlen;
+    seg.seq = ntohl(wp->tcp_header()->th_seq);
+    seg.id = ntohs(wp->ip_header()->ip_id);
+    seg.flags = wp->tcp_header()->th_flags;
+    int mac_off = wp->has_mac_header() ? wp->mac_header_offset() : -1;
+    int ip_hlen = wp->network_header_length();
+    unsigned char *base = wp->data();
+
+    // Segments share wp's buffer where they can. A segment's headers go
+    // just before its payload, on top of the end of the previous segment's
+    // payload, so segments alternate: odd-numbered segments are copied into
+    // new packets, and even-numbered ones are clones of wp, with their
+    // headers copied from the first segment's after the previous segment
+    // was copied. The bytes overwritten are never part of an earlier clone.
+    // If the headers are bigger than a segment's payload, every segment
+    // after the first is copied.
+    bool share = seg.hdr_len <= max_tcp_len;
+
+    for (int offset = 0, n = 0; offset < tcp_len; offset += max_tcp_len, ++n) {
+        int this_len = tcp_len - offset > max_tcp_len ? max_tcp_len : tcp_len - offset;
+	bool last = offset + this_len >= tcp_len;
+	unsigned char *hdr;
+	Packet *q;
+
+	if (n == 0 || (share && !(n & 1))) {
+	    hdr = base + offset;
+	    if (n != 0)
+		memcpy(hdr, base, seg.hdr_len);
+	    fix_segment(hdr, seg, n, offset, this_len, last,
+			click_in_cksum_partial(hdr + seg.hdr_len, this_len, 0));
+	    if (!(q = wp->clone()))
+		continue;
+	    q->pull(offset);
+	    q->take(q->length() - seg.hdr_len - this_len);
+	    _shared += (n != 0);
+	} else {
+	    WritablePacket *wq = Packet::make(wp->headroom(), 0, seg.hdr_len + this_len, 0);
+	    if (!wq)
+		continue;
+	    memcpy(wq->data(), base, seg.hdr_len);
+	    uint32_t sum = click_in_cksum_copy(wq->data() + seg.hdr_len, base + seg.hdr_len + offset, this_len, 0);
+	    wq->copy_annotations(wp);
+	    fix_segment(wq->data(), seg, n, offset, this_len, last, sum);
+	    q = wq;
+	}
+
+	if (mac_off >= 0)
+	    q->set_mac_header(q->data() + mac_off);
+	q->set_network_header(q->data() + seg.ip_off, ip_hlen);
         _fragments++;
         output(0).push(q);
     }
+
+    wp->kill();
 }
 
 void
@@ -131,6 +189,7 @@ TCPFragmenter::add_handlers()
     add_data_handlers("fragments", Handler::OP_READ, &_fragments);
     add_data_handlers("fragmented_count", Handler::OP_READ, &_fragmented_count);
     add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("shared", Handler::OP_READ, &_shared);
 }
 
 CLICK_ENDDECLS
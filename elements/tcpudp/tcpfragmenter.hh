@@ -21,6 +21,18 @@ and tcp), length (ip length), and tcp sequence number (for all fragments except
 the first).  This means that TCPFragmenter can operate on packets that have
 ethernet headers, and all ethernet headers will be copied to each fragment.
 
+Like TCP segmentation offload, TCPFragmenter gives consecutive segments
+consecutive IP IDs, and sets the CWR flag only on the first segment and the
+FIN and PSH flags only on the last. Use it, for instance, to split the large
+TCP segments a KernelTun with a large MTU delivers into segments that fit the
+outgoing link. Packets that are not TCP, or are IP fragments, pass through
+unchanged.
+
+TCPFragmenter avoids copying payload where it can. The first segment and
+every second segment after it share the input packet's buffer, with their
+headers written in front of their payload; only the other segments are
+copied. The shared segments are not writable without a copy.
+
 =item MTU
 Unsigned. If MTU is non-zero, then fragment every packet larger than MTU.
 
@@ -28,6 +40,23 @@ Unsigned. If MTU is non-zero, then fragment every packet larger than MTU.
 Two Byte Annotation. If specified and annotation is non zero, then
 fragment every packet larger than the annotation's value.
 
+=h fragments read-only
+Returns the number of segments emitted by splitting packets.
+
+=h fragmented_count read-only
+Returns the number of packets split.
+
+=h count read-only
+Returns the number of packets seen.
+
+=h shared read-only
+Returns the number of segments after the first that shared the input
+packet's buffer rather than copying it.
+
+=e
+
+  KernelTun(10.0.0.1/24, MTU 65000) -> ... -> TCPFragmenter(1500) -> ...
+
 =a IPFragmenter, TCPIPEncap
 */
 
@@ -54,6 +83,19 @@ class TCPFragmenter : public Element { public:
   atomic_uint32_t _fragments;
   atomic_uint32_t _fragmented_count;
   atomic_uint32_t _count;
+  atomic_uint32_t _shared;
+
+    struct Segment {
+	int ip_off;		// IP header offset from data()
+	int hdr_len;		// bytes up to the TCP payload
+	uint32_t seq;
+	uint16_t id;
+	uint8_t flags;
+    };
+
+    static void fix_segment(unsigned char *hdr, const Segment &seg,
+			    int n, int offset, int len, bool last,
+			    uint32_t payload_sum);
 };
 
 CLICK_ENDDECLS
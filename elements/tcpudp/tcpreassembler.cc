@@ -0,0 +1,352 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpreassembler.{cc,hh} -- reassembles TCP byte streams
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpreassembler.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+TCPReassembler::TCPReassembler()
+    : _timer(this), _mem_used(0), _nflows(0), _held(0), _delivered(0),
+      _duplicates(0), _overflows(0), _timeouts(0)
+{
+}
+
+TCPReassembler::~TCPReassembler()
+{
+}
+
+int
+TCPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t timeout_msec = 120000;
+    _mem_max = 16 << 20;
+    _flow_mem_max = 256 << 10;
+    if (Args(conf, this, errh)
+	.read("TIMEOUT", SecondsArg(3), timeout_msec)
+	.read("MEMORY", _mem_max)
+	.read("FLOW_MEMORY", _flow_mem_max)
+	.complete() < 0)
+	return -1;
+    if (timeout_msec == 0)
+	return errh->error("TIMEOUT must be positive");
+    _tick_msec = timeout_msec / wheel_span;
+    if (_tick_msec == 0)
+	_tick_msec = 1;
+    return 0;
+}
+
+int
+TCPReassembler::initialize(ErrorHandler *)
+{
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+TCPReassembler::cleanup(CleanupStage)
+{
+    for (int i = 0; i < wheel_size; ++i)
+	while (Flow *f = _wheel[i].front())
+	    remove_flow(f);
+}
+
+inline uint32_t
+TCPReassembler::now_tick() const
+{
+    return Timestamp::recent_steady().msecval() / _tick_msec;
+}
+
+inline void
+TCPReassembler::drop(Packet *p)
+{
+    checked_output_push(1, p);
+}
+
+TCPReassembler::Flow *
+TCPReassembler::make_flow(Table::iterator &it, const IPFlowID &key, uint32_t tick)
+{
+    void *x;
+    if (_mem_used + sizeof(Flow) > _mem_max || !(x = _flow_alloc.allocate()))
+	return 0;
+    Flow *f = new(x) Flow(key);
+    _table.set(it, f, true);
+    _mem_used += sizeof(Flow);
+    f->expire = tick + wheel_span;
+    f->slot = f->expire & (wheel_size - 1);
+    _wheel[f->slot].push_back(f);
+    if (++_nflows == 1 && !_timer.scheduled()) {
+	_wheel_now = tick;
+	_timer.schedule_after_msec(_tick_msec);
+    }
+    return f;
+}
+
+void
+TCPReassembler::reset_flow(Flow *f, uint32_t next)
+{
+    while (Segment *s = f->segs.front()) {
+	f->segs.pop_front();
+	s->p->kill();
+	_mem_used -= s->end - s->seq + sizeof(Segment);
+	_held--;
+	s->~Segment();
+	_seg_alloc.deallocate(s);
+    }
+    f->mem = 0;
+    f->next = next;
+    f->have_fin = f->closed = false;
+}
+
+void
+TCPReassembler::remove_flow(Flow *f)
+{
+    reset_flow(f, 0);
+    _table.erase(f->key);
+    _wheel[f->slot].erase(f);
+    _mem_used -= sizeof(Flow);
+    _nflows--;
+    f->~Flow();
+    _flow_alloc.deallocate(f);
+}
+
+inline void
+TCPReassembler::deliver(Flow *f, Packet *p, uint32_t seq, uint32_t end)
+{
+    if (SEQ_LT(seq, f->next)) {
+	p->pull(f->next - seq);
+	seq = f->next;
+    }
+    f->next = end;
+    SET_SEQUENCE_NUMBER_ANNO(p, seq);
+    _delivered += end - seq;
+    output(0).push(p);
+}
+
+void
+TCPReassembler::release(Flow *f)
+{
+    // emit held segments that the stream has caught up to
+    while (Segment *s = f->segs.front()) {
+	if (SEQ_LT(f->next, s->seq))
+	    break;
+	f->segs.pop_front();
+	Packet *p = s->p;
+	uint32_t seq = s->seq, end = s->end;
+	f->mem -= end - seq + sizeof(Segment);
+	_mem_used -= end - seq + sizeof(Segment);
+	_held--;
+	s->~Segment();
+	_seg_alloc.deallocate(s);
+	if (SEQ_LEQ(end, f->next))
+	    p->kill();
+	else
+	    deliver(f, p, seq, end);
+    }
+}
+
+bool
+TCPReassembler::hold(Flow *f, Segment *pos, Packet *p, uint32_t seq, uint32_t end)
+{
+    uint32_t mem = end - seq + sizeof(Segment);
+    void *x;
+    if (f->mem + mem > _flow_mem_max || _mem_used + mem > _mem_max
+	|| !(x = _seg_alloc.allocate())) {
+	_overflows++;
+	drop(p);
+	return false;
+    }
+    Segment *s = new(x) Segment;
+    s->seq = seq;
+    s->end = end;
+    s->p = p;
+    f->segs.insert(pos, s);
+    f->mem += mem;
+    _mem_used += mem;
+    _held++;
+    return true;
+}
+
+void
+TCPReassembler::insert(Flow *f, Packet *p, uint32_t seq, uint32_t end)
+{
+    // Hold the parts of [seq, end) that are not already held. Each part
+    // becomes its own segment; all but the last are clones of p.
+    Segment *s = f->segs.front();
+    while (s && SEQ_LEQ(s->end, seq))
+	s = s->_link.next();
+
+    bool held_any = false, overflowed = false;
+    while (1) {
+	uint32_t piece_end = end;
+	if (s && SEQ_LT(s->seq, end))
+	    piece_end = s->seq;
+
+	if (SEQ_LT(seq, piece_end)) {
+	    Packet *q = p;
+	    if (piece_end != end) {
+		if (!(q = p->clone())) {
+		    _overflows++;
+		    drop(p);
+		    return;
+		}
+		q->take(end - piece_end);
+	    }
+	    if (hold(f, s, q, seq, piece_end))
+		held_any = true;
+	    else
+		overflowed = true;
+	    if (q == p)
+		return;
+	}
+
+	if (!s || SEQ_LEQ(end, s->end))
+	    break;
+	// skip the bytes s already holds
+	p->pull(s->end - seq);
+	seq = s->end;
+	s = s->_link.next();
+    }
+
+    // If a piece overflowed, p's other bytes are already held, and the
+    // overflow was counted.
+    if (held_any || overflowed)
+	p->kill();
+    else {
+	_duplicates++;
+	drop(p);
+    }
+}
+
+void
+TCPReassembler::push(int, Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    if (!p->has_network_header() || iph->ip_p != IP_PROTO_TCP
+	|| !p->has_transport_header() || IP_ISFRAG(iph)
+	|| p->transport_length() < (int) sizeof(click_tcp)) {
+	drop(p);
+	return;
+    }
+    const click_tcp *tcph = p->tcp_header();
+    int off = p->transport_header_offset() + (tcph->th_off << 2);
+    int end_off = p->network_header_offset() + ntohs(iph->ip_len);
+    if (tcph->th_off < 5 || end_off > (int) p->length() || off > end_off) {
+	drop(p);
+	return;
+    }
+
+    uint32_t seq = ntohl(tcph->th_seq);
+    uint32_t len = end_off - off;
+    uint8_t flags = tcph->th_flags;
+    uint32_t tick = now_tick();
+    IPFlowID key(p);
+
+    Table::iterator it = _table.find(key);
+    Flow *f = it.get();
+    if (flags & TH_RST) {
+	if (f)
+	    remove_flow(f);
+	p->kill();
+	return;
+    }
+
+    // the SYN occupies the first sequence number
+    if (flags & TH_SYN)
+	seq++;
+    if (!f) {
+	if (!(f = make_flow(it, key, tick))) {
+	    _overflows++;
+	    drop(p);
+	    return;
+	}
+	f->next = seq;
+    } else if ((flags & TH_SYN) && f->closed)
+	reset_flow(f, seq);
+    f->expire = tick + wheel_span;
+    if (flags & TH_FIN) {
+	f->fin = seq + len;
+	f->have_fin = true;
+    }
+
+    if (len) {
+	p->pull(off);
+	p->take(p->length() - len);
+	uint32_t end = seq + len;
+	if (SEQ_LEQ(end, f->next)) {
+	    _duplicates++;
+	    drop(p);
+	} else if (SEQ_LEQ(seq, f->next)) {
+	    deliver(f, p, seq, end);
+	    release(f);
+	} else
+	    insert(f, p, seq, end);
+    } else
+	p->kill();
+
+    if (f->have_fin && f->next == f->fin && f->segs.empty())
+	f->closed = true;
+}
+
+void
+TCPReassembler::run_timer(Timer *)
+{
+    // Visit the slots for the ticks since the last run. A stream whose
+    // expiry was pushed back by later packets is filed again under its new
+    // expiry; the others are removed.
+    uint32_t now = now_tick();
+    uint32_t n = now - _wheel_now;
+    if (n > wheel_size)
+	n = wheel_size;
+    for (uint32_t t = now - n + 1; t != now + 1; ++t) {
+	WheelSlot &slot = _wheel[t & (wheel_size - 1)];
+	WheelSlot due;
+	while (Flow *f = slot.front()) {
+	    slot.pop_front();
+	    due.push_back(f);
+	}
+	while (Flow *f = due.front()) {
+	    due.pop_front();
+	    f->slot = f->expire & (wheel_size - 1);
+	    _wheel[f->slot].push_back(f);
+	    if ((int32_t) (f->expire - now) <= 0) {
+		remove_flow(f);
+		_timeouts++;
+	    }
+	}
+    }
+    _wheel_now = now;
+    if (_nflows)
+	_timer.reschedule_after_msec(_tick_msec);
+}
+
+void
+TCPReassembler::add_handlers()
+{
+    add_data_handlers("flows", Handler::OP_READ, &_nflows);
+    add_data_handlers("held", Handler::OP_READ, &_held);
+    add_data_handlers("mem_used", Handler::OP_READ, &_mem_used);
+    add_data_handlers("delivered", Handler::OP_READ, &_delivered);
+    add_data_handlers("duplicates", Handler::OP_READ, &_duplicates);
+    add_data_handlers("overflows", Handler::OP_READ, &_overflows);
+    add_data_handlers("timeouts", Handler::OP_READ, &_timeouts);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPReassembler)
@@ -0,0 +1,207 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TCPREASSEMBLER_HH
+#define CLICK_TCPREASSEMBLER_HH
+#include <click/element.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/ipflowid.hh>
+#include <click/list.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TCPReassembler([I<keywords> TIMEOUT, MEMORY, FLOW_MEMORY])
+
+=s tcp
+
+reassembles TCP byte streams
+
+=d
+
+TCPReassembler reconstructs the byte stream of each TCP connection
+direction, for content inspection. Input packets must be IP packets with
+their network and transport headers set, as by CheckIPHeader or
+CheckTCPHeader. Streams are keyed by IPFlowID, so the two directions of a
+connection are separate streams.
+
+TCPReassembler emits on output 0 each stream's payload bytes in sequence
+order, each byte exactly once. An emitted packet's data is exactly the new
+payload it carries: data() points at the first new byte, and the packet's
+network and transport header pointers still refer to its original
+headers. The sequence number annotation is set to the TCP sequence number
+of the first byte. Bytes already emitted are trimmed from the front of a
+retransmitted or overlapping segment. Where a segment overlaps bytes that
+are held, the bytes that arrived first are kept.
+
+Segments that arrive ahead of a gap are held, without copying, in a sorted
+per-stream list until the gap is filled. A segment that covers held
+segments is split into pieces by cloning it. Held memory is counted as
+payload bytes plus a small per-segment and per-stream overhead; segments
+that would take a stream past FLOW_MEMORY, or all streams past MEMORY, are
+dropped, as are streams that would take all streams past MEMORY.
+
+A stream starts at its SYN, or at the first segment seen if there was no
+SYN. An RST ends the stream immediately, discarding held segments. Once
+every byte up to a FIN has been emitted the stream is closed; it is kept
+until TIMEOUT so that retransmissions are recognized, and a new SYN
+restarts it. Streams idle for TIMEOUT are removed along with any held
+segments. Expiry uses a timer wheel, so its cost does not depend on the
+number of streams.
+
+Packets without payload are consumed. Non-TCP packets, IP fragments and
+packets with bad lengths, and segments dropped as duplicates or for lack
+of memory, are emitted on output 1, if it exists, and dropped otherwise.
+
+Keyword arguments are:
+
+=over 8
+
+=item TIMEOUT
+
+Time in seconds. Streams idle this long are removed. Default is 120.
+
+=item MEMORY
+
+Unsigned. Maximum memory for held segments and stream state, in bytes.
+Default is 16MB.
+
+=item FLOW_MEMORY
+
+Unsigned. Maximum memory for held segments per stream, in bytes. Default
+is 256KB.
+
+=back
+
+=h flows read-only
+
+Returns the number of streams.
+
+=h held read-only
+
+Returns the number of segments held out of order.
+
+=h mem_used read-only
+
+Returns the memory used for held segments and stream state, in bytes.
+
+=h delivered read-only
+
+Returns the number of payload bytes emitted on output 0.
+
+=h duplicates read-only
+
+Returns the number of segments dropped because all their bytes had already
+been emitted or were held.
+
+=h overflows read-only
+
+Returns the number of segments and streams dropped because of MEMORY or
+FLOW_MEMORY.
+
+=h timeouts read-only
+
+Returns the number of streams removed after TIMEOUT.
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader -> IPClassifier(tcp)
+      -> CheckTCPHeader -> TCPReassembler -> ... // inspect payload
+
+=a
+
+IPReassembler, TCPBuffer, CheckTCPHeader, IPFlowID */
+
+class TCPReassembler : public Element { public:
+
+    TCPReassembler() CLICK_COLD;
+    ~TCPReassembler() CLICK_COLD;
+
+    const char *class_name() const	{ return "TCPReassembler"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int, Packet *);
+    void run_timer(Timer *);
+
+  private:
+
+    // The wheel has wheel_size slots. TIMEOUT spans wheel_span ticks, so a
+    // stream is never filed more than one revolution ahead.
+    enum { wheel_size = 64, wheel_span = 32 };
+
+    struct Segment {
+	List_member<Segment> _link;
+	uint32_t seq;		// sequence number of the first byte
+	uint32_t end;		// sequence number after the last byte
+	Packet *p;		// data is exactly bytes [seq, end)
+    };
+
+    typedef List<Segment, &Segment::_link> SegmentList;
+
+    struct Flow {
+	IPFlowID key;
+	Flow *_hashnext;
+	List_member<Flow> _wheel_link;
+	SegmentList segs;	// held segments, sorted and disjoint
+	uint32_t next;		// next sequence number to emit
+	uint32_t fin;		// sequence number of the FIN, if have_fin
+	uint32_t mem;
+	uint32_t expire;	// tick
+	uint8_t slot;		// wheel slot
+	bool have_fin;
+	bool closed;
+
+	typedef IPFlowID key_type;
+	typedef const IPFlowID &key_const_reference;
+	Flow(const IPFlowID &k)
+	    : key(k), _hashnext(), mem(0), have_fin(false), closed(false) {
+	}
+	key_const_reference hashkey() const {
+	    return key;
+	}
+    };
+
+    typedef HashContainer<Flow> Table;
+    typedef List<Flow, &Flow::_wheel_link> WheelSlot;
+
+    Table _table;
+    SizedHashAllocator<sizeof(Flow)> _flow_alloc;
+    SizedHashAllocator<sizeof(Segment)> _seg_alloc;
+
+    WheelSlot _wheel[wheel_size];
+    uint32_t _wheel_now;	// last tick processed
+    uint32_t _tick_msec;
+    Timer _timer;
+
+    uint32_t _mem_used;
+    uint32_t _mem_max;
+    uint32_t _flow_mem_max;
+
+    uint32_t _nflows;
+    uint32_t _held;
+    uint64_t _delivered;
+    uint32_t _duplicates;
+    uint32_t _overflows;
+    uint32_t _timeouts;
+
+    inline uint32_t now_tick() const;
+    inline void drop(Packet *p);
+    inline void deliver(Flow *f, Packet *p, uint32_t seq, uint32_t end);
+    Flow *make_flow(Table::iterator &it, const IPFlowID &key, uint32_t tick);
+    void remove_flow(Flow *f);
+    void reset_flow(Flow *f, uint32_t next);
+    bool hold(Flow *f, Segment *pos, Packet *p, uint32_t seq, uint32_t end);
+    void insert(Flow *f, Packet *p, uint32_t seq, uint32_t end);
+    void release(Flow *f);
+
+};
+
+CLICK_ENDDECLS
+#endif
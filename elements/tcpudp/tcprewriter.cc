@@ -165,11 +165,14 @@ TCPRewriter::TCPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
     if (!IP_FIRSTFRAG(iph) || p->transport_length() < 18)
 	return;
 
-    // TCP header
+    // TCP header. Changes to the TCP checksum are summed in csum_delta
+    // and applied with a single fold at the end.
     click_tcp *tcph = p->tcp_header();
     tcph->th_sport = revflow.dport();
     tcph->th_dport = revflow.sport();
-    update_csum(&tcph->th_sum, direction, _udp_csum_delta);
+    uint32_t csum_delta = 0;
+    if (_udp_csum_delta)
+	csum_delta = 0xFFFF + (direction ? _udp_csum_delta : ~_udp_csum_delta & 0xFFFF);
 
     // track connection state
     bool have_payload = ((iph->ip_hl + tcph->th_off) << 2) < ntohs(iph->ip_len);
@@ -182,13 +185,11 @@ TCPRewriter::TCPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
     if (have_payload)
 	_tflags |= s_forward_data << direction;
 
-    // end if weird transport length
-    if (p->transport_length() < (tcph->th_off << 2))
-	return;
-
-    // update sequence numbers
-    if (!_dt)
+    // end if weird transport length, or no sequence number changes
+    if (p->transport_length() < (tcph->th_off << 2) || !_dt) {
+	apply_csum_delta(&tcph->th_sum, csum_delta);
 	return;
+    }
 
     // drop trigger once sequence number has advanced 1G beyond it
     if (_dt->has_trigger(direction)
@@ -203,16 +204,16 @@ TCPRewriter::TCPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 
     if (_dt->delta[direction] || _dt->has_trigger(direction)) {
 	uint32_t newval = htonl(new_seq(direction, ntohl(tcph->th_seq)));
-	click_update_in_cksum(&tcph->th_sum, tcph->th_seq >> 16, newval >> 16);
-	click_update_in_cksum(&tcph->th_sum, tcph->th_seq, newval);
+	csum_delta += word_csum_delta(tcph->th_seq, newval);
 	tcph->th_seq = newval;
     }
 
     if (_dt->delta[!direction] || _dt->has_trigger(!direction)) {
 	uint32_t newval = htonl(new_ack(direction, ntohl(tcph->th_ack)));
-	click_update_in_cksum(&tcph->th_sum, tcph->th_ack >> 16, newval >> 16);
-	click_update_in_cksum(&tcph->th_sum, tcph->th_ack, newval);
+	csum_delta += word_csum_delta(tcph->th_ack, newval);
 	tcph->th_ack = newval;
+	apply_csum_delta(&tcph->th_sum, csum_delta);
+	csum_delta = 0;
 
 	// update SACK sequence numbers
 	if (tcph->th_off > 8
@@ -220,6 +221,8 @@ TCPRewriter::TCPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 		&& *(reinterpret_cast<const uint32_t *>(tcph + 1)) != htonl(0x0101080A)))
 	    apply_sack(direction, tcph, p->transport_length());
     }
+
+    apply_csum_delta(&tcph->th_sum, csum_delta);
 }
 
 void
@@ -68,6 +68,11 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item BURST I<n>
+
+Pull inputs are served by a task that pulls up to I<n> packets from each
+input at a time. At most 256. Default is 32.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -152,6 +157,20 @@ class TCPRewriter : public IPRewriterBase { public:
 
 	void apply_sack(bool direction, click_tcp *tcp, int transport_len);
 
+	// Unfolded Internet checksum change for replacing the 32-bit word
+	// old_w with new_w.
+	static inline uint32_t word_csum_delta(uint32_t old_w, uint32_t new_w) {
+	    return (~old_w & 0xFFFF) + (~old_w >> 16)
+		+ (new_w & 0xFFFF) + (new_w >> 16);
+	}
+	static inline void apply_csum_delta(uint16_t *csum, uint32_t delta) {
+	    if (delta) {
+		uint32_t sum = (~*csum & 0xFFFF) + delta;
+		sum = (sum & 0xFFFF) + (sum >> 16);
+		*csum = ~(sum + (sum >> 16));
+	    }
+	}
+
     };
 
     TCPRewriter() CLICK_COLD;
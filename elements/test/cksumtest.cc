@@ -0,0 +1,85 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * cksumtest.{cc,hh} -- regression test element for Internet checksums
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "cksumtest.hh"
+#include <click/error.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+CksumTest::CksumTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+#define CHECK_DATA(x, y, l) CHECK(memcmp((x), (y), (l)) == 0)
+
+static uint16_t
+reference_cksum(const unsigned char *x, int len)
+{
+    uint32_t sum = 0;
+    for (; len > 1; x += 2, len -= 2) {
+	uint16_t w;
+	memcpy(&w, x, 2);
+	sum += w;
+    }
+    if (len) {
+	uint16_t w = 0;
+	*(unsigned char *) &w = *x;
+	sum += w;
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~(sum + (sum >> 16));
+}
+
+int
+CksumTest::initialize(ErrorHandler *errh)
+{
+    // Compare with the reference at every alignment and at lengths that
+    // exercise each vector and tail path.
+    unsigned char buf[2200], copy[2200];
+    for (int i = 0; i < (int) sizeof(buf); ++i)
+	buf[i] = click_random();
+    memset(buf + 1000, 0xFF, 1100);
+    for (int align = 0; align < 4; ++align)
+	for (int len = 0; len < 2100; len += (len < 300 ? 1 : 37)) {
+	    const unsigned char *x = buf + align;
+	    uint16_t want = reference_cksum(x, len);
+	    CHECK(click_in_cksum(x, len) == want);
+	    CHECK((uint16_t) ~click_in_cksum_partial(x, len, 0) == want);
+	    int half = (len / 2) & ~1;
+	    uint32_t sum = click_in_cksum_partial(x, half, 0);
+	    CHECK((uint16_t) ~click_in_cksum_partial(x + half, len - half, sum) == want);
+	    memset(copy, 0, sizeof(copy));
+	    sum = click_in_cksum_copy(copy + 3 - align, x, len, 0);
+	    CHECK((uint16_t) ~sum == want);
+	    CHECK_DATA(copy + 3 - align, x, len);
+	    CHECK(copy[3 - align + len] == 0);
+	}
+
+    // 32-bit incremental update
+    uint16_t csum = reference_cksum(buf, 20);
+    uint32_t old_w, new_w = 0x0A000001;
+    memcpy(&old_w, buf + 12, 4);
+    memcpy(buf + 12, &new_w, 4);
+    click_update_in_cksum32(&csum, old_w, new_w);
+    CHECK(csum == reference_cksum(buf, 20));
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+EXPORT_ELEMENT(CksumTest)
+CLICK_ENDDECLS
@@ -0,0 +1,35 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CKSUMTEST_HH
+#define CLICK_CKSUMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+CksumTest()
+
+=s test
+
+runs regression tests for Internet checksum functions
+
+=d
+
+CksumTest runs regression tests for click_in_cksum() and related functions at
+initialization time, comparing them with a simple reference loop at every
+alignment and at many lengths. It does not route packets.
+
+*/
+
+class CksumTest : public Element { public:
+
+    CksumTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "CksumTest"; }
+
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -19,6 +19,8 @@
 #include <click/config.h>
 #include "cryptotest.hh"
 #include <click/md5.h>
+#include <click/aes128.hh>
+#include <click/hmacsha.hh>
 #include <click/error.hh>
 CLICK_DECLS
 
@@ -52,6 +54,80 @@ md5_test(const char *s, size_t len, const char *expected_digest,
     return 0;
 }
 
+static int
+aes_test(const char *key, const char *plain, const char *cipher, size_t n,
+	 ErrorHandler *errh, const char *file, int line)
+{
+    AES128 aes(reinterpret_cast<const unsigned char *>(key));
+    size_t len = n * AES128::block_size;
+    unsigned char *x = new unsigned char[len];
+    int r = 0;
+
+    aes.encrypt_blocks(reinterpret_cast<const unsigned char *>(plain), x, n);
+    if (memcmp(x, cipher, len) != 0)
+	r = errh->error("%s:%d: bad AES encryption, got %s", file, line, String(x, len).quoted_hex().lower().substring(2, -1).c_str());
+    aes.decrypt_blocks(x, x, n);
+    if (r == 0 && memcmp(x, plain, len) != 0)
+	r = errh->error("%s:%d: bad AES decryption, got %s", file, line, String(x, len).quoted_hex().lower().substring(2, -1).c_str());
+    // single-block path
+    if (r == 0 && n > 1) {
+	aes.encrypt(reinterpret_cast<const unsigned char *>(plain) + len - 16, x);
+	if (memcmp(x, cipher + len - 16, 16) != 0)
+	    r = errh->error("%s:%d: bad single-block AES encryption", file, line);
+    }
+
+    delete[] x;
+    return r;
+}
+
+static int
+gcm_test(const char *key, const char *nonce, const char *aad, size_t aad_len,
+	 const char *plain, const char *cipher, size_t len, const char *tag,
+	 ErrorHandler *errh, const char *file, int line)
+{
+    AES128GCM gcm;
+    gcm.set_key(reinterpret_cast<const unsigned char *>(key));
+    const unsigned char *n = reinterpret_cast<const unsigned char *>(nonce);
+    const unsigned char *a = reinterpret_cast<const unsigned char *>(aad);
+    unsigned char *x = new unsigned char[len + 1];
+    unsigned char t[AES128GCM::tag_size];
+    int r = 0;
+
+    gcm.encrypt(n, a, aad_len, reinterpret_cast<const unsigned char *>(plain), x, len, t);
+    if (memcmp(x, cipher, len) != 0)
+	r = errh->error("%s:%d: bad AES-GCM encryption, got %s", file, line, String(x, len).quoted_hex().lower().substring(2, -1).c_str());
+    else if (memcmp(t, tag, AES128GCM::tag_size) != 0)
+	r = errh->error("%s:%d: bad AES-GCM tag, got %s", file, line, String(t, AES128GCM::tag_size).quoted_hex().lower().substring(2, -1).c_str());
+    else if (!gcm.decrypt(n, a, aad_len, x, x, len, t, AES128GCM::tag_size)
+	     || memcmp(x, plain, len) != 0)
+	r = errh->error("%s:%d: bad AES-GCM decryption", file, line);
+    else {
+	t[0] ^= 1;
+	if (gcm.decrypt(n, a, aad_len, x, x, len, t, AES128GCM::tag_size))
+	    r = errh->error("%s:%d: AES-GCM accepted a bad tag", file, line);
+    }
+
+    delete[] x;
+    return r;
+}
+
+template <typename H> static int
+hmac_test(const char *name, const char *key, size_t key_len,
+	  const char *data, size_t len, const char *expected_digest,
+	  ErrorHandler *errh, const char *file, int line)
+{
+    H hmac(reinterpret_cast<const unsigned char *>(key), key_len);
+    const unsigned char *d = reinterpret_cast<const unsigned char *>(data);
+    unsigned char digest[H::digest_size];
+    hmac.compute(d, len, digest);
+    if (memcmp(digest, expected_digest, H::digest_size) != 0)
+	return errh->error("%s:%d: bad %s digest, got %s", file, line, name, String(digest, H::digest_size).quoted_hex().lower().substring(2, -1).c_str());
+    digest[H::digest_size - 1] ^= 1;
+    if (!hmac.verify(d, len, digest, 12) || hmac.verify(d, len, digest, H::digest_size))
+	return errh->error("%s:%d: bad %s verification", file, line, name);
+    return 0;
+}
+
 int
 CryptoTest::initialize(ErrorHandler *errh)
 {
@@ -61,6 +137,64 @@ CryptoTest::initialize(ErrorHandler *errh)
     if (md5_test("This is a test\n", 15, "\xff\x22\x94\x13\x36\x95\x60\x98\xae\x9a\x56\x42\x89\xd1\xbf\x1b", errh, __FILE__, __LINE__) < 0)
 	return -1;
 
+    // FIPS-197 appendix C.1
+    if (aes_test("\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f", "\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff", "\x69\xc4\xe0\xd8\x6a\x7b\x04\x30\xd8\xcd\xb7\x80\x70\xb4\xc5\x5a", 1, errh, __FILE__, __LINE__) < 0)
+	return -1;
+
+    // NIST SP 800-38A F.1.1, five blocks to exercise interleaving
+    if (aes_test("\x2b\x7e\x15\x16\x28\xae\xd2\xa6\xab\xf7\x15\x88\x09\xcf\x4f\x3c",
+		 "\x6b\xc1\xbe\xe2\x2e\x40\x9f\x96\xe9\x3d\x7e\x11\x73\x93\x17\x2a"
+		 "\xae\x2d\x8a\x57\x1e\x03\xac\x9c\x9e\xb7\x6f\xac\x45\xaf\x8e\x51"
+		 "\x30\xc8\x1c\x46\xa3\x5c\xe4\x11\xe5\xfb\xc1\x19\x1a\x0a\x52\xef"
+		 "\xf6\x9f\x24\x45\xdf\x4f\x9b\x17\xad\x2b\x41\x7b\xe6\x6c\x37\x10"
+		 "\x6b\xc1\xbe\xe2\x2e\x40\x9f\x96\xe9\x3d\x7e\x11\x73\x93\x17\x2a",
+		 "\x3a\xd7\x7b\xb4\x0d\x7a\x36\x60\xa8\x9e\xca\xf3\x24\x66\xef\x97"
+		 "\xf5\xd3\xd5\x85\x03\xb9\x69\x9d\xe7\x85\x89\x5a\x96\xfd\xba\xaf"
+		 "\x43\xb1\xcd\x7f\x59\x8e\xce\x23\x88\x1b\x00\xe3\xed\x03\x06\x88"
+		 "\x7b\x0c\x78\x5e\x27\xe8\xad\x3f\x82\x23\x20\x71\x04\x72\x5d\xd4"
+		 "\x3a\xd7\x7b\xb4\x0d\x7a\x36\x60\xa8\x9e\xca\xf3\x24\x66\xef\x97",
+		 5, errh, __FILE__, __LINE__) < 0)
+	return -1;
+
+    // McGrew and Viega, "The Galois/Counter Mode of Operation", test cases 2 and 4
+    if (gcm_test("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", "", 0,
+		 "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+		 "\x03\x88\xda\xce\x60\xb6\xa3\x92\xf3\x28\xc2\xb9\x71\xb2\xfe\x78", 16,
+		 "\xab\x6e\x47\xd4\x2c\xec\x13\xbd\xf5\x3a\x67\xb2\x12\x57\xbd\xdf", errh, __FILE__, __LINE__) < 0)
+	return -1;
+    if (gcm_test("\xfe\xff\xe9\x92\x86\x65\x73\x1c\x6d\x6a\x8f\x94\x67\x30\x83\x08", "\xca\xfe\xba\xbe\xfa\xce\xdb\xad\xde\xca\xf8\x88",
+		 "\xfe\xed\xfa\xce\xde\xad\xbe\xef\xfe\xed\xfa\xce\xde\xad\xbe\xef\xab\xad\xda\xd2", 20,
+		 "\xd9\x31\x32\x25\xf8\x84\x06\xe5\xa5\x59\x09\xc5\xaf\xf5\x26\x9a\x86\xa7\xa9\x53\x15\x34\xf7\xda\x2e\x4c\x30\x3d\x8a\x31\x8a\x72"
+		 "\x1c\x3c\x0c\x95\x95\x68\x09\x53\x2f\xcf\x0e\x24\x49\xa6\xb5\x25\xb1\x6a\xed\xf5\xaa\x0d\xe6\x57\xba\x63\x7b\x39",
+		 "\x42\x83\x1e\xc2\x21\x77\x74\x24\x4b\x72\x21\xb7\x84\xd0\xd4\x9c\xe3\xaa\x21\x2f\x2c\x02\xa4\xe0\x35\xc1\x7e\x23\x29\xac\xa1\x2e"
+		 "\x21\xd5\x14\xb2\x54\x66\x93\x1c\x7d\x8f\x6a\x5a\xac\x84\xaa\x05\x1b\xa3\x0b\x39\x6a\x0a\xac\x97\x3d\x58\xe0\x91", 60,
+		 "\x5b\xc9\x4f\xbc\x32\x21\xa5\xdb\x94\xfa\xe9\x5a\xe7\x12\x1a\x47", errh, __FILE__, __LINE__) < 0)
+	return -1;
+
+    // RFC 2202 test cases 1 and 6
+    if (hmac_test<HMACSHA1>("HMAC-SHA-1", "\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b", 20,
+			   "Hi There", 8,
+			   "\xb6\x17\x31\x86\x55\x05\x72\x64\xe2\x8b\xc0\xb6\xfb\x37\x8c\x8e\xf1\x46\xbe\x00", errh, __FILE__, __LINE__) < 0)
+	return -1;
+    {
+	char key[131];
+	memset(key, 0xaa, sizeof(key));
+	if (hmac_test<HMACSHA1>("HMAC-SHA-1", key, 80,
+			       "Test Using Larger Than Block-Size Key - Hash Key First", 54,
+			       "\xaa\x4a\xe5\xe1\x52\x72\xd0\x0e\x95\x70\x56\x37\xce\x8a\x3b\x55\xed\x40\x21\x12", errh, __FILE__, __LINE__) < 0)
+	    return -1;
+
+	// RFC 4231 test cases 1 and 7
+	if (hmac_test<HMACSHA256>("HMAC-SHA-256", "\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b", 20,
+				 "Hi There", 8,
+				 "\xb0\x34\x4c\x61\xd8\xdb\x38\x53\x5c\xa8\xaf\xce\xaf\x0b\xf1\x2b\x88\x1d\xc2\x00\xc9\x83\x3d\xa7\x26\xe9\x37\x6c\x2e\x32\xcf\xf7", errh, __FILE__, __LINE__) < 0)
+	    return -1;
+	if (hmac_test<HMACSHA256>("HMAC-SHA-256", key, 131,
+				 "This is a test using a larger than block-size key and a larger than block-size data. The key needs to be hashed before being used by the HMAC algorithm.", 152,
+				 "\x9b\x09\xff\xa7\x1b\x94\x2f\xcb\x27\x63\x5f\xbc\xd5\xb0\xe9\x44\xbf\xdc\x63\x64\x4f\x07\x13\x93\x8a\x7f\x51\x53\x5c\x3a\x35\xe2", errh, __FILE__, __LINE__) < 0)
+	    return -1;
+    }
+
     errh->message("All tests pass!");
     return 0;
 }
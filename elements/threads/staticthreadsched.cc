@@ -21,6 +21,7 @@
 #include <click/router.hh>
 #include <click/error.hh>
 #include <click/args.hh>
+#include <click/routerthread.hh>
 CLICK_DECLS
 
 StaticThreadSched::StaticThreadSched()
@@ -35,6 +36,32 @@ StaticThreadSched::~StaticThreadSched()
 int
 StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    Vector<int> cpus;
+    if (Args(this, errh).bind(conf).read("CPUS", CpuListArg(), cpus).consume() < 0)
+	return -1;
+    if (cpus.size()) {
+#if CLICK_USERLEVEL
+	if (cpus.size() > master()->nthreads()) {
+	    errh->warning("CPUS: more CPUs than threads");
+	    cpus.resize(master()->nthreads());
+	}
+	// Running threads can't be moved, so a hotswap may not change them.
+	for (int i = 0; i < cpus.size(); ++i) {
+	    RouterThread *t = master()->thread(i);
+	    if (t->started() && t->cpu() != cpus[i])
+		return errh->error("CPUS: thread %d is already running, can't move it to CPU %d", i, cpus[i]);
+	}
+	for (int i = 0; i < cpus.size(); ++i) {
+	    RouterThread *t = master()->thread(i);
+	    _old_cpus.push_back(t->cpu());
+	    if (t->cpu() != cpus[i])
+		t->set_cpu(cpus[i]);
+	}
+#else
+	return errh->error("CPUS not supported in this driver");
+#endif
+    }
+
     Element *e;
     int preference;
     for (int i = 0; i < conf.size(); i++) {
@@ -56,6 +83,20 @@ StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+void
+StaticThreadSched::cleanup(CleanupStage stage)
+{
+#if CLICK_USERLEVEL
+    // undo CPUS if the router never came up
+    if (stage < CLEANUP_ROUTER_INITIALIZED)
+	for (int i = 0; i < _old_cpus.size(); ++i)
+	    if (!master()->thread(i)->started())
+		master()->thread(i)->set_cpu(_old_cpus[i]);
+#else
+    (void) stage;
+#endif
+}
+
 int
 StaticThreadSched::initial_home_thread_id(const Element *e)
 {
@@ -7,13 +7,30 @@ CLICK_DECLS
 
 /*
  * =c
- * StaticThreadSched(ELEMENT THREAD, ...)
+ * StaticThreadSched(ELEMENT THREAD, ..., I<keywords> CPUS)
  * =s threads
  * specifies element and thread scheduling parameters
  * =d
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item CPUS
+ *
+ * List of CPU numbers and ranges, such as "0,2-3", in the same form as the
+ * B<click> driver's B<--affinity> option, which it overrides.  At user level,
+ * thread I<i> is bound to the I<i>th CPU in the list; -1 leaves a thread
+ * unbound.  Elements whose home thread is bound are initialized with a
+ * preference for memory on that thread's NUMA node.  Binding takes effect
+ * when a thread starts, so a hot-swapped configuration that would move a
+ * running thread is rejected.
+ *
+ * =back
+ *
  * =a
  * ThreadMonitor, BalancedThreadSched
  */
@@ -26,12 +43,14 @@ class StaticThreadSched : public Element, public ThreadSched { public:
     const char *class_name() const	{ return "StaticThreadSched"; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
 
     int initial_home_thread_id(const Element *e);
 
   private:
 
     Vector<int> _thread_preferences;
+    Vector<int> _old_cpus;
     ThreadSched *_next_thread_sched;
 
 };
@@ -26,6 +26,7 @@
 #include <click/router.hh>
 #include <click/straccum.hh>
 #include <click/llrpc.h>
+#include <click/userutils.hh>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -33,7 +34,7 @@
 #include <fcntl.h>
 CLICK_DECLS
 
-const char ControlSocket::protocol_version[] = "1.3";
+const char ControlSocket::protocol_version[] = "1.4";
 
 class ControlSocketErrorHandler : public ErrorHandler { public:
 
@@ -305,6 +306,11 @@ ControlSocket::take_state(Element *e, ErrorHandler *errh)
     if (_socket_fd >= 0)
 	add_select(_socket_fd, SELECT_READ);
     for (connection **it = _conns.begin(); it != _conns.end(); ++it) {
+	// subscriptions name the old configuration's elements
+	if (*it && (*it)->sub_timer) {
+	    (*it)->unsubscribe();
+	    (*it)->message(CSERR_UPDATE_CANCELLED, "Subscription cancelled by hotswap");
+	}
 	if (*it && !(*it)->in_closed)
 	    add_select((*it)->fd, SELECT_READ);
 	if (*it && !(*it)->out_closed)
@@ -372,6 +378,15 @@ ControlSocket::connection::transfer_messages(int default_code, const String &msg
     return ANY_ERR;
 }
 
+void
+ControlSocket::connection::unsubscribe()
+{
+    delete sub_timer;
+    sub_timer = 0;
+    sub_elements.clear();
+    sub_hindexes.clear();
+}
+
 void
 ControlSocket::connection::contract(StringAccum &sa, int &pos)
 {
@@ -676,6 +691,186 @@ ControlSocket::llrpc_command(connection &conn, const String &llrpcname, String d
   return 0;
 }
 
+static bool
+has_wildcards(const String &pattern)
+{
+    for (const char *s = pattern.begin(); s != pattern.end(); ++s)
+	if (*s == '*' || *s == '?' || *s == '[')
+	    return true;
+    return false;
+}
+
+static void
+add_matching_handlers(Element *e, const String &hpattern,
+		      Vector<Element *> &elements, Vector<int> &hindexes)
+{
+    // cheap handlers only, unless asked for by name
+    int skip_flags = has_wildcards(hpattern) ? Handler::h_deprecated | Handler::h_expensive : 0;
+    Vector<int> hv;
+    Router::element_hindexes(e, hv);
+    for (int *it = hv.begin(); it != hv.end(); ++it) {
+	const Handler *h = Router::handler(e->router(), *it);
+	if (h && h->read_visible() && !(h->flags() & skip_flags)
+	    && glob_match(h->name(), hpattern)) {
+	    elements.push_back(e);
+	    hindexes.push_back(*it);
+	}
+    }
+}
+
+int
+ControlSocket::match_handlers(connection &conn, const String *first, const String *last,
+			      Vector<Element *> &elements, Vector<int> &hindexes)
+{
+    if (_proxy)
+	return conn.message(CSERR_UNIMPLEMENTED, "Handler patterns unsupported with PROXY");
+    for (; first != last; ++first) {
+	String pattern = canonical_handler_name(*first);
+	const char *dot = find(pattern, '.');
+	if (dot == pattern.end())
+	    add_matching_handlers(router()->root_element(), pattern, elements, hindexes);
+	else {
+	    String epattern = pattern.substring(pattern.begin(), dot);
+	    String hpattern = pattern.substring(dot + 1, pattern.end());
+	    for (int i = 0; i < router()->nelements(); ++i)
+		if (glob_match(router()->element(i)->name(), epattern))
+		    add_matching_handlers(router()->element(i), hpattern, elements, hindexes);
+	}
+    }
+    return 0;
+}
+
+static void
+append_binary(StringAccum &sa, uint64_t x, int nbytes)
+{
+    while (--nbytes >= 0)
+	sa << (char) (x >> (8 * nbytes));
+}
+
+// Returns true if s is a decimal integer that fits in an int64_t.
+static bool
+parse_decimal(const String &s, int64_t &result)
+{
+    const char *p = s.begin(), *end = s.end();
+    bool negative = (p != end && *p == '-');
+    if (negative)
+	++p;
+    if (p == end || end - p > 18)
+	return false;
+    int64_t x = 0;
+    for (; p != end; ++p)
+	if (*p >= '0' && *p <= '9')
+	    x = 10 * x + (*p - '0');
+	else
+	    return false;
+    result = negative ? -x : x;
+    return true;
+}
+
+String
+ControlSocket::read_many(const connection &conn, bool names, bool values,
+			 const Vector<Element *> &elements, const Vector<int> &hindexes)
+{
+    StringAccum sa;
+    for (int i = 0; i < hindexes.size(); ++i) {
+	const Handler *h = Router::handler(router(), hindexes[i]);
+	String value;
+	if (values) {
+	    ControlSocketErrorHandler errh;
+	    value = h->call_read(elements[i], String(), &errh);
+	    // READMANY leaves out errors; updates keep their order
+	    if (errh.nerrors() > 0 && names)
+		continue;
+	}
+
+	if (names) {
+	    String name = h->name();
+	    if (elements[i] != router()->root_element())
+		name = elements[i]->name() + "." + name;
+	    if (conn.binary) {
+		append_binary(sa, name.length(), 2);
+		sa << name;
+	    } else if (values)
+		sa << name << ' ' << value.length() << '\r' << '\n';
+	    else
+		sa << name << '\r' << '\n';
+	}
+
+	if (values) {
+	    int64_t x;
+	    if (!conn.binary) {
+		if (!names)
+		    sa << value.length() << '\r' << '\n';
+		sa << value << '\r' << '\n';
+	    } else if (parse_decimal(value, x)) {
+		sa << (char) 1;
+		append_binary(sa, x, 8);
+	    } else {
+		sa << (char) 0;
+		append_binary(sa, value.length(), 4);
+		sa << value;
+	    }
+	}
+    }
+    return sa.take_string();
+}
+
+int
+ControlSocket::readmany_command(connection &conn, const Vector<String> &words)
+{
+    Vector<Element *> elements;
+    Vector<int> hindexes;
+    if (match_handlers(conn, words.begin() + 1, words.end(), elements, hindexes) < 0)
+	return ANY_ERR;
+    String data = read_many(conn, true, true, elements, hindexes);
+    conn.message(CSERR_OK, "Read " + String(hindexes.size()) + " handlers OK");
+    conn.out_text << "DATA " << data.length() << '\r' << '\n' << data;
+    return 0;
+}
+
+int
+ControlSocket::subscribe_command(connection &conn, const Vector<String> &words)
+{
+    uint32_t interval;
+    if (!IntArg().parse(words[1], interval) || interval == 0)
+	return conn.message(CSERR_SYNTAX, "Syntax error in interval");
+    Vector<Element *> elements;
+    Vector<int> hindexes;
+    if (match_handlers(conn, words.begin() + 2, words.end(), elements, hindexes) < 0)
+	return ANY_ERR;
+
+    conn.unsubscribe();
+    conn.sub_elements.swap(elements);
+    conn.sub_hindexes.swap(hindexes);
+    conn.sub_interval = interval;
+    conn.sub_seq = 0;
+    conn.sub_timer = new Timer(subscribe_hook, &conn);
+    conn.sub_timer->initialize(this);
+    conn.sub_timer->schedule_after_msec(interval);
+
+    String data = read_many(conn, true, false, conn.sub_elements, conn.sub_hindexes);
+    conn.message(CSERR_OK, "Subscribed to " + String(conn.sub_hindexes.size()) + " handlers");
+    conn.out_text << "DATA " << data.length() << '\r' << '\n' << data;
+    return 0;
+}
+
+void
+ControlSocket::subscribe_hook(Timer *t, void *user_data)
+{
+    connection *conn = static_cast<connection *>(user_data);
+    ControlSocket *cs = static_cast<ControlSocket *>(t->element());
+    ++conn->sub_seq;
+    if (!conn->out_closed
+	&& conn->out_text.length() - conn->outpos <= max_update_backlog) {
+	String data = cs->read_many(*conn, false, true, conn->sub_elements, conn->sub_hindexes);
+	conn->message(CSERR_UPDATE, "Update " + String(conn->sub_seq));
+	conn->out_text << "DATA " << data.length() << '\r' << '\n' << data;
+	// selected() will write it out
+	cs->add_select(conn->fd, SELECT_WRITE);
+    }
+    t->reschedule_after_msec(conn->sub_interval);
+}
+
 int
 ControlSocket::parse_command(connection &conn, const String &line)
 {
@@ -754,6 +949,31 @@ ControlSocket::parse_command(connection &conn, const String &line)
       else
 	  return write_command(conn, words[1], data);
 
+  } else if (command == "READMANY") {
+      if (words.size() < 2)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return readmany_command(conn, words);
+
+  } else if (command == "SUBSCRIBE") {
+      if (words.size() < 3)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return subscribe_command(conn, words);
+
+  } else if (command == "UNSUBSCRIBE") {
+      if (words.size() != 1)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      conn.unsubscribe();
+      conn.message(CSERR_OK, "Unsubscribed");
+      return 0;
+
+  } else if (command == "ENCODING") {
+      String encoding = (words.size() == 2 ? words[1].upper() : String());
+      if (encoding != "TEXT" && encoding != "BINARY")
+	  return conn.message(CSERR_SYNTAX, "Expected 'ENCODING TEXT' or 'ENCODING BINARY'");
+      conn.binary = (encoding == "BINARY");
+      conn.message(CSERR_OK, "Encoding " + encoding);
+      return 0;
+
   } else if (command == "CHECKREAD" || command == "CHECKWRITE") {
       if (words.size() != 2)
 	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
@@ -787,6 +1007,10 @@ ControlSocket::parse_command(connection &conn, const String &line)
     conn.message(CSERR_OK, "WRITE handler [arg...]  call write handler", true);
     conn.message(CSERR_OK, "WRITEDATA handler len   call write handler, pass len data bytes", true);
     conn.message(CSERR_OK, "WRITEUNTIL handler term call write handler, take data until term", true);
+    conn.message(CSERR_OK, "READMANY pattern...     call matching read handlers, return DATA", true);
+    conn.message(CSERR_OK, "SUBSCRIBE msec pattern... send matching read handlers' results every msec", true);
+    conn.message(CSERR_OK, "UNSUBSCRIBE             stop sending results", true);
+    conn.message(CSERR_OK, "ENCODING TEXT|BINARY    set READMANY and SUBSCRIBE encoding", true);
     conn.message(CSERR_OK, "CHECKREAD handler       check if read handler is valid", true);
     conn.message(CSERR_OK, "CHECKWRITE handler      check if write handler is valid", true);
     conn.message(CSERR_OK, "LLRPC elt#number [len]  call LLRPC, pass len data bytes, return DATA", true);
@@ -39,8 +39,8 @@ The server will accept lines terminated by CR, LF, or CRLF. Its response
 lines are always terminated by CRLF.
 
 When a connection is opened, the server responds by stating its protocol
-version number with a line like "Click::ControlSocket/1.3". The current
-version number is 1.3. Changes in minor version number will only add commands
+version number with a line like "Click::ControlSocket/1.4". The current
+version number is 1.4. Changes in minor version number will only add commands
 and functionality to this specification, not change existing functionality.
 
 ControlSocket supports hot-swapping, meaning you can change configurations
@@ -150,6 +150,53 @@ following (the CRLF that terminates) the WRITEDATA line.
 Call a write I<handler>. The arguments to pass are the read from the input
 stream, stopping at the first line that equals I<terminator>.
 
+=item READMANY I<pattern...>
+
+Call every read handler whose name matches one of the I<pattern>s and return
+all the results at once, with "DATA I<n>" as in the READ command. Each
+I<pattern> has the form C<I<elementpattern>.I<handlerpattern>>, or just
+C<I<handlerpattern>> for global handlers, where the patterns may contain
+shell-style wildcards (C<*>, C<?>, C<[...]>). For example, C<*.count> reads
+every Counter's count. Deprecated handlers and handlers that are expensive to
+call, such as C<config>, are matched only by patterns without wildcards.
+Handlers that report errors are left out of the results. The data is
+encoded as set by the ENCODING command; with the default text encoding,
+each handler's result is a line "I<handler> I<len>", followed by the I<len>
+bytes of the result and CRLF. Introduced in version 1.4 of the ControlSocket
+protocol.
+
+=item SUBSCRIBE I<interval> I<pattern...>
+
+Subscribe to the read handlers matching the I<pattern>s, as for READMANY.
+The matching handlers are found once, and their names are returned with
+"DATA I<n>"; in the text encoding, the data has one handler name per line.
+Then every I<interval> milliseconds, until the connection closes or the
+client sends UNSUBSCRIBE or another SUBSCRIBE, the server calls those
+handlers and sends their results without being asked: an update message
+"250 Update I<seq>", where I<seq> counts intervals from 1, followed by
+"DATA I<n>". Update data gives just the results, in the order of the names
+returned by SUBSCRIBE; in the text encoding, each result is a line "I<len>"
+followed by I<len> bytes and CRLF. Updates never interrupt the response to
+a command. They are skipped while the client is more than 64KB behind in
+reading, which shows as a gap in I<seq>. Hot-swapping the configuration
+cancels subscriptions with a "251" message. Introduced in version 1.4 of the ControlSocket protocol.
+
+=item UNSUBSCRIBE
+
+Cancel the connection's subscription, if any.
+
+=item ENCODING I<encoding>
+
+Set the encoding of READMANY and SUBSCRIBE data for this connection, either
+C<TEXT> (the default) or C<BINARY>. In the binary encoding, integers are in
+network byte order. A handler name is a 2-byte length followed by the name.
+A result is a type byte followed by the value: type 1 means the result was
+a decimal integer, and is followed by its 8-byte two's-complement value;
+type 0 means any other result, and is followed by a 4-byte length and the
+result's bytes. READMANY data is a sequence of name-and-result pairs;
+SUBSCRIBE returns a sequence of names, and its updates a sequence of
+results. Introduced in version 1.4 of the ControlSocket protocol.
+
 =item CHECKREAD I<handler>
 
 Checks whether a I<handler> exists and is readable. The return status is 200
@@ -197,6 +244,8 @@ Here are some of the particular error messages:
 
   200 OK.
   220 OK, but the handler reported some warnings.
+  250 Subscription update.
+  251 Subscription cancelled.
   500 Syntax error.
   501 Unimplemented command.
   510 No such element.
@@ -241,6 +290,8 @@ class ControlSocket : public Element { public:
     enum {
 	CSERR_OK			= HandlerProxy::CSERR_OK,	       // 200
 	CSERR_OK_HANDLER_WARNING	= 220,
+	CSERR_UPDATE			= 250,
+	CSERR_UPDATE_CANCELLED		= 251,
 	CSERR_SYNTAX			= HandlerProxy::CSERR_SYNTAX,          // 500
 	CSERR_UNIMPLEMENTED		= 501,
 	CSERR_NO_SUCH_ELEMENT		= HandlerProxy::CSERR_NO_SUCH_ELEMENT, // 510
@@ -275,10 +326,22 @@ class ControlSocket : public Element { public:
 	int outpos;
 	bool in_closed;
 	bool out_closed;
+	bool binary;
+	// SUBSCRIBE state
+	Timer *sub_timer;
+	uint32_t sub_interval;
+	uint32_t sub_seq;
+	Vector<Element *> sub_elements;
+	Vector<int> sub_hindexes;
 	connection(int fd_)
 	    : fd(fd_), inpos(0), outpos(0),
-	      in_closed(false), out_closed(false) {
+	      in_closed(false), out_closed(false), binary(false),
+	      sub_timer(0) {
+	}
+	~connection() {
+	    unsubscribe();
 	}
+	void unsubscribe();
 	int message(int code, const String &msg, bool continuation = false);
 	int transfer_messages(int default_code, const String &msg, ControlSocketErrorHandler *);
 	static void contract(StringAccum &sa, int &pos);
@@ -295,6 +358,7 @@ class ControlSocket : public Element { public:
     Timer *_retry_timer;
 
     enum { READ_CLOSED = 1, WRITE_CLOSED = 2, ANY_ERR = -1 };
+    enum { max_update_backlog = 65536 };
 
     static const char protocol_version[];
 
@@ -309,6 +373,13 @@ class ControlSocket : public Element { public:
     int write_command(connection &conn, const String &, String);
     int check_command(connection &conn, const String &, bool write);
     int llrpc_command(connection &conn, const String &, String);
+    int match_handlers(connection &conn, const String *first, const String *last,
+		       Vector<Element *> &elements, Vector<int> &hindexes);
+    String read_many(const connection &conn, bool names, bool values,
+		     const Vector<Element *> &elements, const Vector<int> &hindexes);
+    int readmany_command(connection &conn, const Vector<String> &words);
+    int subscribe_command(connection &conn, const Vector<String> &words);
+    static void subscribe_hook(Timer *, void *);
     int parse_command(connection &conn, const String &);
 
     static ErrorHandler *proxy_error_function(const String &, void *);
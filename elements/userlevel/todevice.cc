@@ -388,6 +388,7 @@ ToDevice::run_task(Task *)
 	} else
 	    break;
     } while (count < _burst);
+    _task.add_work(count);
 
     if (r == -ENOBUFS || r == -EAGAIN) {
 	assert(!_q);
@@ -0,0 +1,177 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/aes128.cc" -*-
+#ifndef CLICK_AES128_HH
+#define CLICK_AES128_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @file <click/aes128.hh>
+ * @brief The AES-128 block cipher and AES-128-GCM. */
+
+/** @class AES128
+  @brief An AES-128 key schedule.
+
+  An AES128 object holds the expanded encryption and decryption round keys
+  for one 128-bit key. Set the key once with set_key(), then encrypt or
+  decrypt any number of 16-byte blocks; the object is not modified by
+  encryption, so several threads may share it.
+
+  At user level on x86 processors that support the AES-NI instructions,
+  blocks are processed in hardware; encrypt_blocks() and decrypt_blocks()
+  interleave several independent blocks to hide instruction latency. Other
+  configurations use a table-driven software implementation. Both produce
+  identical results; hardware_accelerated() reports which is in use. */
+class AES128 { public:
+
+    enum {
+	block_size = 16,	///< Block size in bytes
+	key_size = 16,		///< Key size in bytes
+	nrounds = 10		///< Number of rounds
+    };
+
+    /** @brief Construct an AES128 object with an all-zero key. */
+    AES128();
+
+    /** @brief Construct an AES128 object with key @a key.
+     * @param key key_size bytes of key */
+    explicit AES128(const unsigned char *key) {
+	set_key(key);
+    }
+
+    /** @brief Set the key to @a key.
+     * @param key key_size bytes of key */
+    void set_key(const unsigned char *key);
+
+    /** @brief Encrypt one block.
+     * @param in block_size bytes of plaintext
+     * @param[out] out block_size bytes of ciphertext
+     *
+     * @a in and @a out may be the same. */
+    inline void encrypt(const unsigned char *in, unsigned char *out) const {
+	encrypt_blocks(in, out, 1);
+    }
+
+    /** @brief Decrypt one block.
+     * @param in block_size bytes of ciphertext
+     * @param[out] out block_size bytes of plaintext
+     *
+     * @a in and @a out may be the same. */
+    inline void decrypt(const unsigned char *in, unsigned char *out) const {
+	decrypt_blocks(in, out, 1);
+    }
+
+    /** @brief Encrypt @a n consecutive blocks independently (ECB mode).
+     * @param in n * block_size bytes of plaintext
+     * @param[out] out n * block_size bytes of ciphertext
+     * @param n number of blocks
+     *
+     * @a in and @a out may be the same, but must not otherwise overlap. */
+    void encrypt_blocks(const unsigned char *in, unsigned char *out,
+			size_t n) const;
+
+    /** @brief Decrypt @a n consecutive blocks independently (ECB mode).
+     * @param in n * block_size bytes of ciphertext
+     * @param[out] out n * block_size bytes of plaintext
+     * @param n number of blocks
+     *
+     * @a in and @a out may be the same, but must not otherwise overlap. */
+    void decrypt_blocks(const unsigned char *in, unsigned char *out,
+			size_t n) const;
+
+    /** @brief Return true iff blocks are encrypted with AES-NI
+     * instructions. */
+    static bool hardware_accelerated();
+
+  private:
+
+    // Round keys in FIPS-197 byte order. _dk holds the round keys for the
+    // equivalent inverse cipher, in the order they are used.
+    unsigned char _ek[(nrounds + 1) * block_size] CLICK_ALIGNED(16);
+    unsigned char _dk[(nrounds + 1) * block_size] CLICK_ALIGNED(16);
+
+    static void static_initialize();
+
+};
+
+
+/** @class AES128GCM
+  @brief An AES-128-GCM authenticated encryption context.
+
+  An AES128GCM object holds an AES-128 key schedule and the derived GHASH
+  key for Galois/Counter Mode (NIST SP 800-38D) with 96-bit nonces, as used
+  by ESP (RFC 4106). Like AES128, it is not modified by encryption or
+  decryption and can be shared among threads.
+
+  Where the processor supports them, GHASH uses the PCLMULQDQ carry-less
+  multiply instruction and the counter-mode keystream uses AES-NI, several
+  blocks at a time. Otherwise a 4-bit table-driven GHASH is used. */
+class AES128GCM { public:
+
+    enum {
+	nonce_size = 12,	///< Nonce (IV) size in bytes
+	tag_size = 16		///< Maximum authentication tag size in bytes
+    };
+
+    /** @brief Construct an AES128GCM object with an all-zero key. */
+    AES128GCM();
+
+    /** @brief Set the key to @a key.
+     * @param key AES128::key_size bytes of key */
+    void set_key(const unsigned char *key);
+
+    /** @brief Encrypt and authenticate.
+     * @param nonce nonce_size bytes of nonce; must never repeat for a key
+     * @param aad additional authenticated data
+     * @param aad_len length of @a aad
+     * @param in plaintext
+     * @param[out] out ciphertext, which may equal @a in
+     * @param len length of @a in and @a out
+     * @param[out] tag tag_size bytes of authentication tag */
+    void encrypt(const unsigned char *nonce,
+		 const unsigned char *aad, size_t aad_len,
+		 const unsigned char *in, unsigned char *out, size_t len,
+		 unsigned char *tag) const;
+
+    /** @brief Authenticate and decrypt.
+     * @param nonce nonce_size bytes of nonce
+     * @param aad additional authenticated data
+     * @param aad_len length of @a aad
+     * @param in ciphertext
+     * @param[out] out plaintext, which may equal @a in
+     * @param len length of @a in and @a out
+     * @param tag authentication tag
+     * @param tag_len length of @a tag, at most tag_size
+     * @return true if the tag was valid
+     *
+     * The ciphertext is authenticated before it is decrypted; if the tag is
+     * invalid, @a out is not written. */
+    bool decrypt(const unsigned char *nonce,
+		 const unsigned char *aad, size_t aad_len,
+		 const unsigned char *in, unsigned char *out, size_t len,
+		 const unsigned char *tag, size_t tag_len) const;
+
+    /** @brief Return the underlying block cipher. */
+    const AES128 &cipher() const {
+	return _aes;
+    }
+
+    /** @brief Return true iff GHASH uses carry-less multiply
+     * instructions. */
+    static bool hardware_accelerated();
+
+  private:
+
+    AES128 _aes;
+    unsigned char _h[AES128::block_size] CLICK_ALIGNED(16);
+    uint64_t _hl[16];		// 4-bit multiplication tables for H
+    uint64_t _hh[16];
+
+    void ghash(unsigned char *y, const unsigned char *data, size_t len) const;
+    void ghash_lengths(unsigned char *y, size_t aad_len, size_t len) const;
+    void gmult(unsigned char *y) const;
+    void ctr(const unsigned char *j0, const unsigned char *in,
+	     unsigned char *out, size_t len) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
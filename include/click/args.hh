@@ -1382,6 +1382,17 @@ class FilenameArg { public:
 #endif
 
 
+/** @class CpuListArg
+  @brief Parser class for lists of processor numbers.
+
+  Accepts numbers and ranges separated by commas or spaces, such as
+  "0,2-3 8", and stores them in order: here, 0, 2, 3, 8.  The number -1
+  stands for "no processor". */
+class CpuListArg { public:
+    static bool parse(const String &str, Vector<int> &result, const ArgContext &args = blank_args);
+};
+
+
 #if !CLICK_TOOL
 /** @class ElementArg
   @brief Parser class for elements. */
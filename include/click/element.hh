@@ -92,6 +92,7 @@ class Element { public:
 
     virtual void take_state(Element *old_element, ErrorHandler *errh);
     virtual Element *hotswap_element() const;
+    virtual bool can_keep_across_hotswap() const;
 
     enum CleanupStage {
 	CLEANUP_NO_ROUTER,
@@ -170,8 +171,9 @@ class Element { public:
     enum { TASKHANDLER_WRITE_SCHEDULED = 1,
 	   TASKHANDLER_WRITE_TICKETS = 2,
 	   TASKHANDLER_WRITE_HOME_THREAD = 4,
-	   TASKHANDLER_WRITE_ALL = 7,
-	   TASKHANDLER_DEFAULT = 6 };
+	   TASKHANDLER_WRITE_LATENCY_CLASS = 8,
+	   TASKHANDLER_WRITE_ALL = 15,
+	   TASKHANDLER_DEFAULT = 14 };
     void add_task_handlers(Task *task, NotifierSignal *signal, int flags, const String &prefix = String());
     inline void add_task_handlers(Task *task, NotifierSignal *signal, const String &prefix = String()) {
 	add_task_handlers(task, signal, TASKHANDLER_DEFAULT, prefix);
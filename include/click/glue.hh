@@ -380,6 +380,13 @@ click_invalid_processor()
 
 #if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
 extern __thread int click_current_thread_id;
+extern __thread int click_current_numa_node;
+#endif
+
+#if CLICK_USERLEVEL
+int click_set_thread_cpu(int cpu);
+int click_cpu_numa_node(int cpu);
+int click_prefer_numa_node(int node);
 #endif
 
 
@@ -432,6 +432,23 @@ class HandlerCall { public:
 	    _value = value;
     }
 
+    /** @brief  Set this HandlerCall to call an already known handler.
+     *  @param  e      relevant element, or a root element for a global handler
+     *  @param  h      handler
+     *  @param  value  write handler value and/or read handler parameters
+     *  @param  flags  zero or more of OP_READ and OP_WRITE
+     *  @param  errh   optional error handler
+     *  @return 0 on success, -ENOENT or -EINVAL on failure
+     *
+     *  Like initialize(), but skips the search for the element and handler.
+     *  Callers that make the same call repeatedly can remember the element()
+     *  and handler() of a successfully initialized HandlerCall and reuse them
+     *  here.  Checks that @a h supports the operations in @a flags and, for
+     *  read handlers, that it takes parameters if @a value is nonempty.  On
+     *  failure the HandlerCall is not changed. */
+    int assign(Element *e, const Handler *h, const String &value, int flags,
+	       ErrorHandler *errh = 0);
+
     /** @brief  Return a String that will parse into an equivalent HandlerCall.
      *
      *  Will work even if the HandlerCall has not been initialized. */
@@ -136,6 +136,24 @@ class HashContainer { public:
     /** @brief Return the bucket number containing elements with @a key. */
     size_type bucket(const key_type &key) const;
 
+    /** @brief Prefetch the head of bucket @a n.
+     *
+     * A burst of lookups runs faster in stages: first prefetch each key's
+     * bucket head, then prefetch each bucket's first element with
+     * prefetch_bucket_element(), and only then call find() or get(). */
+    inline void prefetch_bucket(size_type n) const {
+	click_hash_assert(n < _rep.nbuckets);
+	click_prefetch(&_rep.buckets[n]);
+    }
+
+    /** @brief Prefetch the first element in bucket @a n, if any.
+     * @sa prefetch_bucket() */
+    inline void prefetch_bucket_element(size_type n) const {
+	click_hash_assert(n < _rep.nbuckets);
+	if (T *element = _rep.buckets[n])
+	    click_prefetch(element);
+    }
+
     /** @brief Return true if this HashContainer should be rebalanced. */
     inline bool unbalanced() const {
 	return _rep.size > 2 * _rep.nbuckets && _rep.nbuckets < max_bucket_count;
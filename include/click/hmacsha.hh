@@ -0,0 +1,144 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/hmacsha.cc" -*-
+#ifndef CLICK_HMACSHA_HH
+#define CLICK_HMACSHA_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @file <click/hmacsha.hh>
+ * @brief HMAC-SHA-1 and HMAC-SHA-256 with precomputed key pads. */
+
+/** @class HMACSHA1
+  @brief An HMAC-SHA-1 key (RFC 2104).
+
+  An HMACSHA1 object holds the SHA-1 chaining state after the inner and outer
+  key pads have been hashed. Computing a MAC therefore hashes only the
+  message and one outer block; the pads are not rehashed for every message.
+  The object is not modified by compute() or verify(), so several threads
+  may share it.
+
+  At user level on x86 processors that support the SHA extensions (SHA-NI),
+  the compression function runs in hardware. Other configurations use a
+  portable implementation. Both produce identical results;
+  hardware_accelerated() reports which is in use. */
+class HMACSHA1 { public:
+
+    enum {
+	digest_size = 20,	///< Digest size in bytes
+	block_size = 64		///< Hash block size in bytes
+    };
+
+    /** @brief Construct an HMACSHA1 object with an empty key. */
+    HMACSHA1() {
+	set_key(0, 0);
+    }
+
+    /** @brief Construct an HMACSHA1 object with key @a key.
+     * @param key key bytes
+     * @param len length of @a key */
+    HMACSHA1(const unsigned char *key, size_t len) {
+	set_key(key, len);
+    }
+
+    /** @brief Set the key to @a key.
+     * @param key key bytes
+     * @param len length of @a key
+     *
+     * Keys longer than block_size are hashed first, as RFC 2104 requires. */
+    void set_key(const unsigned char *key, size_t len);
+
+    /** @brief Compute the MAC of a message.
+     * @param data message
+     * @param len length of @a data
+     * @param[out] digest MAC
+     * @param digest_len number of MAC bytes to write, at most digest_size
+     *
+     * A truncated MAC, such as HMAC-SHA-1-96, is the first @a digest_len
+     * bytes of the full MAC. */
+    void compute(const unsigned char *data, size_t len,
+		 unsigned char *digest, size_t digest_len = digest_size) const;
+
+    /** @brief Check the MAC of a message.
+     * @param data message
+     * @param len length of @a data
+     * @param mac expected MAC
+     * @param mac_len length of @a mac, at most digest_size
+     * @return true iff @a mac matches
+     *
+     * The comparison takes the same time wherever the MACs differ. */
+    bool verify(const unsigned char *data, size_t len,
+		const unsigned char *mac, size_t mac_len) const;
+
+    /** @brief Return true iff the compression function uses SHA-NI
+     * instructions. */
+    static bool hardware_accelerated();
+
+  private:
+
+    uint32_t _istate[5];
+    uint32_t _ostate[5];
+
+};
+
+
+/** @class HMACSHA256
+  @brief An HMAC-SHA-256 key (RFC 2104, RFC 4231).
+
+  HMACSHA256 is the SHA-256 counterpart of HMACSHA1, with the same
+  interface. Truncating its MAC to 16 bytes gives HMAC-SHA-256-128, the ESP
+  and AH integrity algorithm of RFC 4868. */
+class HMACSHA256 { public:
+
+    enum {
+	digest_size = 32,	///< Digest size in bytes
+	block_size = 64		///< Hash block size in bytes
+    };
+
+    /** @brief Construct an HMACSHA256 object with an empty key. */
+    HMACSHA256() {
+	set_key(0, 0);
+    }
+
+    /** @brief Construct an HMACSHA256 object with key @a key.
+     * @param key key bytes
+     * @param len length of @a key */
+    HMACSHA256(const unsigned char *key, size_t len) {
+	set_key(key, len);
+    }
+
+    /** @brief Set the key to @a key.
+     * @param key key bytes
+     * @param len length of @a key
+     *
+     * Keys longer than block_size are hashed first, as RFC 2104 requires. */
+    void set_key(const unsigned char *key, size_t len);
+
+    /** @brief Compute the MAC of a message.
+     * @param data message
+     * @param len length of @a data
+     * @param[out] digest MAC
+     * @param digest_len number of MAC bytes to write, at most digest_size */
+    void compute(const unsigned char *data, size_t len,
+		 unsigned char *digest, size_t digest_len = digest_size) const;
+
+    /** @brief Check the MAC of a message.
+     * @param data message
+     * @param len length of @a data
+     * @param mac expected MAC
+     * @param mac_len length of @a mac, at most digest_size
+     * @return true iff @a mac matches */
+    bool verify(const unsigned char *data, size_t len,
+		const unsigned char *mac, size_t mac_len) const;
+
+    /** @brief Return true iff the compression function uses SHA-NI
+     * instructions. */
+    static bool hardware_accelerated();
+
+  private:
+
+    uint32_t _istate[8];
+    uint32_t _ostate[8];
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -172,6 +172,42 @@ TimerSet::next_timer_delay(bool more_tasks, Timestamp &t) const
 }
 #endif
 
+#if CLICK_USERLEVEL
+/** @brief Return whether the driver should poll for events without blocking.
+ *
+ * Normally the driver polls while any task is scheduled.  With adaptive
+ * polling, it polls for busy_poll() after the last useful work, whether or
+ * not tasks are scheduled, and not after that. */
+inline bool
+RouterThread::should_poll() const
+{
+    if (!_busy_poll)
+	return active();
+    return Timestamp::now_steady() - _last_work < _busy_poll;
+}
+
+/** @brief Return how long the driver should wait for events.
+ * @param[out] t set to the delay when the result is positive
+ * @return 0 to poll, > 0 to wait for @a t, < 0 to block
+ *
+ * Like TimerSet::next_timer_delay(), but with adaptive polling, a thread
+ * whose scheduled tasks have stopped doing work sleeps for at most
+ * idle_poll_msec between runs rather than spinning. */
+inline int
+RouterThread::next_os_delay(Timestamp &t) const
+{
+    int delay_type = _timers.next_timer_delay(should_poll(), t);
+    if (delay_type != 0 && active()) {
+	Timestamp idle_poll = Timestamp::make_msec(idle_poll_msec);
+	if (delay_type < 0 || t > idle_poll) {
+	    t = idle_poll;
+	    delay_type = 1;
+	}
+    }
+    return delay_type;
+}
+#endif
+
 inline void
 Master::request_stop()
 {
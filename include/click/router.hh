@@ -90,6 +90,14 @@ class Router { public:
     inline void set_thread_sched(ThreadSched* scheduler);
     inline int home_thread_id(const Element *e) const;
 
+    // LOAD TIMES
+    enum {
+	load_parse, load_hookup, load_configure, load_handlers,
+	load_initialize, load_take_state, nload_phases
+    };
+    inline const Timestamp &load_time(int phase) const;
+    inline void set_load_time(int phase, const Timestamp &t);
+
     /** @cond never */
     // Needs to be public for NameInfo, but not useful outside
     inline NameInfo* name_info() const;
@@ -288,6 +296,8 @@ class Router { public:
     notifier_signals_t *_notifier_signals;
     HashMap_ArenaFactory* _arena_factory;
     Router* _hotswap_router;
+    Vector<int> _hotswap_kept;		// old eindex of each kept element, or -1
+    Vector<Element*> _hotswap_standins;	// new elements replaced by kept ones
     ThreadSched* _thread_sched;
     mutable NameInfo* _name_info;
     Vector<int> _flow_code_override_eindex;
@@ -295,6 +305,8 @@ class Router { public:
 
     Router* _next_router;
 
+    Timestamp _load_times[nload_phases];
+
 #if CLICK_LINUXMODULE
     Vector<struct module*> _modules;
 #endif
@@ -325,6 +337,13 @@ class Router { public:
 
     int hard_home_thread_id(const Element *e) const;
 
+    inline bool hotswap_kept(int eindex) const {
+	return _hotswap_kept.size() && _hotswap_kept[eindex] >= 0;
+    }
+    void hotswap_keep_elements();
+    void hotswap_return_elements();
+    void hotswap_take_elements();
+
     int element_lerror(ErrorHandler*, Element*, const char*, ...) const;
 
     // private handler methods
@@ -451,6 +470,24 @@ Router::home_thread_id(const Element *e) const
 	return hard_home_thread_id(e);
 }
 
+/** @brief  Return how long loading phase @a phase took.
+ *
+ * @a phase is one of load_parse, load_hookup, load_configure, load_handlers,
+ * load_initialize, and load_take_state.  The parse time is set by the driver
+ * that parsed the configuration, and the take_state time by activate() on a
+ * hotswap; the others are set by initialize(). */
+inline const Timestamp &
+Router::load_time(int phase) const
+{
+    return _load_times[phase];
+}
+
+inline void
+Router::set_load_time(int phase, const Timestamp &t)
+{
+    _load_times[phase] = t;
+}
+
 /** @cond never */
 /** @brief  Return the NameInfo object for this router, if it exists.
  *
@@ -588,6 +625,10 @@ Router::arena_factory() const
  * return the currently-installed router that this router will eventually
  * replace (assuming error-free initialization).  Otherwise, hotswap_router()
  * will return 0.
+ *
+ * Unchanged elements of the hotswap router are moved into this router by
+ * initialize(), rather than being configured anew; they belong to this router
+ * from then on, and go back to the hotswap router if initialization fails.
  */
 inline Router*
 Router::hotswap_router() const
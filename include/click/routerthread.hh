@@ -77,6 +77,29 @@ class RouterThread { public:
 
 #if CLICK_USERLEVEL
     inline void run_signals();
+
+    /** @brief Return how long the thread busy-polls after useful work.
+     *
+     * Zero means adaptive polling is off: the thread polls whenever a task
+     * is scheduled and blocks otherwise. */
+    Timestamp busy_poll() const		{ return _busy_poll; }
+    void set_busy_poll(const Timestamp &t)	{ _busy_poll = t; }
+
+    Timestamp busy_time() const;
+    Timestamp idle_time() const		{ return _idle_time; }
+    uint64_t nwakeups() const		{ return _nwakeups; }
+    Timestamp wakeup_latency() const	{ return _wakeup_latency; }
+    Timestamp max_wakeup_latency() const { return _max_wakeup_latency; }
+
+    /** @brief Return the processor this thread is bound to, or -1.
+     *
+     * The binding takes effect when the thread starts running its driver. */
+    int cpu() const			{ return _cpu; }
+    void set_cpu(int cpu);
+    /** @brief Return true iff the thread has started running its driver. */
+    bool started() const		{ return _driver_start; }
+    /** @brief Return the NUMA node of cpu(), or -1 if unknown. */
+    int numa_node() const		{ return _numa_node; }
 #endif
 
     enum { S_PAUSED, S_BLOCKED, S_TIMERWAIT,
@@ -124,6 +147,19 @@ class RouterThread { public:
     TimerSet _timers;
 #if CLICK_USERLEVEL
     SelectSet _selects;
+
+    // adaptive polling and load accounting
+    Timestamp _busy_poll;
+    Timestamp _last_work;		// steady time of last useful work
+    Timestamp _driver_start;
+    Timestamp _idle_time;
+    Timestamp _wakeup_latency;
+    Timestamp _max_wakeup_latency;
+    uint64_t _nwakeups;
+    enum { idle_poll_msec = 1 };
+
+    int _cpu;
+    int _numa_node;
 #endif
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -218,6 +254,11 @@ class RouterThread { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if CLICK_USERLEVEL
+    inline bool should_poll() const;
+    inline int next_os_delay(Timestamp &t) const;
+    void account_wait(const Timestamp &before, const Timestamp &due);
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -6,6 +6,7 @@
 #endif
 #include <click/vector.hh>
 #include <click/sync.hh>
+#include <click/timestamp.hh>
 #include <unistd.h>
 #if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE
 # define HAVE_ALLOW_SELECT 1
@@ -45,6 +46,7 @@ class SelectSet { public:
 
     void run_selects(RouterThread *thread);
     inline void wake_immediate() {
+	_wake_time = Timestamp::now_steady();
 	_wake_pipe_pending = true;
 	ignore_result(write(_wake_pipe[1], "", 1));
     }
@@ -67,6 +69,7 @@ class SelectSet { public:
 
     int _wake_pipe[2];
     volatile bool _wake_pipe_pending;
+    Timestamp _wake_time;
 #if HAVE_ALLOW_KQUEUE
     int _kqueue;
 #endif
@@ -90,6 +93,8 @@ class SelectSet { public:
     void remove_pollfd(int pi, int event);
     inline void call_selected(int fd, int mask) const;
     inline bool post_select(RouterThread *thread, bool acquire);
+    inline void post_wait(RouterThread *thread, const Timestamp &before,
+			  int delay_type, const Timestamp &delay, int n);
 #if HAVE_ALLOW_KQUEUE
     void run_selects_kqueue(RouterThread *thread);
 #endif
@@ -0,0 +1,280 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHARDED_HH
+#define CLICK_SHARDED_HH
+#include <click/glue.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+/** @file <click/sharded.hh>
+ * @brief Per-thread copies of statistics and other data.
+ */
+
+/** @class Sharded
+ * @brief One copy of a value per Click thread.
+ *
+ * A Sharded<T> holds a separate T for every thread that might touch it, each
+ * in its own cache line.  A thread changes only its own copy, returned by
+ * local(), so several threads can update the same statistics without locks,
+ * atomic operations, or cache lines bouncing between processors.  Readers,
+ * which are usually handlers, combine the copies by iterating over them with
+ * size() and operator[]().  A reader may see a copy in the middle of an
+ * update, so Sharded suits counters and rate estimates, not data whose parts
+ * must stay consistent.
+ *
+ * A new Sharded object has a single copy, which every thread shares.  An
+ * element should call initialize() from its own initialize() method; this
+ * allocates one copy per thread of the element's router (at user level) or
+ * per possible CPU (in the Linux kernel).  Single-threaded drivers always
+ * use one copy.  The copies are value-initialized, so numbers start at zero.
+ *
+ * At user level, local() depends on the thread-local variable
+ * click_current_thread_id.  Threads other than RouterThreads, and drivers
+ * compiled without thread-local storage, share one copy.
+ */
+template <typename T>
+class Sharded { public:
+
+    /** @brief Construct a Sharded with a single, value-initialized copy. */
+    Sharded()
+	: _mem(0), _slots(0), _n(0) {
+	resize(1);
+    }
+
+    /** @brief Construct a Sharded with copies of @a x's values. */
+    Sharded(const Sharded<T> &x)
+	: _mem(0), _slots(0), _n(0) {
+	assign(x);
+    }
+
+    ~Sharded() {
+	destroy();
+    }
+
+    Sharded<T> &operator=(const Sharded<T> &x) {
+	if (&x != this) {
+	    destroy();
+	    assign(x);
+	}
+	return *this;
+    }
+
+    /** @brief Allocate one copy per thread of @a owner's router.
+     *
+     * Existing values are kept in the first copies. */
+    inline void initialize(Element *owner);
+
+    /** @brief Change the number of copies to @a n.
+     *
+     * The first min(@a n, size()) copies keep their values; any new copies
+     * are value-initialized.  Must not be called while other threads might
+     * use the object. */
+    void resize(int n);
+
+    /** @brief Return the number of copies. */
+    int size() const {
+	return _n;
+    }
+
+    /** @brief Return the calling thread's copy. */
+    inline T &local() {
+	return slot(local_index());
+    }
+
+    /** @brief Return copy @a i, where 0 <= @a i < size(). */
+    T &operator[](int i) {
+	return slot(i);
+    }
+    /** @overload */
+    const T &operator[](int i) const {
+	return const_cast<Sharded<T> *>(this)->slot(i);
+    }
+
+  private:
+
+    enum {
+	stride = ((sizeof(T) + CLICK_CACHE_LINE_SIZE - 1) / CLICK_CACHE_LINE_SIZE) * CLICK_CACHE_LINE_SIZE
+    };
+
+    char *_mem;
+    char *_slots;		// _mem aligned to a cache line
+    int _n;
+
+    T &slot(int i) {
+	return *reinterpret_cast<T *>(_slots + i * stride);
+    }
+    inline int local_index() const;
+    void allocate(int n);
+    void assign(const Sharded<T> &x);
+    void destroy();
+
+};
+
+template <typename T>
+inline int
+Sharded<T>::local_index() const
+{
+#if CLICK_LINUXMODULE
+    unsigned i = click_current_processor();
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    // thread IDs start at -1, the quiescent thread
+    unsigned i = click_current_thread_id + 1;
+#else
+    unsigned i = 0;
+#endif
+    return i < (unsigned) _n ? i : 0;
+}
+
+template <typename T>
+void
+Sharded<T>::allocate(int n)
+{
+    _mem = new char[n * stride + CLICK_CACHE_LINE_SIZE - 1];
+    uintptr_t a = reinterpret_cast<uintptr_t>(_mem);
+    a = (a + CLICK_CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1);
+    _slots = reinterpret_cast<char *>(a);
+    _n = n;
+}
+
+template <typename T>
+void
+Sharded<T>::assign(const Sharded<T> &x)
+{
+    allocate(x._n);
+    for (int i = 0; i < _n; ++i)
+	new((void *) &slot(i)) T(x[i]);
+}
+
+template <typename T>
+void
+Sharded<T>::destroy()
+{
+    for (int i = 0; i < _n; ++i)
+	slot(i).~T();
+    delete[] _mem;
+    _mem = _slots = 0;
+    _n = 0;
+}
+
+template <typename T>
+void
+Sharded<T>::resize(int n)
+{
+    if (n < 1)
+	n = 1;
+    if (n == _n)
+	return;
+    char *old_mem = _mem, *old_slots = _slots;
+    int old_n = _n;
+    allocate(n);
+    for (int i = 0; i < n; ++i) {
+	if (i < old_n)
+	    new((void *) &slot(i)) T(*reinterpret_cast<T *>(old_slots + i * stride));
+	else
+	    new((void *) &slot(i)) T();
+    }
+    for (int i = 0; i < old_n; ++i)
+	reinterpret_cast<T *>(old_slots + i * stride)->~T();
+    delete[] old_mem;
+}
+
+template <typename T>
+inline void
+Sharded<T>::initialize(Element *owner)
+{
+#if CLICK_LINUXMODULE
+    (void) owner;
+    resize(num_possible_cpus());
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    resize(owner->master()->nthreads() + 1);
+#else
+    (void) owner;
+#endif
+}
+
+
+/** @class ShardedCounter
+ * @brief A counter that threads update without contention.
+ *
+ * ShardedCounter<T> is a Sharded<T> that acts like an integer of type T.
+ * Increments and decrements go to the calling thread's copy; value() and the
+ * conversion to T return the sum of all copies.  (One thread's copy may go
+ * negative, or wrap if T is unsigned, but the sum is still right.)  Updates
+ * cost about as much as updating a plain member, while reads cost one
+ * addition per thread, so ShardedCounter suits statistics that are updated
+ * per packet and read by handlers.  Call initialize() from the owning
+ * element's initialize() method.
+ */
+template <typename T>
+class ShardedCounter { public:
+
+    /** @brief Construct a zero counter. */
+    ShardedCounter() {
+    }
+
+    /** @brief Allocate one copy per thread of @a owner's router. */
+    void initialize(Element *owner) {
+	_s.initialize(owner);
+    }
+
+    /** @brief Return the sum of all threads' counts. */
+    T value() const {
+	T x = 0;
+	for (int i = 0; i < _s.size(); ++i)
+	    x += _s[i];
+	return x;
+    }
+    operator T() const {
+	return value();
+    }
+
+    /** @brief Return the calling thread's count.
+     *
+     * Unlike value(), this does not read other threads' cache lines. */
+    T local_value() {
+	return _s.local();
+    }
+
+    ShardedCounter<T> &operator++() {
+	++_s.local();
+	return *this;
+    }
+    void operator++(int) {
+	++_s.local();
+    }
+    ShardedCounter<T> &operator+=(T x) {
+	_s.local() += x;
+	return *this;
+    }
+    ShardedCounter<T> &operator--() {
+	--_s.local();
+	return *this;
+    }
+    void operator--(int) {
+	--_s.local();
+    }
+    ShardedCounter<T> &operator-=(T x) {
+	_s.local() -= x;
+	return *this;
+    }
+
+    /** @brief Set the counter to @a x. */
+    ShardedCounter<T> &operator=(T x) {
+	clear();
+	_s[0] = x;
+	return *this;
+    }
+
+    /** @brief Set the counter to zero. */
+    void clear() {
+	for (int i = 0; i < _s.size(); ++i)
+	    _s[i] = 0;
+    }
+
+  private:
+
+    Sharded<T> _s;
+
+};
+
+CLICK_ENDDECLS
+#endif
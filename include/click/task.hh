@@ -51,6 +51,30 @@ class Task : private TaskLink { public:
 #if HAVE_STRIDE_SCHED
     enum { STRIDE1 = 1U<<16, MAX_STRIDE = 1U<<31 };
     enum { MAX_TICKETS = 1<<15, DEFAULT_TICKETS = 1<<10 };
+    enum { QUANTUM_CYCLES = 1U<<14, MAX_CHARGE_FACTOR = 64,
+	   SAMPLE_RUNS = 8 };
+    enum { LATENCY_NORMAL = 0, LATENCY_LOW = 1 };
+
+    /** @brief Scheduling statistics for a task.
+     *
+     * Cycle counts are sampled once every SAMPLE_RUNS runs, so cycles is
+     * the total over cycle_runs runs, not over all runs.  Wake delays
+     * measure the cycles between a reschedule() that put an idle task back
+     * on its thread's list and the task's next run. */
+    struct Stats {
+	uint64_t runs;
+	uint64_t work_runs;	// runs that returned true
+	uint64_t work;		// units reported with add_work()
+	uint64_t cycles;
+	uint32_t cycle_runs;
+	uint32_t wakeups;
+	uint64_t wake_delay;
+	click_cycles_t max_wake_delay;
+	Stats()
+	    : runs(0), work_runs(0), work(0), cycles(0), cycle_runs(0),
+	      wakeups(0), wake_delay(0), max_wake_delay(0) {
+	}
+    };
 #endif
 #if HAVE_ADAPTIVE_SCHEDULER
     enum { MAX_UTILIZATION = 1000 };
@@ -274,7 +298,37 @@ class Task : private TaskLink { public:
     inline int tickets() const;
     inline void set_tickets(int n);
     inline void adjust_tickets(int delta);
+
+    inline int latency_class() const;
+    inline void set_latency_class(int c);
+
+    /** @brief Return the pass the task is charged for each run.
+     *
+     * This is the stride, multiplied by the task's average cost in units of
+     * QUANTUM_CYCLES (at least 1, at most MAX_CHARGE_FACTOR). */
+    unsigned charge() const {
+	return _charge;
+    }
+
+    const Stats &stats() const {
+	return _stats;
+    }
+    void clear_stats() {
+	_stats = Stats();
+    }
+#endif
+
+    /** @brief Record @a n units of work, such as packets, for this run.
+     *
+     * A task's callback may call add_work() to say how much it did.  The
+     * units appear in the task's statistics. */
+    inline void add_work(unsigned n) {
+#if HAVE_STRIDE_SCHED
+	_stats.work += n;
+#else
+	(void) n;
 #endif
+    }
 
     inline bool fire();
 
@@ -304,6 +358,11 @@ class Task : private TaskLink { public:
 #if HAVE_STRIDE_SCHED
     unsigned _stride;
     int _tickets;
+    unsigned _charge;
+    uint32_t _avg_cycles;
+    int _latency_class;
+    click_cycles_t _wake_cycles;
+    Stats _stats;
 #endif
 
     union Status {
@@ -360,6 +419,10 @@ class Task : private TaskLink { public:
 
     inline void complete_schedule(unsigned new_pass);
     inline void fast_schedule();
+#if HAVE_STRIDE_SCHED
+    inline void update_charge();
+    inline void account_run(click_cycles_t start);
+#endif
     void true_reschedule();
     inline void remove_from_scheduled_list();
 
@@ -386,7 +449,8 @@ Task::Task(TaskCallback f, void *user_data)
       _schedpos(-1),
 #endif
 #if HAVE_STRIDE_SCHED
-      _stride(0), _tickets(-1),
+      _stride(0), _tickets(-1), _charge(0), _avg_cycles(0),
+      _latency_class(LATENCY_NORMAL), _wake_cycles(0),
 #endif
       _hook(f), _thunk(user_data),
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -409,7 +473,8 @@ Task::Task(Element* e)
       _schedpos(-1),
 #endif
 #if HAVE_STRIDE_SCHED
-      _stride(0), _tickets(-1),
+      _stride(0), _tickets(-1), _charge(0), _avg_cycles(0),
+      _latency_class(LATENCY_NORMAL), _wake_cycles(0),
 #endif
       _hook(0), _thunk(e),
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -521,6 +586,7 @@ Task::set_tickets(int n)
     _tickets = n;
     _stride = STRIDE1 / n;
     assert(_stride < MAX_STRIDE);
+    update_charge();
 }
 
 /** @brief Add @a delta to the Task's ticket count.
@@ -536,6 +602,56 @@ Task::adjust_tickets(int delta)
     set_tickets(_tickets + delta);
 }
 
+/** @brief Return the task's latency class.
+ *
+ * Either LATENCY_NORMAL or LATENCY_LOW.
+ *
+ * @sa set_latency_class
+ */
+inline int
+Task::latency_class() const
+{
+    return _latency_class;
+}
+
+/** @brief Set the task's latency class.
+ * @param c LATENCY_NORMAL or LATENCY_LOW
+ *
+ * A normal task that is rescheduled after being idle runs one stride after
+ * the thread's current pass, as if it had just run.  A LATENCY_LOW task
+ * runs at the current pass instead, so it goes ahead of every other
+ * scheduled task.  Once running, it shares the thread by tickets as usual.
+ */
+inline void
+Task::set_latency_class(int c)
+{
+    _latency_class = (c == LATENCY_LOW ? LATENCY_LOW : LATENCY_NORMAL);
+}
+
+inline void
+Task::update_charge()
+{
+    uint32_t factor = _avg_cycles / QUANTUM_CYCLES;
+    if (factor < 1)
+	factor = 1;
+    else if (factor > MAX_CHARGE_FACTOR)
+	factor = MAX_CHARGE_FACTOR;
+    _charge = _stride * factor;
+}
+
+inline void
+Task::account_run(click_cycles_t start)
+{
+    click_cycles_t delta = click_get_cycles() - start;
+    _stats.cycles += delta;
+    ++_stats.cycle_runs;
+    // an exponentially weighted average; the cap keeps the difference
+    // within int32_t
+    uint32_t c = (delta > (1U << 30) ? 1U << 30 : (uint32_t) delta);
+    _avg_cycles += (int32_t) (c - _avg_cycles) / 8;
+    update_charge();
+}
+
 #endif /* HAVE_STRIDE_SCHED */
 
 
@@ -598,7 +714,10 @@ Task::fast_schedule()
     if (!on_scheduled_list()) {
 #if HAVE_STRIDE_SCHED
 	assert(_tickets >= 1);
-	complete_schedule(_thread->pass() + _stride);
+	if (_latency_class == LATENCY_LOW)
+	    complete_schedule(_thread->pass());
+	else
+	    complete_schedule(_thread->pass() + _stride);
 #else
 	complete_schedule(0);
 #endif
@@ -629,12 +748,32 @@ Task::fire()
 #endif
 #if HAVE_MULTITHREAD
     _cycle_runs++;
+#endif
+#if HAVE_STRIDE_SCHED
+    click_cycles_t start = 0;
+    if (!(_stats.runs % SAMPLE_RUNS) || _wake_cycles) {
+	start = click_get_cycles();
+	if (_wake_cycles) {
+	    click_cycles_t delay = start - _wake_cycles;
+	    _wake_cycles = 0;
+	    ++_stats.wakeups;
+	    _stats.wake_delay += delay;
+	    if (delay > _stats.max_wake_delay)
+		_stats.max_wake_delay = delay;
+	}
+    }
 #endif
     bool work_done;
     if (!_hook)
 	work_done = ((Element*)_thunk)->run_task(this);
     else
 	work_done = _hook(this, _thunk);
+#if HAVE_STRIDE_SCHED
+    if (!(_stats.runs % SAMPLE_RUNS))
+	account_run(start);
+    ++_stats.runs;
+    _stats.work_runs += work_done;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     ++_runs;
     _work_done += work_done;
@@ -139,6 +139,30 @@ uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst,
 uint16_t click_in_cksum_pseudohdr_hard(uint32_t csum, const struct click_ip *iph, int packet_len);
 void click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *addr, int len);
 
+/** @brief Add data to a partial Internet checksum.
+ * @param x data to checksum
+ * @param len number of bytes to checksum
+ * @param sum partial checksum of preceding data, or 0
+ *
+ * Returns the one's-complement sum of @a sum and the 16-bit words of @a x,
+ * folded to 16 bits but not complemented, so that click_in_cksum(x, len) ==
+ * (uint16_t) ~click_in_cksum_partial(x, len, 0).  A checksum can be built
+ * up piece by piece; every piece but the last must have even length.  At
+ * user level on x86-64, long data is summed with SSE2 or AVX2 instructions,
+ * chosen at run time. */
+uint32_t click_in_cksum_partial(const unsigned char *x, int len, uint32_t sum);
+
+/** @brief Copy data and add it to a partial Internet checksum.
+ * @param dst destination
+ * @param src source
+ * @param len number of bytes to copy and checksum
+ * @param sum partial checksum of preceding data, or 0
+ *
+ * Equivalent to memcpy(dst, src, len) followed by
+ * click_in_cksum_partial(src, len, sum), but reads the data only once.  The
+ * ranges must not overlap. */
+uint32_t click_in_cksum_copy(unsigned char *dst, const unsigned char *src, int len, uint32_t sum);
+
 /** @brief Adjust an Internet checksum according to a pseudoheader.
  * @param data_csum initial checksum (may be a 16-bit checksum)
  * @param iph IP header from which to extract pseudoheader information
@@ -182,6 +206,23 @@ click_update_in_cksum(uint16_t *csum, uint16_t old_hw, uint16_t new_hw)
     *csum = ~(sum + (sum >> 16));
 }
 
+/** @brief Incrementally adjust an Internet checksum for a 32-bit change.
+ * @param[in, out] csum points to checksum
+ * @param old_w old word, such as an IP address
+ * @param new_w new word
+ *
+ * Equivalent to two click_update_in_cksum() calls, one per halfword, but
+ * folds only once.  The caveat about ~+0 applies here too. */
+static inline void
+click_update_in_cksum32(uint16_t *csum, uint32_t old_w, uint32_t new_w)
+{
+    uint32_t sum = (~*csum & 0xFFFF)
+	+ (~old_w & 0xFFFF) + (~old_w >> 16)
+	+ (new_w & 0xFFFF) + (new_w >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    *csum = ~(sum + (sum >> 16));
+}
+
 /** @brief Potentially fix a zero-valued Internet checksum.
  * @param[in, out] csum points to checksum
  * @param x data to checksum
@@ -0,0 +1,613 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/aes128.hh" -*-
+/*
+ * aes128.{cc,hh} -- the AES-128 block cipher and AES-128-GCM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/aes128.hh>
+#include <click/machine.hh>
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+# define CLICK_AES_NI 1
+# include <wmmintrin.h>
+# include <tmmintrin.h>
+# include <cpuid.h>
+#endif
+CLICK_DECLS
+
+// The software implementation is the usual one with four 256-entry tables
+// per direction. The tables are computed, not stored, the first time a key
+// is set.
+
+static uint8_t aes_sbox[256];
+static uint8_t aes_isbox[256];
+static uint32_t aes_te[4][256];
+static uint32_t aes_td[4][256];
+static volatile bool aes_tables_ready;
+#if CLICK_AES_NI
+static bool aes_ni;
+static bool aes_clmul;
+#endif
+
+static inline uint8_t
+aes_xtime(uint8_t x)
+{
+    return (x << 1) ^ (x & 0x80 ? 0x1B : 0);
+}
+
+static inline uint8_t
+aes_mul(uint8_t x, uint8_t y)
+{
+    uint8_t r = 0;
+    for (; y; y >>= 1, x = aes_xtime(x))
+	if (y & 1)
+	    r ^= x;
+    return r;
+}
+
+static inline uint32_t
+aes_ror8(uint32_t x)
+{
+    return (x >> 8) | (x << 24);
+}
+
+static inline uint32_t
+aes_load(const unsigned char *x)
+{
+    return ((uint32_t) x[0] << 24) | ((uint32_t) x[1] << 16)
+	| ((uint32_t) x[2] << 8) | x[3];
+}
+
+static inline void
+aes_store(unsigned char *x, uint32_t v)
+{
+    x[0] = v >> 24;
+    x[1] = v >> 16;
+    x[2] = v >> 8;
+    x[3] = v;
+}
+
+void
+AES128::static_initialize()
+{
+    if (aes_tables_ready)
+	return;
+
+    // S-box: multiplicative inverse in GF(2^8) followed by the affine map.
+    // p runs through the powers of the generator 3, q through the powers
+    // of its inverse, so q is always the inverse of p.
+    uint8_t p = 1, q = 1;
+    do {
+	p = p ^ aes_xtime(p);
+	q ^= q << 1;
+	q ^= q << 2;
+	q ^= q << 4;
+	if (q & 0x80)
+	    q ^= 0x09;
+	uint8_t x = q ^ (uint8_t) ((q << 1) | (q >> 7))
+	    ^ (uint8_t) ((q << 2) | (q >> 6))
+	    ^ (uint8_t) ((q << 3) | (q >> 5))
+	    ^ (uint8_t) ((q << 4) | (q >> 4));
+	aes_sbox[p] = x ^ 0x63;
+    } while (p != 1);
+    aes_sbox[0] = 0x63;
+
+    for (int i = 0; i < 256; ++i)
+	aes_isbox[aes_sbox[i]] = i;
+
+    for (int i = 0; i < 256; ++i) {
+	uint8_t s = aes_sbox[i];
+	uint32_t te = ((uint32_t) aes_xtime(s) << 24) | (s << 16) | (s << 8)
+	    | (uint8_t) (aes_xtime(s) ^ s);
+	uint8_t t = aes_isbox[i];
+	uint32_t td = ((uint32_t) aes_mul(t, 0x0E) << 24)
+	    | (aes_mul(t, 0x09) << 16) | (aes_mul(t, 0x0D) << 8)
+	    | aes_mul(t, 0x0B);
+	for (int j = 0; j < 4; ++j) {
+	    aes_te[j][i] = te;
+	    aes_td[j][i] = td;
+	    te = aes_ror8(te);
+	    td = aes_ror8(td);
+	}
+    }
+
+#if CLICK_AES_NI
+    unsigned a, b, c, d;
+    aes_ni = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_AES);
+    aes_clmul = aes_ni && (c & bit_PCLMUL) && (c & bit_SSSE3);
+#endif
+
+    click_fence();
+    aes_tables_ready = true;
+}
+
+bool
+AES128::hardware_accelerated()
+{
+    static_initialize();
+#if CLICK_AES_NI
+    return aes_ni;
+#else
+    return false;
+#endif
+}
+
+AES128::AES128()
+{
+    unsigned char key[key_size];
+    memset(key, 0, sizeof(key));
+    set_key(key);
+}
+
+void
+AES128::set_key(const unsigned char *key)
+{
+    static_initialize();
+
+    uint32_t rk[(nrounds + 1) * 4];
+    for (int i = 0; i < 4; ++i)
+	rk[i] = aes_load(key + 4 * i);
+    uint8_t rcon = 1;
+    for (int i = 4; i < (nrounds + 1) * 4; ++i) {
+	uint32_t t = rk[i - 1];
+	if (i % 4 == 0) {
+	    t = ((uint32_t) aes_sbox[(t >> 16) & 255] << 24)
+		^ ((uint32_t) aes_sbox[(t >> 8) & 255] << 16)
+		^ ((uint32_t) aes_sbox[t & 255] << 8)
+		^ aes_sbox[t >> 24] ^ ((uint32_t) rcon << 24);
+	    rcon = aes_xtime(rcon);
+	}
+	rk[i] = rk[i - 4] ^ t;
+    }
+    for (int i = 0; i < (nrounds + 1) * 4; ++i)
+	aes_store(_ek + 4 * i, rk[i]);
+
+    // Equivalent inverse cipher: reverse the round order and apply
+    // InvMixColumns to every round key but the first and last.
+    for (int r = 0; r <= nrounds; ++r)
+	for (int i = 0; i < 4; ++i) {
+	    uint32_t w = rk[(nrounds - r) * 4 + i];
+	    if (r != 0 && r != nrounds)
+		w = aes_td[0][aes_sbox[w >> 24]]
+		    ^ aes_td[1][aes_sbox[(w >> 16) & 255]]
+		    ^ aes_td[2][aes_sbox[(w >> 8) & 255]]
+		    ^ aes_td[3][aes_sbox[w & 255]];
+	    aes_store(_dk + r * block_size + 4 * i, w);
+	}
+}
+
+
+#if CLICK_AES_NI
+// Process four blocks at a time: AESENC has several cycles of latency but
+// can issue every cycle, so independent blocks run nearly for free.
+
+__attribute__((target("aes,sse2"))) static void
+aesni_encrypt(const unsigned char *ks, const unsigned char *in,
+	      unsigned char *out, size_t n)
+{
+    const __m128i *k = reinterpret_cast<const __m128i *>(ks);
+    __m128i k0 = _mm_load_si128(k), k10 = _mm_load_si128(k + 10);
+    for (; n >= 4; n -= 4, in += 64, out += 64) {
+	__m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k0);
+	__m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 16)), k0);
+	__m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 32)), k0);
+	__m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 48)), k0);
+	for (int r = 1; r < 10; ++r) {
+	    __m128i kr = _mm_load_si128(k + r);
+	    b0 = _mm_aesenc_si128(b0, kr);
+	    b1 = _mm_aesenc_si128(b1, kr);
+	    b2 = _mm_aesenc_si128(b2, kr);
+	    b3 = _mm_aesenc_si128(b3, kr);
+	}
+	_mm_storeu_si128((__m128i *) out, _mm_aesenclast_si128(b0, k10));
+	_mm_storeu_si128((__m128i *) (out + 16), _mm_aesenclast_si128(b1, k10));
+	_mm_storeu_si128((__m128i *) (out + 32), _mm_aesenclast_si128(b2, k10));
+	_mm_storeu_si128((__m128i *) (out + 48), _mm_aesenclast_si128(b3, k10));
+    }
+    for (; n; --n, in += 16, out += 16) {
+	__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k0);
+	for (int r = 1; r < 10; ++r)
+	    b = _mm_aesenc_si128(b, _mm_load_si128(k + r));
+	_mm_storeu_si128((__m128i *) out, _mm_aesenclast_si128(b, k10));
+    }
+}
+
+__attribute__((target("aes,sse2"))) static void
+aesni_decrypt(const unsigned char *ks, const unsigned char *in,
+	      unsigned char *out, size_t n)
+{
+    const __m128i *k = reinterpret_cast<const __m128i *>(ks);
+    __m128i k0 = _mm_load_si128(k), k10 = _mm_load_si128(k + 10);
+    for (; n >= 4; n -= 4, in += 64, out += 64) {
+	__m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k0);
+	__m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 16)), k0);
+	__m128i b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 32)), k0);
+	__m128i b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (in + 48)), k0);
+	for (int r = 1; r < 10; ++r) {
+	    __m128i kr = _mm_load_si128(k + r);
+	    b0 = _mm_aesdec_si128(b0, kr);
+	    b1 = _mm_aesdec_si128(b1, kr);
+	    b2 = _mm_aesdec_si128(b2, kr);
+	    b3 = _mm_aesdec_si128(b3, kr);
+	}
+	_mm_storeu_si128((__m128i *) out, _mm_aesdeclast_si128(b0, k10));
+	_mm_storeu_si128((__m128i *) (out + 16), _mm_aesdeclast_si128(b1, k10));
+	_mm_storeu_si128((__m128i *) (out + 32), _mm_aesdeclast_si128(b2, k10));
+	_mm_storeu_si128((__m128i *) (out + 48), _mm_aesdeclast_si128(b3, k10));
+    }
+    for (; n; --n, in += 16, out += 16) {
+	__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), k0);
+	for (int r = 1; r < 10; ++r)
+	    b = _mm_aesdec_si128(b, _mm_load_si128(k + r));
+	_mm_storeu_si128((__m128i *) out, _mm_aesdeclast_si128(b, k10));
+    }
+}
+#endif
+
+
+void
+AES128::encrypt_blocks(const unsigned char *in, unsigned char *out,
+		       size_t n) const
+{
+#if CLICK_AES_NI
+    if (aes_ni) {
+	aesni_encrypt(_ek, in, out, n);
+	return;
+    }
+#endif
+    uint32_t rk[(nrounds + 1) * 4];
+    for (int i = 0; i < (nrounds + 1) * 4; ++i)
+	rk[i] = aes_load(_ek + 4 * i);
+
+    for (; n; --n, in += block_size, out += block_size) {
+	uint32_t s0 = aes_load(in) ^ rk[0];
+	uint32_t s1 = aes_load(in + 4) ^ rk[1];
+	uint32_t s2 = aes_load(in + 8) ^ rk[2];
+	uint32_t s3 = aes_load(in + 12) ^ rk[3];
+	for (int r = 1; r < nrounds; ++r) {
+	    const uint32_t *k = rk + 4 * r;
+	    uint32_t t0 = aes_te[0][s0 >> 24] ^ aes_te[1][(s1 >> 16) & 255]
+		^ aes_te[2][(s2 >> 8) & 255] ^ aes_te[3][s3 & 255] ^ k[0];
+	    uint32_t t1 = aes_te[0][s1 >> 24] ^ aes_te[1][(s2 >> 16) & 255]
+		^ aes_te[2][(s3 >> 8) & 255] ^ aes_te[3][s0 & 255] ^ k[1];
+	    uint32_t t2 = aes_te[0][s2 >> 24] ^ aes_te[1][(s3 >> 16) & 255]
+		^ aes_te[2][(s0 >> 8) & 255] ^ aes_te[3][s1 & 255] ^ k[2];
+	    uint32_t t3 = aes_te[0][s3 >> 24] ^ aes_te[1][(s0 >> 16) & 255]
+		^ aes_te[2][(s1 >> 8) & 255] ^ aes_te[3][s2 & 255] ^ k[3];
+	    s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+	}
+	const uint32_t *k = rk + 4 * nrounds;
+#define AES_LAST(a, b, c, d) (((uint32_t) aes_sbox[a >> 24] << 24) \
+			      | ((uint32_t) aes_sbox[(b >> 16) & 255] << 16) \
+			      | ((uint32_t) aes_sbox[(c >> 8) & 255] << 8) \
+			      | aes_sbox[d & 255])
+	aes_store(out, AES_LAST(s0, s1, s2, s3) ^ k[0]);
+	aes_store(out + 4, AES_LAST(s1, s2, s3, s0) ^ k[1]);
+	aes_store(out + 8, AES_LAST(s2, s3, s0, s1) ^ k[2]);
+	aes_store(out + 12, AES_LAST(s3, s0, s1, s2) ^ k[3]);
+#undef AES_LAST
+    }
+}
+
+void
+AES128::decrypt_blocks(const unsigned char *in, unsigned char *out,
+		       size_t n) const
+{
+#if CLICK_AES_NI
+    if (aes_ni) {
+	aesni_decrypt(_dk, in, out, n);
+	return;
+    }
+#endif
+    uint32_t rk[(nrounds + 1) * 4];
+    for (int i = 0; i < (nrounds + 1) * 4; ++i)
+	rk[i] = aes_load(_dk + 4 * i);
+
+    for (; n; --n, in += block_size, out += block_size) {
+	uint32_t s0 = aes_load(in) ^ rk[0];
+	uint32_t s1 = aes_load(in + 4) ^ rk[1];
+	uint32_t s2 = aes_load(in + 8) ^ rk[2];
+	uint32_t s3 = aes_load(in + 12) ^ rk[3];
+	for (int r = 1; r < nrounds; ++r) {
+	    const uint32_t *k = rk + 4 * r;
+	    uint32_t t0 = aes_td[0][s0 >> 24] ^ aes_td[1][(s3 >> 16) & 255]
+		^ aes_td[2][(s2 >> 8) & 255] ^ aes_td[3][s1 & 255] ^ k[0];
+	    uint32_t t1 = aes_td[0][s1 >> 24] ^ aes_td[1][(s0 >> 16) & 255]
+		^ aes_td[2][(s3 >> 8) & 255] ^ aes_td[3][s2 & 255] ^ k[1];
+	    uint32_t t2 = aes_td[0][s2 >> 24] ^ aes_td[1][(s1 >> 16) & 255]
+		^ aes_td[2][(s0 >> 8) & 255] ^ aes_td[3][s3 & 255] ^ k[2];
+	    uint32_t t3 = aes_td[0][s3 >> 24] ^ aes_td[1][(s2 >> 16) & 255]
+		^ aes_td[2][(s1 >> 8) & 255] ^ aes_td[3][s0 & 255] ^ k[3];
+	    s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+	}
+	const uint32_t *k = rk + 4 * nrounds;
+#define AES_LAST(a, b, c, d) (((uint32_t) aes_isbox[a >> 24] << 24) \
+			      | ((uint32_t) aes_isbox[(b >> 16) & 255] << 16) \
+			      | ((uint32_t) aes_isbox[(c >> 8) & 255] << 8) \
+			      | aes_isbox[d & 255])
+	aes_store(out, AES_LAST(s0, s3, s2, s1) ^ k[0]);
+	aes_store(out + 4, AES_LAST(s1, s0, s3, s2) ^ k[1]);
+	aes_store(out + 8, AES_LAST(s2, s1, s0, s3) ^ k[2]);
+	aes_store(out + 12, AES_LAST(s3, s2, s1, s0) ^ k[3]);
+#undef AES_LAST
+    }
+}
+
+
+
+// AES128GCM
+
+AES128GCM::AES128GCM()
+{
+    unsigned char key[AES128::key_size];
+    memset(key, 0, sizeof(key));
+    set_key(key);
+}
+
+static inline uint64_t
+gcm_load64(const unsigned char *x)
+{
+    return ((uint64_t) aes_load(x) << 32) | aes_load(x + 4);
+}
+
+void
+AES128GCM::set_key(const unsigned char *key)
+{
+    _aes.set_key(key);
+    memset(_h, 0, sizeof(_h));
+    _aes.encrypt(_h, _h);
+
+    // Tables for Shoup's 4-bit method: _hl/_hh[i] = i * H, where the
+    // 4-bit multiplier i is read in GCM's reflected bit order.
+    uint64_t vh = gcm_load64(_h), vl = gcm_load64(_h + 8);
+    _hl[8] = vl;
+    _hh[8] = vh;
+    _hl[0] = _hh[0] = 0;
+    for (int i = 4; i > 0; i >>= 1) {
+	uint32_t t = (vl & 1) * 0xE1000000U;
+	vl = (vh << 63) | (vl >> 1);
+	vh = (vh >> 1) ^ ((uint64_t) t << 32);
+	_hl[i] = vl;
+	_hh[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+	vh = _hh[i];
+	vl = _hl[i];
+	for (int j = 1; j < i; ++j) {
+	    _hh[i + j] = vh ^ _hh[j];
+	    _hl[i + j] = vl ^ _hl[j];
+	}
+    }
+}
+
+bool
+AES128GCM::hardware_accelerated()
+{
+    (void) AES128::hardware_accelerated(); // initialize
+#if CLICK_AES_NI
+    return aes_clmul;
+#else
+    return false;
+#endif
+}
+
+void
+AES128GCM::gmult(unsigned char *y) const
+{
+    static const uint64_t last4[16] = {
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+    };
+
+    int lo = y[15] & 15, hi, rem;
+    uint64_t zh = _hh[lo], zl = _hl[lo];
+    for (int i = 15; i >= 0; --i) {
+	lo = y[i] & 15;
+	hi = y[i] >> 4;
+	if (i != 15) {
+	    rem = zl & 15;
+	    zl = (zh << 60) | (zl >> 4);
+	    zh = (zh >> 4) ^ (last4[rem] << 48) ^ _hh[lo];
+	    zl ^= _hl[lo];
+	}
+	rem = zl & 15;
+	zl = (zh << 60) | (zl >> 4);
+	zh = (zh >> 4) ^ (last4[rem] << 48) ^ _hh[hi];
+	zl ^= _hl[hi];
+    }
+    aes_store(y, zh >> 32);
+    aes_store(y + 4, zh);
+    aes_store(y + 8, zl >> 32);
+    aes_store(y + 12, zl);
+}
+
+#if CLICK_AES_NI
+// Carry-less multiplication in GF(2^128) on byte-reversed operands, with
+// reduction by shifting (Gueron and Kounavis, "Intel Carry-Less
+// Multiplication Instruction and its Usage for Computing the GCM Mode").
+
+__attribute__((target("pclmul,ssse3,sse2"))) static inline __m128i
+clmul_gfmul(__m128i a, __m128i b)
+{
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t4 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t5 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t6 = _mm_clmulepi64_si128(a, b, 0x11);
+    t4 = _mm_xor_si128(t4, t5);
+    t5 = _mm_slli_si128(t4, 8);
+    t4 = _mm_srli_si128(t4, 8);
+    t3 = _mm_xor_si128(t3, t5);
+    t6 = _mm_xor_si128(t6, t4);
+
+    // shift the 256-bit product left by one bit
+    __m128i t7 = _mm_srli_epi32(t3, 31);
+    __m128i t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+
+    // reduce modulo x^128 + x^7 + x^2 + x + 1
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+    __m128i t2 = _mm_srli_epi32(t3, 1);
+    t4 = _mm_srli_epi32(t3, 2);
+    t5 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+    return _mm_xor_si128(t6, t3);
+}
+
+__attribute__((target("pclmul,ssse3,sse2"))) static void
+clmul_ghash(unsigned char *y, const unsigned char *h,
+	    const unsigned char *data, size_t len)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+				       8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i hv = _mm_shuffle_epi8(_mm_load_si128((const __m128i *) h), bswap);
+    __m128i yv = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) y), bswap);
+    for (; len >= 16; len -= 16, data += 16) {
+	__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) data), bswap);
+	yv = clmul_gfmul(_mm_xor_si128(yv, x), hv);
+    }
+    if (len) {
+	unsigned char buf[16];
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, data, len);
+	__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) buf), bswap);
+	yv = clmul_gfmul(_mm_xor_si128(yv, x), hv);
+    }
+    _mm_storeu_si128((__m128i *) y, _mm_shuffle_epi8(yv, bswap));
+}
+#endif
+
+void
+AES128GCM::ghash(unsigned char *y, const unsigned char *data, size_t len) const
+{
+#if CLICK_AES_NI
+    if (aes_clmul) {
+	clmul_ghash(y, _h, data, len);
+	return;
+    }
+#endif
+    for (; len >= 16; len -= 16, data += 16) {
+	for (int i = 0; i < 16; ++i)
+	    y[i] ^= data[i];
+	gmult(y);
+    }
+    if (len) {
+	for (size_t i = 0; i < len; ++i)
+	    y[i] ^= data[i];
+	gmult(y);
+    }
+}
+
+void
+AES128GCM::ghash_lengths(unsigned char *y, size_t aad_len, size_t len) const
+{
+    unsigned char block[16];
+    uint64_t abits = (uint64_t) aad_len * 8, cbits = (uint64_t) len * 8;
+    aes_store(block, abits >> 32);
+    aes_store(block + 4, abits);
+    aes_store(block + 8, cbits >> 32);
+    aes_store(block + 12, cbits);
+    ghash(y, block, 16);
+}
+
+void
+AES128GCM::ctr(const unsigned char *j0, const unsigned char *in,
+	       unsigned char *out, size_t len) const
+{
+    // Encrypt counter blocks in groups so the cipher can interleave them.
+    enum { group = 8 };
+    unsigned char ks[group * AES128::block_size] CLICK_ALIGNED(16);
+    uint32_t counter = aes_load(j0 + 12);
+    while (len) {
+	size_t nb = (len + 15) / 16;
+	if (nb > group)
+	    nb = group;
+	for (size_t b = 0; b < nb; ++b) {
+	    memcpy(ks + 16 * b, j0, 12);
+	    aes_store(ks + 16 * b + 12, ++counter);
+	}
+	_aes.encrypt_blocks(ks, ks, nb);
+	size_t n = (len < nb * 16 ? len : nb * 16);
+	for (size_t i = 0; i < n; ++i)
+	    out[i] = in[i] ^ ks[i];
+	in += n;
+	out += n;
+	len -= n;
+    }
+}
+
+void
+AES128GCM::encrypt(const unsigned char *nonce,
+		   const unsigned char *aad, size_t aad_len,
+		   const unsigned char *in, unsigned char *out, size_t len,
+		   unsigned char *tag) const
+{
+    unsigned char j0[16], y[16];
+    memcpy(j0, nonce, nonce_size);
+    aes_store(j0 + 12, 1);
+
+    ctr(j0, in, out, len);
+
+    memset(y, 0, sizeof(y));
+    ghash(y, aad, aad_len);
+    ghash(y, out, len);
+    ghash_lengths(y, aad_len, len);
+    _aes.encrypt(j0, tag);
+    for (int i = 0; i < tag_size; ++i)
+	tag[i] ^= y[i];
+}
+
+bool
+AES128GCM::decrypt(const unsigned char *nonce,
+		   const unsigned char *aad, size_t aad_len,
+		   const unsigned char *in, unsigned char *out, size_t len,
+		   const unsigned char *tag, size_t tag_len) const
+{
+    unsigned char j0[16], y[16], t[16];
+    memcpy(j0, nonce, nonce_size);
+    aes_store(j0 + 12, 1);
+
+    memset(y, 0, sizeof(y));
+    ghash(y, aad, aad_len);
+    ghash(y, in, len);
+    ghash_lengths(y, aad_len, len);
+    _aes.encrypt(j0, t);
+
+    // compare in constant time
+    unsigned char diff = 0;
+    for (size_t i = 0; i < tag_len && i < (size_t) tag_size; ++i)
+	diff |= t[i] ^ y[i] ^ tag[i];
+    if (diff || tag_len > (size_t) tag_size)
+	return false;
+
+    ctr(j0, in, out, len);
+    return true;
+}
+
+CLICK_ENDDECLS
@@ -1382,6 +1382,43 @@ FilenameArg::parse(const String &str, String &result, const ArgContext &)
 #endif
 
 
+bool
+CpuListArg::parse(const String &str, Vector<int> &result, const ArgContext &args)
+{
+    enum { max_cpu = 65535 };
+    Vector<int> cpus;
+    const char *s = str.begin(), *end = str.end();
+    while (1) {
+	while (s != end && (isspace((unsigned char) *s) || *s == ','))
+	    ++s;
+	if (s == end)
+	    break;
+	const char *w = s;
+	while (s != end && !isspace((unsigned char) *s) && *s != ',')
+	    ++s;
+	String word = str.substring(w, s);
+	int dash = word.find_left('-', 1), first, last;
+	if (dash < 0) {
+	    if (!IntArg().parse(word, first) || first < -1 || first > max_cpu)
+		goto error;
+	    last = first;
+	} else if (!IntArg().parse(word.substring(0, dash), first)
+		   || !IntArg().parse(word.substring(dash + 1), last)
+		   || first < 0 || last < first || last > max_cpu)
+	    goto error;
+	for (; first <= last; ++first)
+	    cpus.push_back(first);
+    }
+    if (cpus.size()) {
+	result.swap(cpus);
+	return true;
+    }
+  error:
+    args.error("expected list of CPU numbers");
+    return false;
+}
+
+
 #if !CLICK_TOOL
 bool
 AnnoArg::parse(const String &str, int &result, const ArgContext &args)
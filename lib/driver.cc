@@ -518,11 +518,14 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
     // lex
     Lexer *l = click_lexer();
     RequireLexerExtra lextra(&archive);
+    Timestamp parse_start = Timestamp::now_steady();
     int cookie = l->begin_parse(config_str, filename, &lextra, errh);
     while (!l->ydone())
 	l->ystep();
     Router *router = l->create_router(master ? master : new Master(1));
     l->end_parse(cookie);
+    if (router)
+	router->set_load_time(Router::load_parse, Timestamp::now_steady() - parse_start);
 
     // initialize if requested
     if (initialize)
@@ -364,6 +364,12 @@ void BetterIPCounter3::push(int port, Packet *p) {
      error.
   -# Sorts the elements by configure_phase() to construct a configuration
      order.
+  -# If the router is being hotswapped in, finds elements of the old router
+     that can be kept as they are: those that allow it with
+     can_keep_across_hotswap() and have the same name, class,
+     configuration string, and connections, whose neighbors can also be
+     kept.  Kept elements move into the new router and skip the
+     configure(), initialize(), and take_state() steps below.
   -# Calls each element's configure() method in order, passing its
      configuration arguments and an ErrorHandler.  All configure() functions
      are called, even if a prior configure() function returns an error.
@@ -1466,7 +1472,9 @@ Element::initialize(ErrorHandler *errh)
  * take_state() is called only when a configuration is hotswapped in.  The
  * default take_state() implementation does nothing; there's no need to
  * override it unless your element has state you want preserved across
- * hotswaps.
+ * hotswaps.  Elements whose configuration and surroundings did not change
+ * are usually not rebuilt at all, and take_state() is not called for them;
+ * it matters for elements whose configuration changed.
  *
  * The @a old_element argument is an element from the old configuration (that
  * is, from router()->@link Router::hotswap_router() hotswap_router()@endlink)
@@ -1528,6 +1536,30 @@ Element::hotswap_element() const
     return 0;
 }
 
+/** @brief Return true iff this element object may move into a hotswapped
+ * router unchanged.
+ *
+ * When a configuration is hotswapped in, an element whose name, class,
+ * configuration string, and connections are the same in both routers, and
+ * whose connected neighbors can also be kept, may be moved into the new
+ * router as it is, skipping configure(), initialize(), and take_state().
+ * This is only safe for elements whose state depends on nothing but their
+ * configuration and connections.  An element that finds other elements by
+ * scanning the router, shares resources through Router::attachment(), or
+ * otherwise holds pointers into the old router must be rebuilt.
+ *
+ * The default implementation returns false.  Elements that are safe to keep
+ * override it to return true; their subclasses inherit the answer, so a
+ * subclass that adds such dependencies must override it again.
+ *
+ * @sa take_state
+ */
+bool
+Element::can_keep_across_hotswap() const
+{
+    return false;
+}
+
 /** @brief Clean up the element's state.
  *
  * @param stage this element's maximum initialization stage
@@ -2134,6 +2166,55 @@ write_task_tickets(const String &s, Element *e, void *thunk, ErrorHandler *errh)
   task->set_tickets(tix);
   return 0;
 }
+
+static String
+read_task_latency_class(Element *e, void *thunk)
+{
+  Task *task = (Task *)((uint8_t *)e + (intptr_t)thunk);
+  if (task->latency_class() == Task::LATENCY_LOW)
+    return String::make_stable("low", 3);
+  else
+    return String::make_stable("normal", 6);
+}
+
+static int
+write_task_latency_class(const String &s, Element *e, void *thunk, ErrorHandler *errh)
+{
+  Task *task = (Task *)((uint8_t *)e + (intptr_t)thunk);
+  String str = cp_uncomment(s);
+  if (str == "normal")
+    task->set_latency_class(Task::LATENCY_NORMAL);
+  else if (str == "low")
+    task->set_latency_class(Task::LATENCY_LOW);
+  else
+    return errh->error("expected %<normal%> or %<low%>");
+  return 0;
+}
+
+static String
+read_task_stats(Element *e, void *thunk)
+{
+  Task *task = (Task *)((uint8_t *)e + (intptr_t)thunk);
+  const Task::Stats &st = task->stats();
+  StringAccum sa;
+  sa << "runs " << st.runs << '\n'
+     << "work_runs " << st.work_runs << '\n'
+     << "work " << st.work << '\n'
+     << "cycles_per_run " << (st.cycle_runs ? st.cycles / st.cycle_runs : 0) << '\n'
+     << "charge " << task->charge() << '\n'
+     << "wakeups " << st.wakeups << '\n'
+     << "avg_wake_delay " << (st.wakeups ? st.wake_delay / st.wakeups : 0) << '\n'
+     << "max_wake_delay " << st.max_wake_delay << '\n';
+  return sa.take_string();
+}
+
+static int
+write_task_stats(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+  Task *task = (Task *)((uint8_t *)e + (intptr_t)thunk);
+  task->clear_stats();
+  return 0;
+}
 #endif
 
 static String
@@ -2214,6 +2295,12 @@ write_task_home_thread(const String &str, Element *e, void *thunk, ErrorHandler
  * or reschedules the task as appropriate.
  * @li A "tickets" read handler, which returns the task's tickets.
  * @li A "tickets" write handler to set the task's tickets.
+ * @li A "latency_class" read handler, which returns "normal" or "low".
+ * @li A "latency_class" write handler to set the task's latency class.
+ * @li A "task_stats" read handler, which reports the task's runs, runs
+ * that did work, work units, average cycles per run, pass charged per run,
+ * and wakeup count and average and maximum wake delay in cycles.
+ * Writing any value to "task_stats" clears the statistics.
  * @li A "home_thread" read handler, which returns the task's home thread ID.
  * @li A "home_thread" write handler, which sets the task's home thread ID.
  *
@@ -2223,9 +2310,10 @@ write_task_home_thread(const String &str, Element *e, void *thunk, ErrorHandler
  * @li TASKHANDLER_WRITE_SCHEDULED: A "scheduled" write handler.
  * @li TASKHANDLER_WRITE_TICKETS: A "tickets" write handler.
  * @li TASKHANDLER_WRITE_HOME_THREAD: A "home_thread" write handler.
+ * @li TASKHANDLER_WRITE_LATENCY_CLASS: A "latency_class" write handler.
  * @li TASKHANDLER_WRITE_ALL: All available write handlers.
  * @li TASKHANDLER_DEFAULT: Equals TASKHANDLER_WRITE_TICKETS |
- * TASKHANDLER_WRITE_HOME_THREAD.
+ * TASKHANDLER_WRITE_HOME_THREAD | TASKHANDLER_WRITE_LATENCY_CLASS.
  *
  * Depending on Click's configuration options, some of these handlers might
  * not be available.  If Click was configured with schedule debugging, the
@@ -2250,6 +2338,11 @@ Element::add_task_handlers(Task *task, NotifierSignal *signal, int flags, const
     add_read_handler(prefix + "tickets", read_task_tickets, thunk);
     if (flags & TASKHANDLER_WRITE_TICKETS)
 	add_write_handler(prefix + "tickets", write_task_tickets, thunk);
+    add_read_handler(prefix + "latency_class", read_task_latency_class, thunk);
+    if (flags & TASKHANDLER_WRITE_LATENCY_CLASS)
+	add_write_handler(prefix + "latency_class", write_task_latency_class, thunk);
+    add_read_handler(prefix + "task_stats", read_task_stats, thunk, Handler::h_nonexclusive);
+    add_write_handler(prefix + "task_stats", write_task_stats, thunk);
 #endif
 #if HAVE_MULTITHREAD
     add_read_handler(prefix + "home_thread", read_task_home_thread, thunk);
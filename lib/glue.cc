@@ -31,6 +31,12 @@
 # include <sys/types.h>
 # include <sys/stat.h>
 # include <fcntl.h>
+# include <errno.h>
+# ifdef __linux__
+#  include <sched.h>
+#  include <dirent.h>
+#  include <sys/syscall.h>
+# endif
 #elif CLICK_LINUXMODULE
 # if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0)
 #  include <click/cxxprotect.h>
@@ -675,6 +681,84 @@ click_qsort(void *base, size_t n, size_t size, int (*compar)(const void *, const
 
 #if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
 __thread int click_current_thread_id;
+__thread int click_current_numa_node = -1;
+#endif
+
+#if CLICK_USERLEVEL
+/** @brief Bind the calling thread to processor @a cpu.
+ * @return 0 on success, or a negative error code; -ENOSYS if the system
+ * does not support processor affinity */
+int
+click_set_thread_cpu(int cpu)
+{
+# if defined(__linux__) && defined(CPU_SET)
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+	return -EINVAL;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	return -errno;
+    return 0;
+# else
+    (void) cpu;
+    return -ENOSYS;
+# endif
+}
+
+/** @brief Return the NUMA node containing processor @a cpu, or -1 if
+ * unknown. */
+int
+click_cpu_numa_node(int cpu)
+{
+# ifdef __linux__
+    char buf[64];
+    sprintf(buf, "/sys/devices/system/cpu/cpu%d", cpu);
+    int node = -1;
+    if (DIR *dir = opendir(buf)) {
+	while (struct dirent *d = readdir(dir))
+	    if (strncmp(d->d_name, "node", 4) == 0
+		&& d->d_name[4] >= '0' && d->d_name[4] <= '9') {
+		node = atoi(d->d_name + 4);
+		break;
+	    }
+	closedir(dir);
+    }
+    return node;
+# else
+    (void) cpu;
+    return -1;
+# endif
+}
+
+/** @brief Prefer NUMA node @a node for the calling thread's new memory.
+ *
+ * Pages the thread touches for the first time are placed on @a node when it
+ * has room.  If @a node is negative, restores the default policy, which
+ * places pages on the node of the processor that touches them.
+ * @return 0 on success, or a negative error code */
+int
+click_prefer_numa_node(int node)
+{
+# if defined(__linux__) && defined(SYS_set_mempolicy)
+    enum { mpol_default = 0, mpol_preferred = 1 };
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+    if (node >= (int) (8 * sizeof(mask)))
+	return -EINVAL;
+    long r;
+    if (node < 0)
+	r = syscall(SYS_set_mempolicy, (int) mpol_default, (unsigned long *) 0, 0UL);
+    else {
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+	r = syscall(SYS_set_mempolicy, (int) mpol_preferred, mask, 8 * sizeof(mask) + 1);
+    }
+    return r < 0 ? -errno : 0;
+# else
+    (void) node;
+    return -ENOSYS;
+# endif
+}
 #endif
 
 
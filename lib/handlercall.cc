@@ -75,13 +75,22 @@ HandlerCall::assign(Element *e, const String &hname, const String &value, int fl
 {
     // find handler
     const Handler* h = Router::handler(e, hname);
-    if (!h
-	|| ((flags & OP_WRITE) && !h->writable()))
+    if (!h)
 	return handler_error(e, hname, flags & OP_WRITE, errh);
+    else
+	return assign(e, h, value, flags, errh);
+}
+
+int
+HandlerCall::assign(Element *e, const Handler *h, const String &value, int flags, ErrorHandler *errh)
+{
+    if ((flags & OP_WRITE) && !h->writable())
+	return handler_error(e, h->name(), true, errh);
     else if ((flags & OP_READ) && !h->readable())
-	return handler_error(e, hname, false, errh);
+	return handler_error(e, h->name(), false, errh);
     else if (value && (flags & OP_READ) && !h->read_param()) {
-	errh->error("read handler %<%s%> does not take parameters", Handler::unparse_name(e, hname).c_str());
+	if (errh)
+	    errh->error("read handler %<%s%> does not take parameters", h->unparse_name(e).c_str());
 	return -EINVAL;
     }
 
@@ -0,0 +1,470 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/hmacsha.hh" -*-
+/*
+ * hmacsha.{cc,hh} -- HMAC-SHA-1 and HMAC-SHA-256 with precomputed key pads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/hmacsha.hh>
+#include <click/machine.hh>
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+# define CLICK_SHA_NI 1
+# include <immintrin.h>
+# include <cpuid.h>
+#endif
+CLICK_DECLS
+
+// A compression function processes nblocks consecutive 64-byte blocks,
+// updating the chaining state h. SHA-1 and SHA-256 pad messages the same
+// way, so padding and HMAC are shared.
+
+typedef void (*sha_blocks_t)(uint32_t *h, const unsigned char *p, size_t nblocks);
+
+static const uint32_t sha1_iv[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint32_t sha256_k[64] CLICK_ALIGNED(16) = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1,
+    0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786,
+    0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147,
+    0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+    0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A,
+    0x5B9CCA4F, 0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#if CLICK_SHA_NI
+static bool sha_ni;
+#endif
+static volatile bool sha_ready;
+
+static void
+sha_static_initialize()
+{
+    if (sha_ready)
+	return;
+#if CLICK_SHA_NI
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0, 0) >= 7 && __get_cpuid(1, &a, &b, &c, &d)
+	&& (c & bit_SSE4_1) && (c & bit_SSSE3)) {
+	__cpuid_count(7, 0, a, b, c, d);
+	sha_ni = (b & (1U << 29)) != 0;
+    }
+#endif
+    click_fence();
+    sha_ready = true;
+}
+
+static inline uint32_t
+sha_load(const unsigned char *x)
+{
+    return ((uint32_t) x[0] << 24) | ((uint32_t) x[1] << 16)
+	| ((uint32_t) x[2] << 8) | x[3];
+}
+
+static inline void
+sha_store(unsigned char *x, uint32_t v)
+{
+    x[0] = v >> 24;
+    x[1] = v >> 16;
+    x[2] = v >> 8;
+    x[3] = v;
+}
+
+static inline uint32_t
+sha_rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t
+sha_ror(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void
+sha1_blocks_portable(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    uint32_t w[16];
+    for (; nblocks; --nblocks, p += 64) {
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	for (int i = 0; i < 80; ++i) {
+	    uint32_t f, k;
+	    if (i < 16)
+		w[i] = sha_load(p + 4 * i);
+	    else
+		w[i & 15] = sha_rol(w[(i + 13) & 15] ^ w[(i + 8) & 15]
+				    ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+	    if (i < 20)
+		f = (b & c) | (~b & d), k = 0x5A827999;
+	    else if (i < 40)
+		f = b ^ c ^ d, k = 0x6ED9EBA1;
+	    else if (i < 60)
+		f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+	    else
+		f = b ^ c ^ d, k = 0xCA62C1D6;
+	    uint32_t t = sha_rol(a, 5) + f + e + k + w[i & 15];
+	    e = d;
+	    d = c;
+	    c = sha_rol(b, 30);
+	    b = a;
+	    a = t;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+    }
+}
+
+static void
+sha256_blocks_portable(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    uint32_t w[16];
+    for (; nblocks; --nblocks, p += 64) {
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3],
+	    e = h[4], f = h[5], g = h[6], hh = h[7];
+	for (int i = 0; i < 64; ++i) {
+	    if (i < 16)
+		w[i] = sha_load(p + 4 * i);
+	    else {
+		uint32_t w15 = w[(i + 1) & 15], w2 = w[(i + 14) & 15];
+		w[i & 15] += (sha_ror(w15, 7) ^ sha_ror(w15, 18) ^ (w15 >> 3))
+		    + w[(i + 9) & 15]
+		    + (sha_ror(w2, 17) ^ sha_ror(w2, 19) ^ (w2 >> 10));
+	    }
+	    uint32_t t1 = hh + (sha_ror(e, 6) ^ sha_ror(e, 11) ^ sha_ror(e, 25))
+		+ ((e & f) ^ (~e & g)) + sha256_k[i] + w[i & 15];
+	    uint32_t t2 = (sha_ror(a, 2) ^ sha_ror(a, 13) ^ sha_ror(a, 22))
+		+ ((a & b) ^ (a & c) ^ (b & c));
+	    hh = g;
+	    g = f;
+	    f = e;
+	    e = d + t1;
+	    d = c;
+	    c = b;
+	    b = a;
+	    a = t1 + t2;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+    }
+}
+
+
+#if CLICK_SHA_NI
+// These follow Intel's "New Instructions Supporting the Secure Hash
+// Algorithm on Intel Architecture Processors" (2013). Each macro
+// invocation is one group of four rounds; the message schedule for later
+// groups is computed in the shadow of the round instructions. The group
+// number g is always a constant, so the conditions fold away.
+
+# define SHA1NI_GROUP(g, ecur, eprev) do {				\
+	ecur = _mm_sha1nexte_epu32(ecur, m[(g) & 3]);			\
+	eprev = abcd;							\
+	if ((g) >= 3 && (g) <= 18)					\
+	    m[((g) + 1) & 3] = _mm_sha1msg2_epu32(m[((g) + 1) & 3], m[(g) & 3]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, ecur, (g) / 5);		\
+	if ((g) <= 16)							\
+	    m[((g) + 3) & 3] = _mm_sha1msg1_epu32(m[((g) + 3) & 3], m[(g) & 3]); \
+	if ((g) >= 2 && (g) <= 17)					\
+	    m[((g) + 2) & 3] = _mm_xor_si128(m[((g) + 2) & 3], m[(g) & 3]); \
+    } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3,sse2"))) static void
+sha1_blocks_ni(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0x1B);
+    __m128i e0 = _mm_set_epi32(h[4], 0, 0, 0);
+    __m128i e1, m[4];
+
+    for (; nblocks; --nblocks, p += 64) {
+	__m128i abcd_save = abcd, e0_save = e0;
+	for (int i = 0; i < 4; ++i)
+	    m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * i)), bswap);
+
+	e0 = _mm_add_epi32(e0, m[0]);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	SHA1NI_GROUP(1, e1, e0);
+	SHA1NI_GROUP(2, e0, e1);
+	SHA1NI_GROUP(3, e1, e0);
+	SHA1NI_GROUP(4, e0, e1);
+	SHA1NI_GROUP(5, e1, e0);
+	SHA1NI_GROUP(6, e0, e1);
+	SHA1NI_GROUP(7, e1, e0);
+	SHA1NI_GROUP(8, e0, e1);
+	SHA1NI_GROUP(9, e1, e0);
+	SHA1NI_GROUP(10, e0, e1);
+	SHA1NI_GROUP(11, e1, e0);
+	SHA1NI_GROUP(12, e0, e1);
+	SHA1NI_GROUP(13, e1, e0);
+	SHA1NI_GROUP(14, e0, e1);
+	SHA1NI_GROUP(15, e1, e0);
+	SHA1NI_GROUP(16, e0, e1);
+	SHA1NI_GROUP(17, e1, e0);
+	SHA1NI_GROUP(18, e0, e1);
+	SHA1NI_GROUP(19, e1, e0);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) h, _mm_shuffle_epi32(abcd, 0x1B));
+    h[4] = _mm_extract_epi32(e0, 3);
+}
+
+# undef SHA1NI_GROUP
+
+# define SHA256NI_GROUP(g) do {						\
+	__m128i k = _mm_add_epi32(m[(g) & 3], _mm_load_si128((const __m128i *) &sha256_k[4 * (g)])); \
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, k);			\
+	if ((g) >= 3 && (g) <= 14) {					\
+	    __m128i t = _mm_alignr_epi8(m[(g) & 3], m[((g) + 3) & 3], 4); \
+	    m[((g) + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(m[((g) + 1) & 3], t), m[(g) & 3]); \
+	}								\
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(k, 0x0E)); \
+	if ((g) >= 1 && (g) <= 12)					\
+	    m[((g) + 3) & 3] = _mm_sha256msg1_epu32(m[((g) + 3) & 3], m[(g) & 3]); \
+    } while (0)
+
+__attribute__((target("sha,sse4.1,ssse3,sse2"))) static void
+sha256_blocks_ni(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0xB1);
+    __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (h + 4)), 0x1B);
+    __m128i abef = _mm_alignr_epi8(t, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, t, 0xF0);
+    __m128i m[4];
+
+    for (; nblocks; --nblocks, p += 64) {
+	__m128i abef_save = abef, cdgh_save = cdgh;
+	for (int i = 0; i < 4; ++i)
+	    m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * i)), bswap);
+
+	SHA256NI_GROUP(0);
+	SHA256NI_GROUP(1);
+	SHA256NI_GROUP(2);
+	SHA256NI_GROUP(3);
+	SHA256NI_GROUP(4);
+	SHA256NI_GROUP(5);
+	SHA256NI_GROUP(6);
+	SHA256NI_GROUP(7);
+	SHA256NI_GROUP(8);
+	SHA256NI_GROUP(9);
+	SHA256NI_GROUP(10);
+	SHA256NI_GROUP(11);
+	SHA256NI_GROUP(12);
+	SHA256NI_GROUP(13);
+	SHA256NI_GROUP(14);
+	SHA256NI_GROUP(15);
+
+	abef = _mm_add_epi32(abef, abef_save);
+	cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    t = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i *) h, _mm_blend_epi16(t, cdgh, 0xF0));
+    _mm_storeu_si128((__m128i *) (h + 4), _mm_alignr_epi8(cdgh, t, 8));
+}
+
+# undef SHA256NI_GROUP
+#endif
+
+
+static inline sha_blocks_t
+sha1_blocks()
+{
+#if CLICK_SHA_NI
+    if (sha_ni)
+	return sha1_blocks_ni;
+#endif
+    return sha1_blocks_portable;
+}
+
+static inline sha_blocks_t
+sha256_blocks()
+{
+#if CLICK_SHA_NI
+    if (sha_ni)
+	return sha256_blocks_ni;
+#endif
+    return sha256_blocks_portable;
+}
+
+// Hash the last len bytes of a message whose first prefix_len bytes (a
+// multiple of the block size) have already been compressed into h, and pad.
+static void
+sha_finish(sha_blocks_t blocks, uint32_t *h,
+	   const unsigned char *data, size_t len, size_t prefix_len)
+{
+    size_t nblocks = len / 64;
+    if (nblocks)
+	blocks(h, data, nblocks);
+
+    unsigned char buf[128];
+    size_t rem = len - nblocks * 64;
+    size_t padlen = (rem < 56 ? 64 : 128);
+    memcpy(buf, data + nblocks * 64, rem);
+    buf[rem] = 0x80;
+    memset(buf + rem + 1, 0, padlen - rem - 9);
+    uint64_t bits = (uint64_t) (prefix_len + len) << 3;
+    sha_store(buf + padlen - 8, bits >> 32);
+    sha_store(buf + padlen - 4, bits);
+    blocks(h, buf, padlen / 64);
+}
+
+static void
+hmac_set_key(sha_blocks_t blocks, const uint32_t *iv, int nwords,
+	     const unsigned char *key, size_t len,
+	     uint32_t *istate, uint32_t *ostate)
+{
+    unsigned char pad[64];
+    memset(pad, 0, sizeof(pad));
+    if (len > sizeof(pad)) {
+	uint32_t h[8];
+	memcpy(h, iv, nwords * 4);
+	sha_finish(blocks, h, key, len, 0);
+	for (int i = 0; i < nwords; ++i)
+	    sha_store(pad + 4 * i, h[i]);
+    } else if (len)
+	memcpy(pad, key, len);
+
+    for (size_t i = 0; i < sizeof(pad); ++i)
+	pad[i] ^= 0x36;
+    memcpy(istate, iv, nwords * 4);
+    blocks(istate, pad, 1);
+    for (size_t i = 0; i < sizeof(pad); ++i)
+	pad[i] ^= 0x36 ^ 0x5C;
+    memcpy(ostate, iv, nwords * 4);
+    blocks(ostate, pad, 1);
+}
+
+static void
+hmac_compute(sha_blocks_t blocks, const uint32_t *istate,
+	     const uint32_t *ostate, int nwords,
+	     const unsigned char *data, size_t len, unsigned char *digest)
+{
+    uint32_t h[8];
+    memcpy(h, istate, nwords * 4);
+    sha_finish(blocks, h, data, len, 64);
+
+    unsigned char inner[32];
+    for (int i = 0; i < nwords; ++i)
+	sha_store(inner + 4 * i, h[i]);
+    memcpy(h, ostate, nwords * 4);
+    sha_finish(blocks, h, inner, nwords * 4, 64);
+    for (int i = 0; i < nwords; ++i)
+	sha_store(digest + 4 * i, h[i]);
+}
+
+static bool
+hmac_equal(const unsigned char *a, const unsigned char *b, size_t len)
+{
+    unsigned char x = 0;
+    for (size_t i = 0; i < len; ++i)
+	x |= a[i] ^ b[i];
+    return x == 0;
+}
+
+
+void
+HMACSHA1::set_key(const unsigned char *key, size_t len)
+{
+    sha_static_initialize();
+    hmac_set_key(sha1_blocks(), sha1_iv, 5, key, len, _istate, _ostate);
+}
+
+void
+HMACSHA1::compute(const unsigned char *data, size_t len,
+		  unsigned char *digest, size_t digest_len) const
+{
+    unsigned char d[digest_size];
+    hmac_compute(sha1_blocks(), _istate, _ostate, 5, data, len, d);
+    memcpy(digest, d, digest_len);
+}
+
+bool
+HMACSHA1::verify(const unsigned char *data, size_t len,
+		 const unsigned char *mac, size_t mac_len) const
+{
+    unsigned char d[digest_size];
+    hmac_compute(sha1_blocks(), _istate, _ostate, 5, data, len, d);
+    return mac_len <= digest_size && hmac_equal(d, mac, mac_len);
+}
+
+bool
+HMACSHA1::hardware_accelerated()
+{
+    sha_static_initialize();
+#if CLICK_SHA_NI
+    return sha_ni;
+#else
+    return false;
+#endif
+}
+
+
+void
+HMACSHA256::set_key(const unsigned char *key, size_t len)
+{
+    sha_static_initialize();
+    hmac_set_key(sha256_blocks(), sha256_iv, 8, key, len, _istate, _ostate);
+}
+
+void
+HMACSHA256::compute(const unsigned char *data, size_t len,
+		    unsigned char *digest, size_t digest_len) const
+{
+    unsigned char d[digest_size];
+    hmac_compute(sha256_blocks(), _istate, _ostate, 8, data, len, d);
+    memcpy(digest, d, digest_len);
+}
+
+bool
+HMACSHA256::verify(const unsigned char *data, size_t len,
+		   const unsigned char *mac, size_t mac_len) const
+{
+    unsigned char d[digest_size];
+    hmac_compute(sha256_blocks(), _istate, _ostate, 8, data, len, d);
+    return mac_len <= digest_size && hmac_equal(d, mac, mac_len);
+}
+
+bool
+HMACSHA256::hardware_accelerated()
+{
+    return HMACSHA1::hardware_accelerated();
+}
+
+CLICK_ENDDECLS
@@ -209,14 +209,10 @@ Master::kill_router(Router *router)
 #endif
     unlock_master();
 
-    // Remove tasks
+    // Remove tasks, including pending tasks
     for (RouterThread **tp = _threads; tp != _threads + _nthreads; ++tp)
 	(*tp)->kill_router(router);
 
-    // 4.Sep.2007 - Don't bother to remove pending tasks.  They will be
-    // removed shortly anyway, either when the task itself is deleted or (more
-    // likely) when the pending list is processed.
-
 #if CLICK_USERLEVEL
     // Remove signals
     {
@@ -102,6 +102,15 @@ Router::~Router()
     if (_refcount != 0)
 	click_chatter("deleting router while ref count = %d", _refcount.value());
 
+    // give back elements kept from the hotswap router, unless it has been
+    // stopped in the meantime
+    if (_hotswap_kept.size()) {
+	if (_hotswap_router->_running == RUNNING_DEAD)
+	    hotswap_take_elements();
+	else
+	    hotswap_return_elements();
+    }
+
     // unuse the hotswap router
     if (_hotswap_router)
 	_hotswap_router->unuse();
@@ -115,7 +124,8 @@ Router::~Router()
 	if (_master)
 	    _master->kill_router(this);
 	for (int ord = _elements.size() - 1; ord >= 0; ord--)
-	    _elements[ _element_configure_order[ord] ]->cleanup(Element::CLEANUP_ROUTER_INITIALIZED);
+	    if (Element *e = _elements[ _element_configure_order[ord] ])
+		e->cleanup(Element::CLEANUP_ROUTER_INITIALIZED);
     } else if (_state != ROUTER_DEAD) {
 	assert(_element_configure_order.size() == 0 && _state <= ROUTER_PRECONFIGURE);
 	for (int i = _elements.size() - 1; i >= 0; i--)
@@ -524,7 +534,8 @@ Router::check_hookup_range(ErrorHandler *errh)
 	    nin[(*cp)[0].idx] = (*cp)[0].port;
     }
     for (int f = 0; f < nelements(); f++)
-	_elements[f]->notify_nports(nin[f] + 1, nout[f] + 1, errh);
+	if (!hotswap_kept(f))
+	    _elements[f]->notify_nports(nin[f] + 1, nout[f] + 1, errh);
 
     // Check each hookup to ensure its port numbers are within range
     for (Connection *cp = _conn.begin(); cp != _conn.end(); ) {
@@ -749,9 +760,10 @@ Router::check_push_and_pull(ErrorHandler *errh)
 	return -1;
 
     for (int ei = 0; ei < nelements(); ++ei)
-	_elements[ei]->initialize_ports
-	    (input_pers.begin() + gport(false, Port(ei, 0)),
-	     output_pers.begin() + gport(true, Port(ei, 0)));
+	if (!hotswap_kept(ei))
+	    _elements[ei]->initialize_ports
+		(input_pers.begin() + gport(false, Port(ei, 0)),
+		 output_pers.begin() + gport(true, Port(ei, 0)));
     return 0;
 }
 
@@ -775,6 +787,9 @@ Router::set_connections()
 {
     // actually assign ports
     for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	// kept elements are already connected to each other
+	if (hotswap_kept((*cp)[0].idx))
+	    continue;
 	Element *frome = _elements[(*cp)[1].idx];
 	Element *toe = _elements[(*cp)[0].idx];
 	frome->connect_port(true, (*cp)[1].port, toe, (*cp)[0].port);
@@ -1080,12 +1095,16 @@ Router::initialize(ErrorHandler *errh)
     _attachment_names.clear();
     _attachments.clear();
 
+    Timestamp phase_start = Timestamp::now_steady();
     if (check_hookup_elements(errh) < 0)
 	return -1;
 
     // prepare thread IDs
     _element_home_thread_ids.assign(nelements() + 1, ThreadSched::THREAD_UNKNOWN);
 
+    // reuse unchanged elements of the router we are replacing
+    hotswap_keep_elements();
+
     // set up configuration order
     _element_configure_order.assign(nelements(), 0);
     if (_element_configure_order.size()) {
@@ -1111,6 +1130,10 @@ Router::initialize(ErrorHandler *errh)
 	}
     }
 
+    Timestamp now = Timestamp::now_steady();
+    _load_times[load_hookup] = now - phase_start;
+    phase_start = now;
+
     // prepare master
     _runcount = 1;
     _master->prepare_router(this);
@@ -1125,6 +1148,8 @@ Router::initialize(ErrorHandler *errh)
 	click_random_srandom();
 	for (int ord = 0; ord < _elements.size(); ord++) {
 	    int i = _element_configure_order[ord], r;
+	    if (hotswap_kept(i))
+		continue;
 #if CLICK_DMALLOC
 	    sprintf(dmalloc_buf, "c%d  ", i);
 	    CLICK_DMALLOC_REG(dmalloc_buf);
@@ -1147,6 +1172,10 @@ Router::initialize(ErrorHandler *errh)
 	}
     }
 
+    now = Timestamp::now_steady();
+    _load_times[load_configure] = now - phase_start;
+    phase_start = now;
+
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iHoo");
 #endif
@@ -1155,12 +1184,38 @@ Router::initialize(ErrorHandler *errh)
     if (all_ok) {
 	_state = ROUTER_PREINITIALIZE;
 	initialize_handlers(true, true);
+	now = Timestamp::now_steady();
+	_load_times[load_handlers] = now - phase_start;
+	phase_start = now;
+#if CLICK_USERLEVEL
+	// Initialize each element with a preference for memory on its home
+	// thread's NUMA node, so first-touch allocations land near the
+	// thread that will use them.
+# if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+	int my_numa_node = click_current_numa_node;
+# else
+	int my_numa_node = -1;
+# endif
+	int numa_node = my_numa_node;
+	bool numa = false;
+	for (int t = 0; t < _master->nthreads(); ++t)
+	    numa = numa || _master->thread(t)->numa_node() >= 0;
+#endif
 	for (int ord = 0; all_ok && ord < _elements.size(); ord++) {
 	    int i = _element_configure_order[ord];
+	    if (hotswap_kept(i))
+		continue;
 	    assert(element_stage[i] == Element::CLEANUP_CONFIGURED);
 #if CLICK_DMALLOC
 	    sprintf(dmalloc_buf, "i%d  ", i);
 	    CLICK_DMALLOC_REG(dmalloc_buf);
+#endif
+#if CLICK_USERLEVEL
+	    if (numa) {
+		int node = _master->thread(home_thread_id(_elements[i]))->numa_node();
+		if (node != numa_node && click_prefer_numa_node(node) >= 0)
+		    numa_node = node;
+	    }
 #endif
 	    RouterContextErrh cerrh(errh, "While initializing", element(i));
 	    assert(!cerrh.nerrors());
@@ -1175,8 +1230,14 @@ Router::initialize(ErrorHandler *errh)
 		all_ok = false;
 	    }
 	}
+#if CLICK_USERLEVEL
+	if (numa_node != my_numa_node)
+	    click_prefer_numa_node(my_numa_node);
+#endif
     }
 
+    _load_times[load_initialize] = Timestamp::now_steady() - phase_start;
+
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iXXX");
 #endif
@@ -1201,6 +1262,10 @@ Router::initialize(ErrorHandler *errh)
 	_state = ROUTER_DEAD;
 	errh->error("Router could not be initialized!");
 
+	// Kept elements go back, untouched, to the running router
+	if (_hotswap_kept.size())
+	    hotswap_return_elements();
+
 	// Unschedule tasks and timers
 	master()->kill_router(this);
 
@@ -1229,14 +1294,20 @@ Router::activate(bool foreground, ErrorHandler *errh)
 	// Unschedule tasks and timers
 	master()->kill_router(_hotswap_router);
 
+	Timestamp phase_start = Timestamp::now_steady();
 	for (int i = 0; i < _elements.size(); i++) {
+	    if (hotswap_kept(_element_configure_order[i]))
+		continue;
 	    Element *e = _elements[_element_configure_order[i]];
 	    if (Element *other = e->hotswap_element()) {
 		RouterContextErrh cerrh(errh, "While hot-swapping state into", element(i));
 		e->take_state(other, &cerrh);
 	    }
 	}
+	_load_times[load_take_state] = Timestamp::now_steady() - phase_start;
     }
+    if (_hotswap_kept.size())
+	hotswap_take_elements();
     if (_hotswap_router) {
 	_hotswap_router->unuse();
 	_hotswap_router = 0;
@@ -1259,6 +1330,193 @@ Router::set_hotswap_router(Router *r)
 	_hotswap_router->use();
 }
 
+static inline bool
+hotswap_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+	|| (c >= '0' && c <= '9') || c == '_' || c == '/' || c == '@';
+}
+
+static int
+hotswap_component(Vector<int> &parent, int i)
+{
+    while (parent[i] != i)
+	i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+/* Find the elements of the hotswap router that can be moved into this
+   router as they are, and move them.  An element is kept when an element
+   with the same name, class and configuration string exists in the hotswap
+   router, and every element connected to it, directly or indirectly, is kept
+   too, with exactly the same connections.  A kept element is neither
+   configured nor initialized again; its packets, flow tables, tasks and
+   timers carry on as before.  The new element it replaces is held as a
+   stand-in, so the swap can be undone if initialization fails.
+
+   Some elements are always rebuilt.  Elements without connections, such as
+   Script or ControlSocket, are cheap to rebuild and often refer to other
+   elements.  Elements whose configurations name elements may hold pointers
+   to those elements or to their handlers.  And if any information element,
+   like AddressInfo, changes, nothing is kept, since other configurations'
+   meanings may have changed with it. */
+void
+Router::hotswap_keep_elements()
+{
+    Router *old = _hotswap_router;
+    if (!old || old->_state != ROUTER_LIVE || old->_running == RUNNING_DEAD
+	|| old->_master != _master || !nelements())
+	return;
+
+    Vector<int> degree(nelements(), 0), old_degree(old->nelements(), 0);
+    for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp)
+	degree[(*cp)[0].idx]++, degree[(*cp)[1].idx]++;
+    for (Connection *cp = old->_conn.begin(); cp != old->_conn.end(); ++cp)
+	old_degree[(*cp)[0].idx]++, old_degree[(*cp)[1].idx]++;
+
+    // match elements by name, class and configuration; keep only those
+    // whose classes allow it
+    Vector<int> kept(nelements(), -1);
+    int ninfo = 0, old_ninfo = 0;
+    for (int i = 0; i < nelements(); ++i) {
+	Element *e = _elements[i];
+	bool info = !degree[i] && e->configure_phase() < Element::CONFIGURE_PHASE_DEFAULT;
+	Element *oe = old->find(_element_names[i]);
+	if (oe && oe->router() == old
+	    && strcmp(oe->class_name(), e->class_name()) == 0
+	    && old->_element_configurations[oe->eindex()] == _element_configurations[i]
+	    && old_degree[oe->eindex()] == degree[i])
+	    kept[i] = oe->eindex();
+	if (info) {
+	    if (kept[i] < 0)
+		return;
+	    ++ninfo;
+	}
+	if (!degree[i] || !e->can_keep_across_hotswap())
+	    kept[i] = -1;
+    }
+    for (int j = 0; j < old->nelements(); ++j)
+	if (!old_degree[j] && old->_elements[j]->configure_phase() < Element::CONFIGURE_PHASE_DEFAULT)
+	    ++old_ninfo;
+    if (ninfo != old_ninfo)
+	return;
+
+    // rebuild elements whose configurations mention element names
+    for (int i = 0; i < nelements(); ++i)
+	if (kept[i] >= 0) {
+	    const String &name = _element_names[i];
+	    String context = name.substring(0, name.find_right('/') + 1);
+	    const String &conf = _element_configurations[i];
+	    const char *s = conf.begin(), *end = conf.end();
+	    while (s != end && kept[i] >= 0) {
+		if (!hotswap_name_char(*s)) {
+		    ++s;
+		    continue;
+		}
+		const char *w = s;
+		for (; s != end && hotswap_name_char(*s); ++s)
+		    /* nada */;
+		if (find(conf.substring(w, s), context))
+		    kept[i] = -1;
+	    }
+	}
+
+    // connections must match, and connected elements are kept or rebuilt
+    // together
+    old->sort_connections();
+    Vector<int> parent(nelements(), 0);
+    for (int i = 0; i < nelements(); ++i)
+	parent[i] = i;
+    for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	int to = (*cp)[0].idx, from = (*cp)[1].idx;
+	if (kept[to] >= 0 && kept[from] >= 0) {
+	    Connection oc(kept[from], (*cp)[1].port, kept[to], (*cp)[0].port);
+	    const Connection *l = old->_conn.begin(), *r = old->_conn.end();
+	    while (l < r) {
+		const Connection *m = l + (r - l) / 2;
+		if (*m < oc)
+		    l = m + 1;
+		else
+		    r = m;
+	    }
+	    if (l == old->_conn.end() || !(*l == oc))
+		kept[to] = kept[from] = -1;
+	}
+	parent[hotswap_component(parent, to)] = hotswap_component(parent, from);
+    }
+    Bitvector rebuild(nelements());
+    for (int i = 0; i < nelements(); ++i)
+	if (kept[i] < 0)
+	    rebuild[hotswap_component(parent, i)] = true;
+    int nkept = 0;
+    for (int i = 0; i < nelements(); ++i)
+	if (kept[i] >= 0 && rebuild[hotswap_component(parent, i)])
+	    kept[i] = -1;
+	else if (kept[i] >= 0)
+	    ++nkept;
+    if (!nkept)
+	return;
+
+    // move the kept elements
+    _hotswap_kept.swap(kept);
+    _hotswap_standins.assign(nelements(), 0);
+    _master->pause();
+    for (int i = 0; i < nelements(); ++i)
+	if (_hotswap_kept[i] >= 0) {
+	    int j = _hotswap_kept[i];
+	    Element *e = old->_elements[j];
+	    _hotswap_standins[i] = _elements[i];
+	    _elements[i] = e;
+	    e->_router = this;
+	    e->_eindex = i;
+	    _element_home_thread_ids[i + 1] = old->_element_home_thread_ids[j + 1];
+	}
+    _master->unpause();
+}
+
+/* Give kept elements back to the hotswap router, which is still running.
+   Called when this router fails to initialize or is deleted before it is
+   activated. */
+void
+Router::hotswap_return_elements()
+{
+    _master->pause();
+    for (int i = 0; i < nelements(); ++i)
+	if (hotswap_kept(i)) {
+	    Element *e = _elements[i];
+	    e->_router = _hotswap_router;
+	    e->_eindex = _hotswap_kept[i];
+	    _elements[i] = _hotswap_standins[i];
+	}
+    _master->unpause();
+    _hotswap_kept.clear();
+    _hotswap_standins.clear();
+}
+
+/* Take ownership of kept elements once the hotswap router has stopped.  The
+   hotswap router forgets them, and their stand-ins, which were never
+   configured, are deleted.  Kept elements' notifier signals are stored in
+   the hotswap router, so that storage moves here too. */
+void
+Router::hotswap_take_elements()
+{
+    Router *old = _hotswap_router;
+    for (int i = 0; i < nelements(); ++i)
+	if (hotswap_kept(i)) {
+	    old->_elements[_hotswap_kept[i]] = 0;
+	    _hotswap_standins[i]->cleanup(Element::CLEANUP_NO_ROUTER);
+	    delete _hotswap_standins[i];
+	}
+    _hotswap_kept.clear();
+    _hotswap_standins.clear();
+
+    notifier_signals_t **pprev = &_notifier_signals;
+    while (*pprev)
+	pprev = &(*pprev)->next;
+    *pprev = old->_notifier_signals;
+    old->_notifier_signals = 0;
+}
+
 
 // HANDLERS
 
@@ -2169,7 +2427,7 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES, GH_LOAD_TIMES };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2212,6 +2470,21 @@ Router::router_read_handler(Element *e, void *thunk)
 		sa << r->_requirements[i] << "\n";
 	break;
 
+      case GH_LOAD_TIMES:
+	if (r) {
+	    static const char * const names[] = {
+		"parse", "hookup", "configure", "handlers", "initialize",
+		"take_state"
+	    };
+	    Timestamp total;
+	    for (int i = 0; i < nload_phases; ++i) {
+		sa << names[i] << ' ' << r->_load_times[i] << '\n';
+		total += r->_load_times[i];
+	    }
+	    sa << "total " << total << '\n';
+	}
+	break;
+
       case GH_DRIVER:
 #if CLICK_NS
 	return String::make_stable("ns", 2);
@@ -2398,6 +2671,7 @@ Router::static_initialize()
 	add_read_handler(0, "requirements", router_read_handler, (void *)GH_REQUIREMENTS);
 	add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
 	add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
+	add_read_handler(0, "load_times", router_read_handler, (void *)GH_LOAD_TIMES);
 	add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
 #if CLICK_STATS >= 1
 	add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
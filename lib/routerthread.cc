@@ -106,6 +106,10 @@ RouterThread::RouterThread(Master *master, int id)
 #if CLICK_LINUXMODULE || CLICK_BSDMODULE
     _greedy = false;
 #endif
+#if CLICK_USERLEVEL
+    _nwakeups = 0;
+    _cpu = _numa_node = -1;
+#endif
 #if CLICK_LINUXMODULE
     greedy_schedule_jiffies = jiffies;
 #endif
@@ -398,7 +402,7 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_MULTITHREAD
     int runs;
 #endif
-    bool work_done;
+    bool work_done, any_work_done = false;
 
     for (; ntasks >= 0; --ntasks) {
 	t = task_begin();
@@ -420,6 +424,7 @@ RouterThread::run_tasks(int ntasks)
 
 	t->_status.is_scheduled = false;
 	work_done = t->fire();
+	any_work_done |= work_done;
 
 #if HAVE_MULTITHREAD
 	if (runs > PROFILE_ELEMENT) {
@@ -432,7 +437,7 @@ RouterThread::run_tasks(int ntasks)
 	if (t->scheduled()) {
 	    // adjust position in scheduled list
 #if HAVE_STRIDE_SCHED
-	    t->_pass += t->_stride;
+	    t->_pass += t->_charge;
 #endif
 
 	    // If the task didn't do any work, don't run it next.  This might
@@ -488,6 +493,12 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+#if CLICK_USERLEVEL
+    if (any_work_done && _busy_poll)
+	_last_work = Timestamp::now_steady();
+#else
+    (void) any_work_done;
+#endif
 }
 
 inline void
@@ -584,10 +595,21 @@ RouterThread::driver()
     _linux_task = current;
 #elif CLICK_USERLEVEL
     select_set().initialize();
+    if (!_driver_start)
+	_driver_start = _last_work = Timestamp::now_steady();
+    if (_cpu >= 0) {
+	// report the thread as unbound, with no NUMA node, if binding fails
+	if (int r = click_set_thread_cpu(_cpu)) {
+	    click_chatter("thread %d: cannot bind to CPU %d: %s", _id, _cpu, strerror(-r));
+	    _cpu = _numa_node = -1;
+	} else if (_numa_node >= 0)
+	    click_prefer_numa_node(_numa_node);
+    }
 # if CLICK_USERLEVEL && HAVE_MULTITHREAD
     _running_processor = click_current_processor();
 #  if HAVE___THREAD_STORAGE_CLASS
     click_current_thread_id = _id;
+    click_current_numa_node = _numa_node;
 #  endif
 # endif
 #endif
@@ -694,6 +716,7 @@ RouterThread::driver()
     _running_processor = click_invalid_processor();
 # if HAVE___THREAD_STORAGE_CLASS
     click_current_thread_id = 0;
+    click_current_numa_node = -1;
 # endif
 #endif
 #if CLICK_NS
@@ -726,6 +749,54 @@ RouterThread::driver()
 #endif
 }
 
+#if CLICK_USERLEVEL
+/** @brief Return how long the driver has run without blocking.
+ *
+ * This includes time spent busy-polling.  The result, like idle_time() and
+ * the wakeup statistics, is read without synchronization, so may be slightly
+ * off if the thread is running. */
+Timestamp
+RouterThread::busy_time() const
+{
+    if (!_driver_start)
+	return Timestamp();
+    return Timestamp::now_steady() - _driver_start - _idle_time;
+}
+
+/** @brief Account for a wait for events.
+ * @param before when the wait began
+ * @param due when the wait was meant to end, or zero if unknown
+ *
+ * Called by SelectSet after a wait that might have blocked.  The time since
+ * @a before counts as idle; the time since @a due counts as wakeup latency. */
+void
+RouterThread::account_wait(const Timestamp &before, const Timestamp &due)
+{
+    Timestamp now = Timestamp::now_steady();
+    _idle_time += now - before;
+    if (due) {
+	Timestamp late = now - due;
+	if (late.is_negative())
+	    late = Timestamp();
+	_wakeup_latency += late;
+	if (late > _max_wakeup_latency)
+	    _max_wakeup_latency = late;
+	++_nwakeups;
+    }
+}
+
+/** @brief Bind the thread to processor @a cpu, or unbind it if @a cpu < 0.
+ *
+ * Also looks up the processor's NUMA node.  The binding applies when
+ * driver() starts, so this must not be called once the thread has
+ * started(). */
+void
+RouterThread::set_cpu(int cpu)
+{
+    _cpu = cpu < 0 ? -1 : cpu;
+    _numa_node = cpu < 0 ? -1 : click_cpu_numa_node(cpu);
+}
+#endif
 
 void
 RouterThread::kill_router(Router *r)
@@ -759,6 +830,24 @@ RouterThread::kill_router(Router *r)
 #endif
     unlock_tasks();
 
+    // Remove the router's tasks from the pending list in one pass.  Leaving
+    // them for ~Task would search the list once per task, which is
+    // quadratic when a router with many pending tasks is deleted.
+    SpinlockIRQ::flags_t flags = _pending_lock.acquire();
+    Task::Pending *tptr = &_pending_head;
+    while (tptr->x > 1) {
+	Task *pt = tptr->t;
+	if (pt->router() == r) {
+	    *tptr = pt->_pending_nextptr;
+	    pt->_pending_nextptr.x = 0;
+	} else
+	    tptr = &pt->_pending_nextptr;
+    }
+    if (tptr == &_pending_head)
+	tptr->x = 0;
+    _pending_tail = tptr;
+    _pending_lock.release(flags);
+
     _timers.kill_router(r);
 #if CLICK_USERLEVEL
     _selects.kill_router(r);
@@ -352,6 +352,24 @@ SelectSet::post_select(RouterThread *thread, bool acquire)
     return false;
 }
 
+inline void
+SelectSet::post_wait(RouterThread *thread, const Timestamp &before,
+		     int delay_type, const Timestamp &delay, int n)
+{
+    // A wait ends late if it outlasts its timer or a wake() request made
+    // while it blocked.
+    if (delay_type != 0) {
+	Timestamp wake_time = _wake_time, due;
+	if (wake_time > before)
+	    due = wake_time;
+	else if (n == 0 && delay_type > 0)
+	    due = before + delay;
+	thread->account_wait(before, due);
+    }
+    if (n > 0 && thread->_busy_poll)
+	thread->_last_work = Timestamp::now_steady();
+}
+
 inline void
 SelectSet::call_selected(int fd, int mask) const
 {
@@ -390,7 +408,7 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     // Decide how long to wait.
     struct timespec wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_os_delay(t);
     if (delay_type == 0)
 	wait.tv_sec = wait.tv_nsec = 0;
     else if (delay_type > 0)
@@ -400,8 +418,10 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     thread->set_thread_state_for_blocking(delay_type);
 
     struct kevent kev[256];
+    Timestamp before = (delay_type ? Timestamp::now_steady() : Timestamp());
     int n = kevent(_kqueue, 0, 0, &kev[0], 256, wait_ptr);
     int was_errno = errno;
+    post_wait(thread, before, delay_type, t, n);
 
     if (post_select(thread, true))
 	return;
@@ -441,7 +461,7 @@ SelectSet::run_selects_poll(RouterThread *thread)
     // Decide how long to wait.
     int timeout;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_os_delay(t);
     if (delay_type == 0)
 	timeout = 0;
     else if (delay_type > 0)
@@ -450,8 +470,14 @@ SelectSet::run_selects_poll(RouterThread *thread)
 	timeout = -1;
     thread->set_thread_state_for_blocking(delay_type);
 
+    // poll() cannot wait for less than a millisecond, so a shorter delay
+    // polls.
+    if (timeout == 0)
+	delay_type = 0;
+    Timestamp before = (delay_type ? Timestamp::now_steady() : Timestamp());
     int n = poll(my_pollfds.begin(), my_pollfds.size(), timeout);
     int was_errno = errno;
+    post_wait(thread, before, delay_type, t, n);
 
     if (post_select(thread, true))
 	return;
@@ -497,7 +523,7 @@ SelectSet::run_selects_select(RouterThread *thread)
     // Decide how long to wait.
     struct timeval wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->next_os_delay(t);
     if (delay_type == 0)
 	timerclear(&wait);
     else if (delay_type > 0)
@@ -506,8 +532,10 @@ SelectSet::run_selects_select(RouterThread *thread)
 	wait_ptr = 0;
     thread->set_thread_state_for_blocking(delay_type);
 
+    Timestamp before = (delay_type ? Timestamp::now_steady() : Timestamp());
     int n = select(n_select_fd, &read_mask, &write_mask, (fd_set*) 0, wait_ptr);
     int was_errno = errno;
+    post_wait(thread, before, delay_type, t, n);
 
     if (post_select(thread, true))
 	return;
@@ -561,7 +589,7 @@ SelectSet::run_selects(RouterThread *thread)
     // Return early (just run signals) if there are no selectors and there are
     // tasks to run.  NB there will always be at least one _pollfd (the
     // _wake_pipe).
-    if (_pollfds.size() < 2 && thread->active()) {
+    if (_pollfds.size() < 2 && thread->should_poll()) {
 #if HAVE_MULTITHREAD
 	_select_lock.release();
 #endif
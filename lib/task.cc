@@ -253,6 +253,10 @@ Task::true_reschedule()
 {
     bool done = false;
     RouterThread *thread = _thread;
+#if HAVE_STRIDE_SCHED
+    if (!_wake_cycles && !on_scheduled_list())
+	_wake_cycles = click_get_cycles();
+#endif
     if (unlikely(thread == 0 || thread->thread_id() < 0))
 	done = true;
     else if (thread->current_thread_is_running()) {
@@ -74,9 +74,13 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define BUSY_POLL_OPT		319
+#define AFFINITY_OPT		320
 
 static const Clp_Option options[] = {
+    { "affinity", 'a', AFFINITY_OPT, Clp_ValString, 0 },
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
+    { "busy-poll", 0, BUSY_POLL_OPT, Clp_ValString, 0 },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
@@ -121,6 +125,8 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -j, --threads N               Start N threads (default 1).\n\
+      --busy-poll TIME          Poll for TIME after useful work, then block.\n\
+  -a, --affinity CPUS           Bind thread I to the Ith CPU in the list CPUS.\n\
   -p, --port PORT               Listen for control connections on TCP port.\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
@@ -296,6 +302,7 @@ static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
 static bool warnings = true;
 static int nthreads = 1;
+static Vector<int> thread_cpus;
 
 static String
 click_driver_control_socket_name(int number)
@@ -315,6 +322,9 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 	master = router->master();
     else
 	master = new_master = new Master(nthreads);
+    if (new_master)
+	for (int i = 0; i < thread_cpus.size() && i < nthreads; ++i)
+	    new_master->thread(i)->set_cpu(thread_cpus[i]);
 
     Router *r = click_read_router(text, text_is_expr, errh, false, master);
     if (!r) {
@@ -442,6 +452,58 @@ cleanup(Clp_Parser *clp, int exit_value)
     return exit_value;
 }
 
+// adaptive polling and thread statistics
+
+enum { H_BUSY_POLL, H_BUSY_TIME, H_IDLE_TIME, H_WAKEUP_LATENCY, H_CPU };
+
+static String
+thread_read_handler(Element *e, void *thunk)
+{
+    if (!e)
+	return String();
+    Master *master = e->router()->master();
+    StringAccum sa;
+    for (int i = 0; i < master->nthreads(); ++i) {
+	RouterThread *t = master->thread(i);
+	switch ((intptr_t) thunk) {
+	case H_BUSY_POLL:
+	    sa << t->busy_poll();
+	    break;
+	case H_BUSY_TIME:
+	    sa << t->busy_time();
+	    break;
+	case H_IDLE_TIME:
+	    sa << t->idle_time();
+	    break;
+	case H_WAKEUP_LATENCY: {
+	    uint64_t n = t->nwakeups();
+	    Timestamp avg = n ? t->wakeup_latency() / (double) n : Timestamp();
+	    sa << n << ' ' << avg << ' ' << t->max_wakeup_latency();
+	    break;
+	}
+	case H_CPU:
+	    sa << t->cpu() << ' ' << t->numa_node();
+	    break;
+	}
+	sa << '\n';
+    }
+    return sa.take_string();
+}
+
+static int
+busy_poll_write_handler(const String &text, Element *e, void *, ErrorHandler *errh)
+{
+    Timestamp t;
+    if (!cp_time(text, &t))
+	return errh->error("expected time");
+    if (e) {
+	Master *master = e->router()->master();
+	for (int i = 0; i < master->nthreads(); ++i)
+	    master->thread(i)->set_busy_poll(t);
+    }
+    return 0;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -459,6 +521,7 @@ main(int argc, char **argv)
   bool quit_immediately = false;
   bool report_time = false;
   bool allow_reconfigure = false;
+  Timestamp busy_poll;
   Vector<String> handlers;
   String exit_handler;
 
@@ -552,6 +615,20 @@ main(int argc, char **argv)
       warnings = clp->negated;
       break;
 
+    case BUSY_POLL_OPT:
+      if (!cp_time(clp->vstr, &busy_poll)) {
+	  Clp_OptionError(clp, "%<%O%> expects a time, not %<%s%>", clp->vstr);
+	  goto bad_option;
+      }
+      break;
+
+    case AFFINITY_OPT:
+      if (!CpuListArg().parse(clp->vstr, thread_cpus)) {
+	  Clp_OptionError(clp, "%<%O%> expects a CPU list, not %<%s%>", clp->vstr);
+	  goto bad_option;
+      }
+      break;
+
      case THREADS_OPT:
       nthreads = clp->val.i;
       if (nthreads <= 1)
@@ -610,12 +687,20 @@ particular purpose.\n");
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
+  Router::add_read_handler(0, "busy_poll", thread_read_handler, (void *) H_BUSY_POLL);
+  Router::add_write_handler(0, "busy_poll", busy_poll_write_handler, 0);
+  Router::add_read_handler(0, "busy_time", thread_read_handler, (void *) H_BUSY_TIME);
+  Router::add_read_handler(0, "idle_time", thread_read_handler, (void *) H_IDLE_TIME);
+  Router::add_read_handler(0, "wakeup_latency", thread_read_handler, (void *) H_WAKEUP_LATENCY);
+  Router::add_read_handler(0, "cpu_affinity", thread_read_handler, (void *) H_CPU);
 
   // parse configuration
   router = parse_configuration(router_file, file_is_expr, false, errh);
   if (!router)
     return cleanup(clp, 1);
   router->use();
+  for (int t = 0; t < router->master()->nthreads(); ++t)
+      router->master()->thread(t)->set_busy_poll(busy_poll);
 
   int exit_value = 0;
 #if HAVE_MULTITHREAD